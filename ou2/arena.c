@@ -0,0 +1,170 @@
+/*
+* arena: A bump allocator. Memory is handed out from large blocks by moving a
+* pointer forward, and is only given back all at once when the arena is
+* killed. Used for the many small objects (states, paths and names) that make
+* up a dfa, which all live exactly as long as the dfa.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "arena.h"
+
+/*
+* Size of a block header, rounded up so that the memory after it is aligned.
+*/
+#define ARENA_HEADER_SIZE ((sizeof(arenaBlock) + ARENA_ALIGNMENT - 1) / \
+		ARENA_ALIGNMENT * ARENA_ALIGNMENT)
+
+/*
+* description: Creates an empty arena.
+* return: The arena.
+*/
+arena *arenaEmpty () {
+
+	arena *arena = malloc(sizeof(struct arena));
+	arena -> blocks = NULL;
+	arena -> allocated = 0;
+	return arena;
+}
+
+/*
+* description: Allocates memory from the arena. The memory is aligned for any
+* type and is freed when the arena is killed.
+* param[in]: arena - The arena.
+* param[in]: size - Number of bytes.
+* return: Pointer to the memory.
+*/
+void *arenaAlloc (arena *arena, size_t size) {
+
+	return arenaAllocAligned(arena, size, ARENA_ALIGNMENT);
+}
+
+/*
+* description: Allocates memory from the arena with a given alignment.
+* param[in]: arena - The arena.
+* param[in]: size - Number of bytes.
+* param[in]: alignment - The alignment, a power of two.
+* return: Pointer to the memory.
+*/
+void *arenaAllocAligned (arena *arena, size_t size, size_t alignment) {
+
+	if (size > ARENA_BLOCK_SIZE / 4) {
+
+		//Too big to share a block, give it one of its own behind the first.
+		arenaBlock *first = arena -> blocks;
+		arenaAddBlock(arena, size);
+		arenaBlock *block = arena -> blocks;
+		block -> used = size;
+		if (first != NULL) {
+
+			arena -> blocks = first;
+			block -> nextBlock = first -> nextBlock;
+			first -> nextBlock = block;
+		}
+		return (char *)block + ARENA_HEADER_SIZE;
+	}
+
+	size_t used = 0;
+	if (arena -> blocks != NULL) {
+
+		used = (arena -> blocks -> used + alignment - 1) & ~(alignment - 1);
+	}
+	if (arena -> blocks == NULL || used + size > arena -> blocks -> capacity) {
+
+		arenaAddBlock(arena, ARENA_BLOCK_SIZE);
+		used = 0;
+	}
+
+	arenaBlock *block = arena -> blocks;
+	block -> used = used + size;
+	return (char *)block + ARENA_HEADER_SIZE + used;
+}
+
+/*
+* description: Copies a string into the arena.
+* param[in]: arena - The arena.
+* param[in]: string - The string, terminated.
+* return: The copy.
+*/
+char *arenaString (arena *arena, const char *string) {
+
+	return arenaSubstring(arena, string, strlen(string));
+}
+
+/*
+* description: Copies the first chars of a string into the arena, terminating
+* the copy.
+* param[in]: arena - The arena.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars to copy.
+* return: The copy.
+*/
+char *arenaSubstring (arena *arena, const char *string, size_t length) {
+
+	char *copy = arenaAllocAligned(arena, length + 1, 1);
+	memcpy(copy, string, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+/*
+* description: Adds a new block to the arena, first in its list of blocks.
+* param[in]: arena - The arena.
+* param[in]: capacity - Number of bytes the block can hold.
+*/
+void arenaAddBlock (arena *arena, size_t capacity) {
+
+	arenaBlock *block = malloc(ARENA_HEADER_SIZE + capacity);
+	block -> nextBlock = arena -> blocks;
+	block -> used = 0;
+	block -> capacity = capacity;
+	arena -> blocks = block;
+	arena -> allocated += ARENA_HEADER_SIZE + capacity;
+}
+
+/*
+* description: Moves everything allocated from another arena into the arena,
+* which then frees it when killed. The other arena is freed.
+* param[in]: arena - The arena.
+* param[in]: other - The arena to move from.
+*/
+void arenaMerge (arena *arena, struct arena *other) {
+
+	arenaBlock *last = other -> blocks;
+
+	//The blocks go behind the first, which is the one still allocated from.
+	if (last != NULL && arena -> blocks != NULL) {
+
+		while (last -> nextBlock != NULL) {
+
+			last = last -> nextBlock;
+		}
+		last -> nextBlock = arena -> blocks -> nextBlock;
+		arena -> blocks -> nextBlock = other -> blocks;
+	} else if (last != NULL) {
+
+		arena -> blocks = other -> blocks;
+	}
+	arena -> allocated += other -> allocated;
+	free(other);
+}
+
+/*
+* description: Frees the arena and everything allocated from it.
+* param[in]: arena - The arena.
+*/
+void arenaKill (arena *arena) {
+
+	arenaBlock *block = arena -> blocks;
+	while (block != NULL) {
+
+		arenaBlock *nextBlock = block -> nextBlock;
+		free(block);
+		block = nextBlock;
+	}
+	free(arena);
+}
@@ -0,0 +1,99 @@
+/*
+* arena: A bump allocator. Memory is handed out from large blocks by moving a
+* pointer forward, and is only given back all at once when the arena is
+* killed. Used for the many small objects (states, paths and names) that make
+* up a dfa, which all live exactly as long as the dfa.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef ARENA
+#define ARENA
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20)
+#define ARENA_ALIGNMENT 16
+
+typedef struct arenaBlock {
+
+	struct arenaBlock *nextBlock;
+	size_t used;
+	size_t capacity;
+} arenaBlock;
+
+typedef struct arena {
+
+	struct arenaBlock *blocks;
+	size_t allocated;
+} arena;
+
+/*
+* description: Creates an empty arena.
+* return: The arena.
+*/
+arena *arenaEmpty ();
+
+/*
+* description: Allocates memory from the arena. The memory is aligned for any
+* type and is freed when the arena is killed.
+* param[in]: arena - The arena.
+* param[in]: size - Number of bytes.
+* return: Pointer to the memory.
+*/
+void *arenaAlloc (arena *arena, size_t size);
+
+/*
+* description: Allocates memory from the arena with a given alignment.
+* param[in]: arena - The arena.
+* param[in]: size - Number of bytes.
+* param[in]: alignment - The alignment, a power of two.
+* return: Pointer to the memory.
+*/
+void *arenaAllocAligned (arena *arena, size_t size, size_t alignment);
+
+/*
+* description: Copies a string into the arena.
+* param[in]: arena - The arena.
+* param[in]: string - The string, terminated.
+* return: The copy.
+*/
+char *arenaString (arena *arena, const char *string);
+
+/*
+* description: Copies the first chars of a string into the arena, terminating
+* the copy.
+* param[in]: arena - The arena.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars to copy.
+* return: The copy.
+*/
+char *arenaSubstring (arena *arena, const char *string, size_t length);
+
+/*
+* description: Adds a new block to the arena, first in its list of blocks.
+* param[in]: arena - The arena.
+* param[in]: capacity - Number of bytes the block can hold.
+*/
+void arenaAddBlock (arena *arena, size_t capacity);
+
+/*
+* description: Moves everything allocated from another arena into the arena,
+* which then frees it when killed. The other arena is freed.
+* param[in]: arena - The arena.
+* param[in]: other - The arena to move from.
+*/
+void arenaMerge (arena *arena, struct arena *other);
+
+/*
+* description: Frees the arena and everything allocated from it.
+* param[in]: arena - The arena.
+*/
+void arenaKill (arena *arena);
+
+#endif //ARENA
@@ -0,0 +1,712 @@
+/*
+* batch: Classifies newline separated strings with a compiled dfa, without any
+* prompts. Input is read through large buffers and each string gets one line
+* of output, 'A' if the dfa accepts it and 'R' if it does not. A trailing
+* carriage return on a line is not counted as part of the string.
+*
+* A batch can also be classified by several threads sharing the same compiled
+* dfa. The input is then handled in windows, each window is split into line
+* aligned chunks and every thread owns a range of them. A thread that runs out
+* of chunks steals from the end of another thread's range. The results are
+* written in input order once a window is done.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "batch.h"
+
+/*
+* description: Reads newline separated strings from a file, runs each of them
+* through the dfa and writes one result line per string. The strings that are
+* whole in a buffer are classified in lanes, a string that spans several
+* buffers is fed to a cursor buffer by buffer.
+* param[in]: dfa - The compiled dfa.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchRun (const dfa *dfa, FILE *in, FILE *out, batchResult *result) {
+
+	char *buffer = malloc(BATCH_BUFFER_SIZE);
+	dfaCursor cursor;
+	bool inLine = false;
+	bool pendingReturn = false;
+	size_t length;
+
+	result -> accepted = 0;
+	result -> rejected = 0;
+	dfaCursorInit(&cursor, dfa);
+
+	while ((length = fread(buffer, 1, BATCH_BUFFER_SIZE, in)) > 0) {
+
+		char *curr = buffer;
+		char *end = buffer + length;
+		char *linesEnd = end;
+
+		while (linesEnd > curr && linesEnd[-1] != '\n') {
+
+			linesEnd--;
+		}
+
+		while (curr < end) {
+
+			//Lines that are whole in the buffer are classified in lanes.
+			if (!inLine && curr < linesEnd) {
+
+				char *output;
+				batchResult linesResult;
+				size_t outputLength = batchClassify(dfa, curr, linesEnd,
+						&output, &linesResult);
+
+				fwrite(output, 1, outputLength, out);
+				free(output);
+				result -> accepted += linesResult.accepted;
+				result -> rejected += linesResult.rejected;
+				curr = linesEnd;
+				continue;
+			}
+
+			char *newline = memchr(curr, '\n', end - curr);
+			char *segmentEnd = newline != NULL ? newline : end;
+
+			//A '\r' held back from the last segment was not a line ending.
+			if (pendingReturn && segmentEnd > curr) {
+
+				dfaFeed(&cursor, "\r", 1);
+			}
+			pendingReturn = false;
+
+			if (segmentEnd > curr && segmentEnd[-1] == '\r') {
+
+				pendingReturn = true;
+				segmentEnd--;
+			}
+			dfaFeed(&cursor, curr, segmentEnd - curr);
+			inLine = true;
+
+			if (newline != NULL) {
+
+				batchEndLine(dfaFinalize(&cursor), out, result);
+				inLine = false;
+				pendingReturn = false;
+				curr = newline + 1;
+			} else {
+
+				curr = end;
+			}
+		}
+	}
+
+	if (inLine) {
+
+		batchEndLine(dfaFinalize(&cursor), out, result);
+	}
+	free(buffer);
+}
+
+/*
+* description: Reads newline separated strings from a file, feeds each of them
+* to a matcher and writes one result line per string, like batchRun.
+* param[in]: matcher - The matcher.
+* param[in]: feed - Feeds a part of a string to the matcher.
+* param[in]: end - Ends a string and writes its result.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchStream (void *matcher, batchFeed feed, batchEnd end, FILE *in,
+		FILE *out, batchResult *result) {
+
+	char *buffer = malloc(BATCH_BUFFER_SIZE);
+	bool inLine = false;
+	bool pendingReturn = false;
+	size_t length;
+
+	result -> accepted = 0;
+	result -> rejected = 0;
+
+	while ((length = fread(buffer, 1, BATCH_BUFFER_SIZE, in)) > 0) {
+
+		char *curr = buffer;
+		char *bufferEnd = buffer + length;
+
+		while (curr < bufferEnd) {
+
+			char *newline = memchr(curr, '\n', bufferEnd - curr);
+			char *segmentEnd = newline != NULL ? newline : bufferEnd;
+
+			//A '\r' held back from the last segment was not a line ending.
+			if (pendingReturn && segmentEnd > curr) {
+
+				feed(matcher, "\r", 1);
+			}
+			pendingReturn = false;
+
+			if (segmentEnd > curr && segmentEnd[-1] == '\r') {
+
+				pendingReturn = true;
+				segmentEnd--;
+			}
+			feed(matcher, curr, segmentEnd - curr);
+			inLine = true;
+
+			if (newline != NULL) {
+
+				end(matcher, out, result);
+				inLine = false;
+				pendingReturn = false;
+				curr = newline + 1;
+			} else {
+
+				curr = bufferEnd;
+			}
+		}
+	}
+
+	if (inLine) {
+
+		end(matcher, out, result);
+	}
+	free(buffer);
+}
+
+/*
+* description: Writes the result of a finished line and counts it.
+* param[in]: accepted - If the dfa accepted the line.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void batchEndLine (bool accepted, FILE *out, batchResult *result) {
+
+	if (accepted) {
+
+		putc(BATCH_ACCEPTED, out);
+		result -> accepted++;
+	} else {
+
+		putc(BATCH_REJECTED, out);
+		result -> rejected++;
+	}
+	putc('\n', out);
+}
+
+/*
+* description: Classifies the lines of a memory area and writes one result line
+* per string to a buffer. The area must end right after a newline or at the end
+* of input.
+* param[in]: dfa - The compiled dfa.
+* param[in]: begin - Start of the area.
+* param[in]: end - End of the area.
+* param[out]: output - Buffer for the results. Allocated by the function.
+* param[out]: result - Number of accepted and rejected strings.
+* return: Number of chars written to output.
+*/
+size_t batchClassify (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result) {
+
+	const dfaTable *table = dfa -> table;
+	size_t tableSize = (size_t) table -> nrOfStates * table -> nrOfClasses *
+			sizeof(int);
+
+	//A table this small is always cached, lanes would only add work. Lanes
+	//step a dense table only.
+	if (tableSize < BATCH_LANES_MIN_TABLE || table -> next == NULL) {
+
+		return batchClassifyEach(dfa, begin, end, output, result);
+	}
+#ifdef DFA_PROFILE
+	//Lanes are not profiled, the runs of dfaTableRun are.
+	return batchClassifyEach(dfa, begin, end, output, result);
+#else
+	return batchClassifyLanes(dfa, begin, end, output, result);
+#endif
+}
+
+/*
+* description: Classifies the lines of a memory area one string at a time.
+* Params and return as for batchClassify.
+*/
+size_t batchClassifyEach (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result) {
+
+	size_t capacity = (end - begin) / 8 + 64;
+	size_t length = 0;
+	char *buffer = malloc(capacity);
+	int startState = dfa -> table -> startState;
+	const bool *acceptable = dfa -> table -> acceptable;
+
+	result -> accepted = 0;
+	result -> rejected = 0;
+
+	while (begin < end) {
+
+		const char *newline = memchr(begin, '\n', end - begin);
+		const char *lineEnd = newline != NULL ? newline : end;
+
+		if (lineEnd > begin && lineEnd[-1] == '\r') {
+
+			lineEnd--;
+		}
+
+		int state = dfaRun(dfa, startState, begin, lineEnd - begin);
+
+		if (length + 2 > capacity) {
+
+			capacity *= 2;
+			buffer = realloc(buffer, capacity);
+		}
+		batchSetResult(buffer, length / 2, acceptable[state], result);
+		length += 2;
+
+		begin = newline != NULL ? newline + 1 : end;
+	}
+
+	*output = buffer;
+	return length;
+}
+
+/*
+* description: Classifies the lines of a memory area BATCH_LANES strings at a
+* time. The lanes take one step each in turn, so the table lookups of
+* different strings can be in flight at once when the table does not fit in
+* the cache. A lane that finishes its string is given the next one. Params and
+* return as for batchClassify.
+*/
+size_t batchClassifyLanes (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result) {
+
+	const dfaTable *table = dfa -> table;
+	const int *next = table -> next;
+	const unsigned short *classes = table -> classes;
+	const unsigned char *outcome = table -> outcome;
+	int nrOfClasses = table -> nrOfClasses;
+	size_t capacity = (end - begin) / 8 + 64;
+	size_t nrOfLines = 0;
+	char *buffer = malloc(capacity);
+	batchLanes lanes;
+	int active = 0;
+
+	result -> accepted = 0;
+	result -> rejected = 0;
+
+	//Fill the lanes with the first strings.
+	while (active < BATCH_LANES && begin < end) {
+
+		lanes.line[active] = nrOfLines++;
+		batchLaneLoad(&lanes, active, table, &begin, end);
+		active++;
+	}
+	for (int i = active; i < BATCH_LANES; i++) {
+
+		lanes.left[i] = SIZE_MAX;
+	}
+
+	//Step the lanes in turn, a lane that is done gets the next string.
+	while (active == BATCH_LANES) {
+
+		for (int i = 0; i < BATCH_LANES; i++) {
+
+			if (lanes.left[i] == 0) {
+
+				while (2 * nrOfLines > capacity) {
+
+					capacity *= 2;
+					buffer = realloc(buffer, capacity);
+				}
+				batchSetResult(buffer, lanes.line[i],
+						table -> acceptable[lanes.state[i]], result);
+
+				if (begin >= end) {
+
+					//An idle lane, no string is left to give it.
+					active--;
+					lanes.left[i] = SIZE_MAX;
+					continue;
+				}
+				lanes.line[i] = nrOfLines++;
+				batchLaneLoad(&lanes, i, table, &begin, end);
+
+				if (lanes.left[i] == 0) {
+
+					continue;
+				}
+			}
+
+			int prevState = lanes.state[i];
+			lanes.state[i] = next[(size_t)prevState * nrOfClasses +
+					classes[*lanes.pos[i]++]];
+			lanes.left[i]--;
+
+			//The outcome is decided, the rest of the string can be skipped.
+			if (lanes.state[i] == prevState && outcome[prevState] != DFA_OPEN) {
+
+				lanes.left[i] = 0;
+			}
+		}
+	}
+
+	if (2 * nrOfLines > capacity) {
+
+		capacity = 2 * nrOfLines;
+		buffer = realloc(buffer, capacity);
+	}
+
+	//Finish the strings left in the lanes one by one.
+	for (int i = 0; i < BATCH_LANES; i++) {
+
+		if (lanes.left[i] == SIZE_MAX) {
+
+			continue;
+		}
+		int state = dfaTableRun(table, lanes.state[i],
+				(const char *) lanes.pos[i], lanes.left[i]);
+		batchSetResult(buffer, lanes.line[i], table -> acceptable[state],
+				result);
+	}
+
+	*output = buffer;
+	return 2 * nrOfLines;
+}
+
+/*
+* description: Loads the next line of an area into a lane, without a trailing
+* carriage return, and moves past it.
+* param[out]: lanes - The lanes.
+* param[in]: lane - Index of the lane to load.
+* param[in]: table - The compiled table, for the start state.
+* param[in/out]: curr - Position in the area, moved to the following line.
+* param[in]: end - End of the area.
+*/
+void batchLaneLoad (batchLanes *lanes, int lane, const dfaTable *table,
+		const char **curr, const char *end) {
+
+	const char *newline = memchr(*curr, '\n', end - *curr);
+	const char *lineEnd = newline != NULL ? newline : end;
+
+	if (lineEnd > *curr && lineEnd[-1] == '\r') {
+
+		lineEnd--;
+	}
+
+	lanes -> pos[lane] = (const unsigned char *) *curr;
+	lanes -> left[lane] = lineEnd - *curr;
+	lanes -> state[lane] = table -> startState;
+	*curr = newline != NULL ? newline + 1 : end;
+}
+
+/*
+* description: Writes the result of a line to its place in a result buffer and
+* counts it.
+* param[out]: buffer - The result buffer, two chars per line.
+* param[in]: line - Index of the line.
+* param[in]: accepted - If the dfa accepted the line.
+* param[out]: result - The counts to be updated.
+*/
+void batchSetResult (char *buffer, size_t line, bool accepted,
+		batchResult *result) {
+
+	if (accepted) {
+
+		buffer[2 * line] = BATCH_ACCEPTED;
+		result -> accepted++;
+	} else {
+
+		buffer[2 * line] = BATCH_REJECTED;
+		result -> rejected++;
+	}
+	buffer[2 * line + 1] = '\n';
+}
+
+/*
+* description: Same as batchRun but with several threads sharing the dfa. A
+* regular file is mapped into memory, other input is read in windows.
+* param[in]: dfa - The compiled dfa.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[in]: nrOfThreads - Number of threads to use, 0 for one per core.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchRunParallel (const dfa *dfa, FILE *in, FILE *out, int nrOfThreads,
+		batchResult *result) {
+
+	batchPool pool;
+	struct stat fileStat;
+	int fd = fileno(in);
+	bool mapped = false;
+
+	pool.dfa = dfa;
+	pool.nrOfThreads = batchThreads(nrOfThreads);
+	pool.queues = malloc(sizeof(batchQueue) * pool.nrOfThreads);
+	for (int i = 0; i < pool.nrOfThreads; i++) {
+
+		pthread_mutex_init(&pool.queues[i].lock, NULL);
+	}
+
+	result -> accepted = 0;
+	result -> rejected = 0;
+
+	if (fstat(fd, &fileStat) == 0 && S_ISREG(fileStat.st_mode) &&
+			fileStat.st_size > 0) {
+
+		size_t size = fileStat.st_size;
+		char *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (file != MAP_FAILED) {
+
+			const char *curr = file;
+			mapped = true;
+			const char *end = file + size;
+			posix_madvise(file, size, POSIX_MADV_SEQUENTIAL);
+
+			while (curr < end) {
+
+				const char *windowEnd = end - curr > BATCH_WINDOW_SIZE ?
+						batchLineEnd(curr + BATCH_WINDOW_SIZE, end) : end;
+
+				batchWindow(&pool, curr, windowEnd, out, result);
+				curr = windowEnd;
+			}
+			munmap(file, size);
+		}
+	}
+
+	//Not a mappable file, read it window by window instead.
+	if (!mapped) {
+
+		size_t capacity = BATCH_WINDOW_SIZE;
+		size_t length = 0;
+		size_t read;
+		char *buffer = malloc(capacity);
+
+		while ((read = fread(buffer + length, 1, capacity - length, in)) > 0) {
+
+			length += read;
+
+			const char *lastLine = buffer + length;
+			while (lastLine > buffer && lastLine[-1] != '\n') {
+
+				lastLine--;
+			}
+
+			if (lastLine == buffer) {
+
+				//A line longer than the window, make room for all of it.
+				if (length == capacity) {
+
+					capacity *= 2;
+					buffer = realloc(buffer, capacity);
+				}
+			} else {
+
+				batchWindow(&pool, buffer, lastLine, out, result);
+				length = buffer + length - lastLine;
+				memmove(buffer, lastLine, length);
+			}
+		}
+
+		if (length > 0) {
+
+			batchWindow(&pool, buffer, buffer + length, out, result);
+		}
+		free(buffer);
+	}
+
+	for (int i = 0; i < pool.nrOfThreads; i++) {
+
+		pthread_mutex_destroy(&pool.queues[i].lock);
+	}
+	free(pool.queues);
+}
+
+/*
+* description: Classifies a line aligned window with the threads of a pool and
+* writes the results in input order.
+* param[in]: pool - The pool, with dfa and number of threads set.
+* param[in]: begin - Start of the window.
+* param[in]: end - End of the window.
+* param[in]: out - The file to write results to.
+* param[out]: result - The counts to be updated.
+*/
+void batchWindow (batchPool *pool, const char *begin, const char *end,
+		FILE *out, batchResult *result) {
+
+	int nrOfChunks = 0;
+	int capacity = (end - begin) / BATCH_CHUNK_SIZE + 1;
+	pool -> chunks = malloc(sizeof(batchChunk) * capacity);
+
+	while (begin < end) {
+
+		const char *chunkEnd = end - begin > BATCH_CHUNK_SIZE ?
+				batchLineEnd(begin + BATCH_CHUNK_SIZE, end) : end;
+
+		if (nrOfChunks == capacity) {
+
+			capacity *= 2;
+			pool -> chunks = realloc(pool -> chunks,
+					sizeof(batchChunk) * capacity);
+		}
+		pool -> chunks[nrOfChunks].begin = begin;
+		pool -> chunks[nrOfChunks].end = chunkEnd;
+		nrOfChunks++;
+		begin = chunkEnd;
+	}
+
+	//Every thread owns a contiguous range of the chunks to begin with.
+	for (int i = 0; i < pool -> nrOfThreads; i++) {
+
+		pool -> queues[i].head = nrOfChunks * i / pool -> nrOfThreads;
+		pool -> queues[i].tail = nrOfChunks * (i + 1) / pool -> nrOfThreads;
+	}
+
+	pthread_t *threads = malloc(sizeof(pthread_t) * pool -> nrOfThreads);
+	batchWorker *workers = malloc(sizeof(batchWorker) * pool -> nrOfThreads);
+
+	for (int i = 0; i < pool -> nrOfThreads; i++) {
+
+		workers[i].id = i;
+		workers[i].pool = pool;
+		if (i > 0) {
+
+			pthread_create(&threads[i], NULL, batchWork, &workers[i]);
+		}
+	}
+	batchWork(&workers[0]);
+	for (int i = 1; i < pool -> nrOfThreads; i++) {
+
+		pthread_join(threads[i], NULL);
+	}
+
+	for (int i = 0; i < nrOfChunks; i++) {
+
+		batchChunk *chunk = &pool -> chunks[i];
+		fwrite(chunk -> output, 1, chunk -> outputLength, out);
+		free(chunk -> output);
+		result -> accepted += chunk -> result.accepted;
+		result -> rejected += chunk -> result.rejected;
+	}
+
+	free(threads);
+	free(workers);
+	free(pool -> chunks);
+	pool -> chunks = NULL;
+}
+
+/*
+* description: The work loop of a thread. Classifies chunks from its own queue
+* and steals from the other queues when its own is empty.
+* param[in]: arg - Pointer to the batchWorker.
+* return: NULL.
+*/
+void *batchWork (void *arg) {
+
+	batchWorker *worker = arg;
+	batchPool *pool = worker -> pool;
+	int victim = 0;
+	int chunk = batchTakeOwn(&pool -> queues[worker -> id]);
+
+	while (chunk >= 0 || victim < pool -> nrOfThreads - 1) {
+
+		if (chunk < 0) {
+
+			//Try the other threads in turn, starting with the next one.
+			int other = (worker -> id + 1 + victim) % pool -> nrOfThreads;
+			chunk = batchSteal(&pool -> queues[other]);
+			if (chunk < 0) {
+
+				victim++;
+			}
+		} else {
+
+			batchChunk *curr = &pool -> chunks[chunk];
+			curr -> outputLength = batchClassify(pool -> dfa, curr -> begin,
+					curr -> end, &curr -> output, &curr -> result);
+			chunk = batchTakeOwn(&pool -> queues[worker -> id]);
+		}
+	}
+	return NULL;
+}
+
+/*
+* description: Takes a chunk from the head of a queue.
+* param[in]: queue - The queue.
+* return: Index of the chunk, -1 if the queue is empty.
+*/
+int batchTakeOwn (batchQueue *queue) {
+
+	int chunk = -1;
+	pthread_mutex_lock(&queue -> lock);
+	if (queue -> head < queue -> tail) {
+
+		chunk = queue -> head;
+		queue -> head++;
+	}
+	pthread_mutex_unlock(&queue -> lock);
+	return chunk;
+}
+
+/*
+* description: Steals a chunk from the tail of a queue.
+* param[in]: queue - The queue.
+* return: Index of the chunk, -1 if the queue is empty.
+*/
+int batchSteal (batchQueue *queue) {
+
+	int chunk = -1;
+	pthread_mutex_lock(&queue -> lock);
+	if (queue -> head < queue -> tail) {
+
+		queue -> tail--;
+		chunk = queue -> tail;
+	}
+	pthread_mutex_unlock(&queue -> lock);
+	return chunk;
+}
+
+/*
+* description: Finds the end of the line a position is in.
+* param[in]: curr - The position.
+* param[in]: end - End of the input.
+* return: Pointer right after the next newline, or end if there is none.
+*/
+const char *batchLineEnd (const char *curr, const char *end) {
+
+	const char *newline = memchr(curr, '\n', end - curr);
+	return newline != NULL ? newline + 1 : end;
+}
+
+/*
+* description: Resolves the number of threads to use.
+* param[in]: nrOfThreads - Wanted number of threads, 0 for one per core.
+* return: The number of threads, at least 1.
+*/
+int batchThreads (int nrOfThreads) {
+
+	if (nrOfThreads <= 0) {
+
+		nrOfThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	return nrOfThreads > 0 ? nrOfThreads : 1;
+}
+
+/*
+* description: Prints a summary of a batch run.
+* param[in]: result - The result of the run.
+* param[in]: fp - The file to print to.
+*/
+void batchPrintSummary (const batchResult *result, FILE *fp) {
+
+	fprintf(fp, "accepted: %lld rejected: %lld total: %lld\n",
+			result -> accepted, result -> rejected,
+			result -> accepted + result -> rejected);
+}
@@ -0,0 +1,261 @@
+/*
+* batch: Classifies newline separated strings with a compiled dfa, without any
+* prompts. Input is read through large buffers and each string gets one line
+* of output, 'A' if the dfa accepts it and 'R' if it does not. A trailing
+* carriage return on a line is not counted as part of the string.
+*
+* A batch can also be classified by several threads sharing the same compiled
+* dfa. The input is then handled in windows, each window is split into line
+* aligned chunks and every thread owns a range of them. A thread that runs out
+* of chunks steals from the end of another thread's range. The results are
+* written in input order once a window is done.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef BATCH
+#define BATCH
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "dfa.h"
+
+#define BATCH_BUFFER_SIZE (1 << 20)
+#define BATCH_WINDOW_SIZE (64 << 20)
+#define BATCH_CHUNK_SIZE (256 << 10)
+#define BATCH_ACCEPTED 'A'
+#define BATCH_REJECTED 'R'
+#define BATCH_LANES 8
+#define BATCH_LANES_MIN_TABLE (32 << 10)
+
+typedef struct batchResult {
+
+	long long accepted;
+	long long rejected;
+} batchResult;
+
+/*
+* Strings classified in lock-step, one per lane. A lane holds the position of
+* its next char, the number of chars left, its current state and the index of
+* its line in the output.
+*/
+typedef struct batchLanes {
+
+	const unsigned char *pos[BATCH_LANES];
+	size_t left[BATCH_LANES];
+	int state[BATCH_LANES];
+	size_t line[BATCH_LANES];
+} batchLanes;
+
+/*
+* A matcher run through batchStream, fed a string part by part. end writes the
+* result of the string, counts it and readies the matcher for the next one.
+*/
+typedef void (*batchFeed) (void *matcher, const char *buffer, size_t length);
+typedef void (*batchEnd) (void *matcher, FILE *out, batchResult *result);
+
+/*
+* A line aligned part of a window, and the results for its lines.
+*/
+typedef struct batchChunk {
+
+	const char *begin;
+	const char *end;
+	char *output;
+	size_t outputLength;
+	batchResult result;
+} batchChunk;
+
+/*
+* The range [head, tail) of chunks a thread has left to classify. The owner
+* takes chunks from the head and thieves take them from the tail.
+*/
+typedef struct batchQueue {
+
+	pthread_mutex_t lock;
+	int head;
+	int tail;
+} batchQueue;
+
+/*
+* What the threads share while classifying a window.
+*/
+typedef struct batchPool {
+
+	const dfa *dfa;
+	int nrOfThreads;
+	batchChunk *chunks;
+	batchQueue *queues;
+} batchPool;
+
+/*
+* A thread working in a pool.
+*/
+typedef struct batchWorker {
+
+	int id;
+	batchPool *pool;
+} batchWorker;
+
+/*
+* description: Reads newline separated strings from a file, runs each of them
+* through the dfa and writes one result line per string. The strings that are
+* whole in a buffer are classified in lanes, a string that spans several
+* buffers is fed to a cursor buffer by buffer.
+* param[in]: dfa - The compiled dfa.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchRun (const dfa *dfa, FILE *in, FILE *out, batchResult *result);
+
+/*
+* description: Reads newline separated strings from a file, feeds each of them
+* to a matcher and writes one result line per string, like batchRun.
+* param[in]: matcher - The matcher.
+* param[in]: feed - Feeds a part of a string to the matcher.
+* param[in]: end - Ends a string and writes its result.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchStream (void *matcher, batchFeed feed, batchEnd end, FILE *in,
+		FILE *out, batchResult *result);
+
+/*
+* description: Writes the result of a finished line and counts it.
+* param[in]: accepted - If the dfa accepted the line.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void batchEndLine (bool accepted, FILE *out, batchResult *result);
+
+/*
+* description: Classifies the lines of a memory area and writes one result line
+* per string to a buffer. The area must end right after a newline or at the end
+* of input. Tables larger than BATCH_LANES_MIN_TABLE bytes are run in lanes,
+* smaller ones string by string.
+* param[in]: dfa - The compiled dfa.
+* param[in]: begin - Start of the area.
+* param[in]: end - End of the area.
+* param[out]: output - Buffer for the results. Allocated by the function.
+* param[out]: result - Number of accepted and rejected strings.
+* return: Number of chars written to output.
+*/
+size_t batchClassify (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result);
+
+/*
+* description: Classifies the lines of a memory area one string at a time.
+* Params and return as for batchClassify.
+*/
+size_t batchClassifyEach (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result);
+
+/*
+* description: Classifies the lines of a memory area BATCH_LANES strings at a
+* time. The lanes take one step each in turn, so the table lookups of
+* different strings can be in flight at once when the table does not fit in
+* the cache. A lane that finishes its string is given the next one. Params and
+* return as for batchClassify.
+*/
+size_t batchClassifyLanes (const dfa *dfa, const char *begin, const char *end,
+		char **output, batchResult *result);
+
+/*
+* description: Loads the next line of an area into a lane, without a trailing
+* carriage return, and moves past it.
+* param[out]: lanes - The lanes.
+* param[in]: lane - Index of the lane to load.
+* param[in]: table - The compiled table, for the start state.
+* param[in/out]: curr - Position in the area, moved to the following line.
+* param[in]: end - End of the area.
+*/
+void batchLaneLoad (batchLanes *lanes, int lane, const dfaTable *table,
+		const char **curr, const char *end);
+
+/*
+* description: Writes the result of a line to its place in a result buffer and
+* counts it.
+* param[out]: buffer - The result buffer, two chars per line.
+* param[in]: line - Index of the line.
+* param[in]: accepted - If the dfa accepted the line.
+* param[out]: result - The counts to be updated.
+*/
+void batchSetResult (char *buffer, size_t line, bool accepted,
+		batchResult *result);
+
+/*
+* description: Same as batchRun but with several threads sharing the dfa. A
+* regular file is mapped into memory, other input is read in windows.
+* param[in]: dfa - The compiled dfa.
+* param[in]: in - The file to read strings from.
+* param[in]: out - The file to write results to.
+* param[in]: nrOfThreads - Number of threads to use, 0 for one per core.
+* param[out]: result - Number of accepted and rejected strings.
+*/
+void batchRunParallel (const dfa *dfa, FILE *in, FILE *out, int nrOfThreads,
+		batchResult *result);
+
+/*
+* description: Classifies a line aligned window with the threads of a pool and
+* writes the results in input order.
+* param[in]: pool - The pool, with dfa and number of threads set.
+* param[in]: begin - Start of the window.
+* param[in]: end - End of the window.
+* param[in]: out - The file to write results to.
+* param[out]: result - The counts to be updated.
+*/
+void batchWindow (batchPool *pool, const char *begin, const char *end,
+		FILE *out, batchResult *result);
+
+/*
+* description: The work loop of a thread. Classifies chunks from its own queue
+* and steals from the other queues when its own is empty.
+* param[in]: arg - Pointer to the batchWorker.
+* return: NULL.
+*/
+void *batchWork (void *arg);
+
+/*
+* description: Takes a chunk from the head of a queue.
+* param[in]: queue - The queue.
+* return: Index of the chunk, -1 if the queue is empty.
+*/
+int batchTakeOwn (batchQueue *queue);
+
+/*
+* description: Steals a chunk from the tail of a queue.
+* param[in]: queue - The queue.
+* return: Index of the chunk, -1 if the queue is empty.
+*/
+int batchSteal (batchQueue *queue);
+
+/*
+* description: Finds the end of the line a position is in.
+* param[in]: curr - The position.
+* param[in]: end - End of the input.
+* return: Pointer right after the next newline, or end if there is none.
+*/
+const char *batchLineEnd (const char *curr, const char *end);
+
+/*
+* description: Resolves the number of threads to use.
+* param[in]: nrOfThreads - Wanted number of threads, 0 for one per core.
+* return: The number of threads, at least 1.
+*/
+int batchThreads (int nrOfThreads);
+
+/*
+* description: Prints a summary of a batch run.
+* param[in]: result - The result of the run.
+* param[in]: fp - The file to print to.
+*/
+void batchPrintSummary (const batchResult *result, FILE *fp);
+
+#endif //BATCH
@@ -0,0 +1,286 @@
+/*
+* comb: Compiles a dfa into a compressed table, for a dfa whose dense table
+* would not fit in memory. See comb.h.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "comb.h"
+
+/*
+* description: Compiles the states of a built dfa into a compressed table. The
+* error state is numbered after the states of the dfa.
+* param[in]: dfa - The dfa.
+* param[in]: classOf - The class of each byte.
+* param[in]: nrOfClasses - Number of classes.
+* return: The compressed table.
+*/
+dfaComb *combCompile (const dfa *dfa, const int *classOf, int nrOfClasses) {
+
+	int errorState = dfa -> size;
+	dfaComb *comb = malloc(sizeof(dfaComb));
+	combPacker packer = {comb, 0, 0, 0};
+	int *row = malloc(sizeof(int) * nrOfClasses);
+	int *tally = calloc(dfa -> size + 1, sizeof(int));
+	int *templateOf = malloc(sizeof(int) * (dfa -> size + 1));
+	int *templates = NULL;
+	int templateStates[COMB_MAX_TEMPLATES];
+	int nrOfTemplates = 0;
+	int classes[DFA_MAX_CLASSES];
+	int targets[DFA_MAX_CLASSES];
+
+	comb -> rows = malloc(sizeof(dfaCombRow) * (dfa -> size + 1));
+	comb -> slots = NULL;
+	comb -> nrOfSlots = 0;
+	comb -> errorState = errorState;
+	for (int i = 0; i <= dfa -> size; i++) {
+
+		templateOf[i] = -1;
+	}
+
+	for (int s = 0; s < dfa -> size; s++) {
+
+		int common;
+		int commonCount;
+		int count = 0;
+		const int *fallbackRow = NULL;
+
+		dfaStateRow(dfa -> allStates[s], classOf, nrOfClasses, errorState,
+				row);
+		common = combMostCommon(row, nrOfClasses, errorState, tally,
+				&commonCount);
+		comb -> rows[s].fallback = errorState;
+
+		//Only worth a template if some other state may share the moves.
+		if (common != errorState && commonCount > 1) {
+
+			int t = templateOf[common];
+			if (t >= 0) {
+
+				int differ = 0;
+				int own = 0;
+				for (int c = 0; c < nrOfClasses; c++) {
+
+					differ += row[c] != templates[t * nrOfClasses + c];
+					own += row[c] != errorState;
+				}
+				if (differ < own) {
+
+					fallbackRow = &templates[t * nrOfClasses];
+					comb -> rows[s].fallback = templateStates[t];
+				}
+			} else if (nrOfTemplates < COMB_MAX_TEMPLATES) {
+
+				templates = realloc(templates,
+						sizeof(int) * (nrOfTemplates + 1) * nrOfClasses);
+				memcpy(&templates[nrOfTemplates * nrOfClasses], row,
+						sizeof(int) * nrOfClasses);
+				templateStates[nrOfTemplates] = s;
+				templateOf[common] = nrOfTemplates++;
+			}
+		}
+
+		for (int c = 0; c < nrOfClasses; c++) {
+
+			if (row[c] != (fallbackRow != NULL ? fallbackRow[c] :
+					errorState)) {
+
+				classes[count] = c;
+				targets[count] = row[c];
+				count++;
+			}
+		}
+		comb -> rows[s].base = combPack(&packer, s, classes, targets, count,
+				nrOfClasses);
+	}
+
+	comb -> rows[errorState].base = 0;
+	comb -> rows[errorState].fallback = errorState;
+	combReserve(&packer, nrOfClasses);
+	free(row);
+	free(tally);
+	free(templateOf);
+	free(templates);
+	return comb;
+}
+
+/*
+* description: Finds the row of a state in a compressed table.
+* param[in]: comb - The compressed table.
+* param[in]: state - The state (stateNr).
+* param[in]: nrOfClasses - Number of classes.
+* param[out]: row - The destination of each class.
+*/
+void combRow (const dfaComb *comb, int state, int nrOfClasses, int *row) {
+
+	if (state == comb -> errorState) {
+
+		for (int c = 0; c < nrOfClasses; c++) {
+
+			row[c] = state;
+		}
+		return;
+	}
+
+	const dfaCombSlot *slots = &comb -> slots[comb -> rows[state].base];
+	combRow(comb, comb -> rows[state].fallback, nrOfClasses, row);
+	for (int c = 0; c < nrOfClasses; c++) {
+
+		if (slots[c].check == state) {
+
+			row[c] = slots[c].next;
+		}
+	}
+}
+
+/*
+* description: Finds the state a row leads to on the most classes, other than
+* the error state.
+* param[in]: row - The row.
+* param[in]: nrOfClasses - Number of classes.
+* param[in]: errorState - The error state.
+* param[in/out]: tally - Room for a count per state, all 0, left all 0.
+* param[out]: count - Number of classes leading to the state.
+* return: The state, the error state if the row only leads there.
+*/
+int combMostCommon (const int *row, int nrOfClasses, int errorState,
+		int *tally, int *count) {
+
+	int common = errorState;
+
+	*count = 0;
+	for (int c = 0; c < nrOfClasses; c++) {
+
+		if (row[c] != errorState && ++tally[row[c]] > *count) {
+
+			common = row[c];
+			*count = tally[row[c]];
+		}
+	}
+	for (int c = 0; c < nrOfClasses; c++) {
+
+		tally[row[c]] = 0;
+	}
+	return common;
+}
+
+/*
+* description: Packs a row into the first free slots it fits in, searching
+* COMB_SEARCH_BASES bases from the first free slot. If it fits in none of them
+* it is packed above every used slot, and the slots searched are given up, so
+* that rows which leave holes no other row fits in do not make every later
+* row search through them.
+* param[in]: packer - The slots being packed.
+* param[in]: state - The state (stateNr) of the row.
+* param[in]: classes - The classes the row keeps a move for, in order.
+* param[in]: targets - The move on each of those classes.
+* param[in]: count - Number of moves.
+* param[in]: nrOfClasses - Number of classes.
+* return: The base of the row.
+*/
+int combPack (combPacker *packer, int state, const int *classes,
+		const int *targets, int count, int nrOfClasses) {
+
+	int first = packer -> firstFree - classes[0];
+	int base = first > 0 ? first : 0;
+	int fits = 0;
+
+	if (count == 0) {
+
+		return 0;
+	}
+
+	for (; base < first + COMB_SEARCH_BASES && base < packer -> top; base++) {
+
+		combReserve(packer, base + nrOfClasses);
+		const dfaCombSlot *slots = &packer -> comb -> slots[base];
+		for (fits = 0; fits < count && slots[classes[fits]].check < 0;
+				fits++);
+		if (fits == count) {
+
+			break;
+		}
+	}
+	if (fits < count) {
+
+		base = packer -> top - classes[0] > 0 ? packer -> top - classes[0] : 0;
+		if (base > first + COMB_SEARCH_BASES) {
+
+			packer -> firstFree = first + COMB_SEARCH_BASES + classes[0];
+		}
+	}
+	combReserve(packer, base + nrOfClasses);
+
+	dfaCombSlot *slots = &packer -> comb -> slots[base];
+	for (int i = 0; i < count; i++) {
+
+		slots[classes[i]].check = state;
+		slots[classes[i]].next = targets[i];
+	}
+	if (base + classes[count - 1] >= packer -> top) {
+
+		packer -> top = base + classes[count - 1] + 1;
+	}
+	while (packer -> firstFree < packer -> top &&
+			packer -> comb -> slots[packer -> firstFree].check >= 0) {
+
+		packer -> firstFree++;
+	}
+	return base;
+}
+
+/*
+* description: Makes sure the slots reach an index, adding free slots.
+* param[in]: packer - The slots being packed.
+* param[in]: size - Number of slots needed.
+*/
+void combReserve (combPacker *packer, int size) {
+
+	dfaComb *comb = packer -> comb;
+
+	if (size > packer -> capacity) {
+
+		int capacity = packer -> capacity > 0 ? packer -> capacity : 1024;
+		while (capacity < size) {
+
+			capacity *= 2;
+		}
+		comb -> slots = realloc(comb -> slots,
+				sizeof(dfaCombSlot) * capacity);
+		packer -> capacity = capacity;
+	}
+	for (; comb -> nrOfSlots < size; comb -> nrOfSlots++) {
+
+		comb -> slots[comb -> nrOfSlots].check = -1;
+		comb -> slots[comb -> nrOfSlots].next = comb -> errorState;
+	}
+}
+
+/*
+* description: Finds the number of bytes a compressed table uses.
+* param[in]: comb - The compressed table.
+* return: The number of bytes.
+*/
+size_t combSize (const dfaComb *comb) {
+
+	return sizeof(dfaCombRow) * ((size_t)comb -> errorState + 1) +
+			sizeof(dfaCombSlot) * (size_t)comb -> nrOfSlots;
+}
+
+/*
+* description: Frees a compressed table.
+* param[in]: comb - The compressed table.
+*/
+void combKill (dfaComb *comb) {
+
+	if (comb != NULL) {
+
+		free(comb -> rows);
+		free(comb -> slots);
+		free(comb);
+	}
+}
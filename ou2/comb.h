@@ -0,0 +1,118 @@
+/*
+* comb: Compiles a dfa into a compressed table (see dfaComb in dfa.h), for a
+* dfa whose dense table would not fit in memory. This is the row displacement
+* packing classic lexer generators use. Each row only keeps the moves it does
+* not share with its fallback, and the rows are laid over each other like
+* combs, each at the first offset where its moves fall in free slots.
+*
+* Most states of a large sparse dfa lead to the error state on most classes,
+* and keep only the moves of their paths. A state which instead leads to the
+* same state on many classes, like the states of a search that go back to the
+* start on most bytes, falls back to a template: the first state found which
+* leads to that state most, and then only keeps the moves that differ from it.
+* A template falls back to the error state, so a move takes at most two
+* lookups before it is found.
+*
+* The rows are packed in the order of the states, so rows that are close in
+* the dense table are close in the compressed one too (see order.h).
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef COMB
+#define COMB
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+
+#define COMB_MAX_TEMPLATES 4096
+#define COMB_SEARCH_BASES 256
+
+/*
+* The slots of a compressed table while it is packed. No slot before
+* firstFree is searched for room, and every slot from top is free.
+*/
+typedef struct combPacker {
+
+	dfaComb *comb;
+	int capacity;
+	int firstFree;
+	int top;
+} combPacker;
+
+/*
+* description: Compiles the states of a built dfa into a compressed table. The
+* error state is numbered after the states of the dfa.
+* param[in]: dfa - The dfa.
+* param[in]: classOf - The class of each byte.
+* param[in]: nrOfClasses - Number of classes.
+* return: The compressed table.
+*/
+dfaComb *combCompile (const dfa *dfa, const int *classOf, int nrOfClasses);
+
+/*
+* description: Finds the row of a state in a compressed table.
+* param[in]: comb - The compressed table.
+* param[in]: state - The state (stateNr).
+* param[in]: nrOfClasses - Number of classes.
+* param[out]: row - The destination of each class.
+*/
+void combRow (const dfaComb *comb, int state, int nrOfClasses, int *row);
+
+/*
+* description: Finds the state a row leads to on the most classes, other than
+* the error state.
+* param[in]: row - The row.
+* param[in]: nrOfClasses - Number of classes.
+* param[in]: errorState - The error state.
+* param[in/out]: tally - Room for a count per state, all 0, left all 0.
+* param[out]: count - Number of classes leading to the state.
+* return: The state, the error state if the row only leads there.
+*/
+int combMostCommon (const int *row, int nrOfClasses, int errorState,
+		int *tally, int *count);
+
+/*
+* description: Packs a row into the first free slots it fits in, searching
+* COMB_SEARCH_BASES bases from the first free slot. If it fits in none of them
+* it is packed above every used slot, and the slots searched are given up, so
+* that rows which leave holes no other row fits in do not make every later
+* row search through them.
+* param[in]: packer - The slots being packed.
+* param[in]: state - The state (stateNr) of the row.
+* param[in]: classes - The classes the row keeps a move for, in order.
+* param[in]: targets - The move on each of those classes.
+* param[in]: count - Number of moves.
+* param[in]: nrOfClasses - Number of classes.
+* return: The base of the row.
+*/
+int combPack (combPacker *packer, int state, const int *classes,
+		const int *targets, int count, int nrOfClasses);
+
+/*
+* description: Makes sure the slots reach an index, adding free slots.
+* param[in]: packer - The slots being packed.
+* param[in]: size - Number of slots needed.
+*/
+void combReserve (combPacker *packer, int size);
+
+/*
+* description: Finds the number of bytes a compressed table uses.
+* param[in]: comb - The compressed table.
+* return: The number of bytes.
+*/
+size_t combSize (const dfaComb *comb);
+
+/*
+* description: Frees a compressed table.
+* param[in]: comb - The compressed table.
+*/
+void combKill (dfaComb *comb);
+
+#endif //COMB
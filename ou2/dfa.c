@@ -7,6 +7,13 @@
 * -> Q2 for example) can only be one characther long and must. The alphabet
 * must be consisting of numbers or letters.
 *
+* All states, paths and names of a dfa are allocated from an arena owned by
+* the dfa, and are freed all at once by dfaKill.
+*
+* Once built and compiled the dfa is never changed by running it. A run is
+* kept track of by a dfaCursor, which only holds the current state, so any
+* number of cursors (in any number of threads) can share the same dfa.
+*
 * Authors:
 * Buster Hultgren Warn <dv17bhn@cs.umu.se>
 * Victor Liljeholm <dv13vlm@cs.umu.se>
@@ -15,7 +22,19 @@
 */
 
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "dfa.h"
+#include "comb.h"
+#ifdef DFA_PROFILE
+#include "profile.h"
+#endif
 
 /*
 * description: Allocates memory for an dfa and Creates an empty dfa.
@@ -26,7 +45,11 @@ dfa *dfaEmpty(){
 	dfa *dfa = malloc(sizeof(struct dfa));
 	dfa -> allStates = NULL;
 	dfa -> startState = NULL;
-	dfa -> currState = NULL;
+	dfa -> table = NULL;
+	dfa -> tableBudget = DFA_TABLE_BUDGET;
+	dfa -> index = NULL;
+	dfa -> indexCapacity = 0;
+	dfa -> arena = arenaEmpty();
 	dfa -> capacity = 0;
 	dfa -> size = 0;
 	return dfa;
@@ -51,6 +74,7 @@ void dfaSetStates (dfa *dfa, int capacity) {
 
 	dfa -> capacity = capacity;
 	dfa -> allStates = realloc(dfa -> allStates, sizeof(state*) * capacity);
+	dfaIndexRebuild(dfa);
 }
 
 /*
@@ -58,29 +82,31 @@ void dfaSetStates (dfa *dfa, int capacity) {
 * param[in]: dfa - A pointer to the dfa.
 * param[in]: startState - the state to be set to startState.
 */
-void dfaSetStart (dfa *dfa, char *stateName) {
+void dfaSetStart (dfa *dfa, const char *stateName) {
 
 	state* startState = dfaFindState(dfa, stateName);
 	dfa -> startState = startState;
-	dfa -> currState = startState;
 }
 
 /*
 * description: If number of inserted states is smaller than the DFA's capacity,
-* allocate memory for and insert a state.
+* allocate memory for and insert a state. The name is copied into the dfa.
 * param[in]: dfa - A pointer to the dfa.
 * param[in]: acceptable - tells if the state is to be acceptlable or not.
 * param[in]: stateName - The name of the state.
 */
-void dfaInsertState (dfa *dfa, bool acceptable, char *stateName) {
+void dfaInsertState (dfa *dfa, bool acceptable, const char *stateName) {
 
 	if (dfa -> size < dfa -> capacity) {
 
-		dfa -> allStates[dfa -> size] = malloc(sizeof(struct state));
-		dfa -> allStates[dfa -> size] -> stateName = stateName;
+		dfa -> allStates[dfa -> size] = arenaAlloc(dfa -> arena,
+				sizeof(struct state));
+		dfa -> allStates[dfa -> size] -> stateName =
+				arenaString(dfa -> arena, stateName);
 		dfa -> allStates[dfa -> size] -> stateNr = dfa -> size;
 		dfa -> allStates[dfa -> size] -> acceptable = acceptable;
 		dfa -> allStates[dfa -> size] -> paths = NULL;
+		dfaIndexInsert(dfa, dfa -> allStates[dfa -> size]);
 		dfa -> size++;
 	} else {
 
@@ -90,47 +116,67 @@ void dfaInsertState (dfa *dfa, bool acceptable, char *stateName) {
 }
 
 /*
-* description: Modifies a state by adding a path.
+* description: Modifies a state by adding a path. The key is copied into the
+* dfa. Nothing is added if any of the arguments is missing.
 * param[in]: dfa - Pointer to dfa which includes the state.
 * param[in]: fromState - Pointer to the state which path are to be modified.
 * param[in]: path - The alpabetical key of the path.
 * param[in]: toState - The state to which the path leads to.
 */
-void dfaModifyState (dfa *dfa, char *fromState, char *path, char *toState) {
+void dfaModifyState (dfa *dfa, const char *fromState, const char *path,
+		const char *toState) {
+
+	if (fromState == NULL || path == NULL || toState == NULL) {
+
+		return;
+	}
 
 	state *destination = dfaFindState(dfa, toState);
 	state *state = dfaFindState(dfa, fromState);
 
 	if (state != NULL) {
 
-		pathInsert(state, path, destination);
+		pathInsert(dfa -> arena, state, path, destination);
 	}
 }
 
 /*
-* description: Changes the current state of the dfa by one of the paths
+* description: Sets up a cursor to run a compiled dfa from its start state.
+* param[out]: cursor - The cursor.
+* param[in]: dfa - The compiled dfa.
+*/
+void dfaCursorInit (dfaCursor *cursor, const dfa *dfa) {
+
+	cursor -> table = dfa -> table;
+	cursor -> state = dfa -> table -> startState;
+}
+
+/*
+* description: Changes the current state of the cursor by one of the paths
 * connected to the current state.
-* param[in]: dfa - Pointer to the dfa.
+* param[in]: cursor - Pointer to the cursor.
 * param[in]: path - The alphabetical key to one of the paths connected to the
 * current state.
+* return: 1 if the path was followed, 0 if the current state has no path with
+* the key and -1 if the current state has no paths at all.
 */
-int dfaChangeState (dfa *dfa, char *key) {
+int dfaChangeState (dfaCursor *cursor, char *key) {
 
-	int letterValidity = -1;
-    if (dfa -> currState -> paths != NULL) {
+	const dfaTable *table = cursor -> table;
+	int next = dfaTableMove(table, cursor -> state,
+			table -> classes[(unsigned char)*key]);
 
-		state *toState = pathFindState(dfa -> currState -> paths, key);
+	if (next != table -> errorState) {
 
-		if (toState != NULL) {
+		cursor -> state = next;
+		return 1;
+	} else if (dfaTableHasPaths(table, cursor -> state)) {
 
-			dfa -> currState = toState;
-			letterValidity = 1;
-	    } else {
+		return 0;
+	} else {
 
-			letterValidity = 0;
-		}
+		return -1;
 	}
-	return letterValidity;
 }
 
 /*
@@ -139,45 +185,735 @@ int dfaChangeState (dfa *dfa, char *key) {
 * param[in]: stateName - The name of the state to be found.
 * return: If found; the state, else NULL.
 */
-state *dfaFindState(dfa *dfa, char *stateName) {
+state *dfaFindState(dfa *dfa, const char *stateName) {
+
+	if (dfa -> index == NULL) {
 
-	state* foundState = NULL;
-	int i = 0;
+		return NULL;
+	}
 
-	while (foundState == NULL && i < dfa -> size) {
+	unsigned int mask = dfa -> indexCapacity - 1;
+	unsigned int i = dfaHashName(stateName) & mask;
 
-		if (strcmp(stateName, dfa -> allStates[i] -> stateName) == 0) {
+	while (dfa -> index[i] != NULL) {
 
-			foundState = dfa -> allStates[i];
+		if (strcmp(stateName, dfa -> index[i] -> stateName) == 0) {
+
+			return dfa -> index[i];
 		}
-		i++;
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+/*
+* description: Hashes a state name with FNV-1a.
+* param[in]: stateName - The name to be hashed.
+* return: The hash of the name.
+*/
+unsigned int dfaHashName (const char *stateName) {
+
+	return dfaHashSubstring(stateName, strlen(stateName));
+}
+
+/*
+* description: Hashes the first chars of a string with FNV-1a.
+* param[in]: name - The chars, do not need to be terminated.
+* param[in]: length - Number of chars.
+* return: The hash of the chars.
+*/
+unsigned int dfaHashSubstring (const char *name, size_t length) {
+
+	unsigned int hash = 2166136261u;
+	const unsigned char *c = (const unsigned char *)name;
+
+	for (size_t i = 0; i < length; i++) {
+
+		hash ^= c[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/*
+* description: Rebuilds the name index of the dfa so that it can hold at least
+* twice as many names as the dfa has capacity for states. The index is an open
+* addressing hash table with linear probing.
+* param[in]: dfa - The dfa.
+*/
+void dfaIndexRebuild (dfa *dfa) {
+
+	int indexCapacity = 16;
+	while (indexCapacity < dfa -> capacity * 2) {
+
+		indexCapacity *= 2;
+	}
+
+	free(dfa -> index);
+	dfa -> indexCapacity = indexCapacity;
+	dfa -> index = calloc(indexCapacity, sizeof(state*));
+
+	for (int i = 0; i < dfa -> size; i++) {
+
+		dfaIndexInsert(dfa, dfa -> allStates[i]);
 	}
-	return foundState;
 }
 
 /*
-* description: Validates if current state in the DFA is acceptable or not.
+* description: Inserts a state in the name index of the dfa. If a state with
+* the same name already is indexed, the old state is kept.
 * param[in]: dfa - The dfa.
+* param[in]: state - The state to be indexed.
+*/
+void dfaIndexInsert (dfa *dfa, state *state) {
+
+	unsigned int mask = dfa -> indexCapacity - 1;
+	unsigned int i = dfaHashName(state -> stateName) & mask;
+
+	while (dfa -> index[i] != NULL) {
+
+		if (strcmp(state -> stateName, dfa -> index[i] -> stateName) == 0) {
+
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	dfa -> index[i] = state;
+}
+
+/*
+* description: Advances the cursor over a buffer of input. The state is kept
+* in the cursor, so input may be fed in any number of buffers of any size.
+* param[in]: cursor - The cursor.
+* param[in]: buffer - The input, does not need to be terminated.
+* param[in]: length - Number of chars in the buffer.
+*/
+void dfaFeed (dfaCursor *cursor, const char *buffer, size_t length) {
+
+	cursor -> state = dfaTableRun(cursor -> table, cursor -> state, buffer,
+			length);
+}
+
+/*
+* description: Ends the input fed to the cursor. Tells if the dfa accepts it
+* and resets the cursor for the next input.
+* param[in]: cursor - The cursor.
+* return: true if the input was accepted, else false.
+*/
+bool dfaFinalize (dfaCursor *cursor) {
+
+	bool accepted = cursor -> table -> acceptable[cursor -> state];
+	cursor -> state = cursor -> table -> startState;
+	return accepted;
+}
+
+/*
+* description: Validates if current state of the cursor is acceptable or not.
+* param[in]: cursor - The cursor.
 * return: If acceptable; true, else false.
 */
-bool dfaIsAcceptable (dfa *dfa) {
+bool dfaIsAcceptable (const dfaCursor *cursor) {
+
+	return cursor -> table -> acceptable[cursor -> state];
+}
+
+/*
+* description: Resets the cursor's current state to the starting state.
+* param[in]: cursor - The cursor to be reset.
+*/
+void dfaReset (dfaCursor *cursor) {
+
+	cursor -> state = cursor -> table -> startState;
+}
+
+/*
+* description: Checks if a state in a compiled table has any paths at all.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr).
+* return: true if any key leads out of the error state, else false.
+*/
+bool dfaTableHasPaths (const dfaTable *table, int state) {
+
+	int room[DFA_MAX_CLASSES];
+	const int *row = dfaTableRow(table, state, room);
+
+	for (int i = 0; i < table -> nrOfClasses; i++) {
+
+		if (row[i] != table -> errorState) {
+
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+* description: Compiles the dfa into a transition table. Must be called once
+* the dfa is fully built, any old table is replaced. Paths which have no
+* destination are ignored. If a state has several paths with the same key, the
+* last inserted one is used, just as in pathFindState. The table is dense if
+* it fits in the tableBudget of the dfa, else it is compressed (see comb.h).
+* param[in]: dfa - The dfa to be compiled.
+*/
+void dfaCompile (dfa *dfa) {
+
+	dfaTable *table = malloc(sizeof(struct dfaTable));
+	int classOf[DFA_ALPHABET];
+
+	table -> nrOfClasses = dfaComputeClasses(dfa, classOf);
+	table -> nrOfStates = dfa -> size + 1;
+	table -> errorState = dfa -> size;
+	table -> startState = dfa -> startState != NULL ?
+			dfa -> startState -> stateNr : table -> errorState;
+	table -> next = NULL;
+	table -> comb = NULL;
+	table -> acceptable = calloc(table -> nrOfStates, sizeof(bool));
+	table -> image = NULL;
+	table -> imageSize = 0;
+	table -> nrOfHotStates = 0;
+#ifdef DFA_PROFILE
+	table -> profile = NULL;
+#endif
+
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		table -> classes[i] = classOf[i];
+	}
+	for (int i = 0; i < dfa -> size; i++) {
+
+		table -> acceptable[i] = dfa -> allStates[i] -> acceptable;
+	}
 
-	if (dfa -> currState != NULL) {
+	if ((size_t)table -> nrOfStates * table -> nrOfClasses * sizeof(int) >
+			dfa -> tableBudget) {
 
-		return dfa -> currState -> acceptable;
+		table -> comb = combCompile(dfa, classOf, table -> nrOfClasses);
 	} else {
 
-		return 0;
+		table -> next = malloc(sizeof(int) * table -> nrOfStates *
+				table -> nrOfClasses);
+		for (int i = 0; i < table -> nrOfStates; i++) {
+
+			int *row = &table -> next[(size_t)i * table -> nrOfClasses];
+			if (i < dfa -> size) {
+
+				dfaStateRow(dfa -> allStates[i], classOf,
+						table -> nrOfClasses, table -> errorState, row);
+			} else {
+
+				for (int j = 0; j < table -> nrOfClasses; j++) {
+
+					row[j] = table -> errorState;
+				}
+			}
+		}
+	}
+
+	dfaTableAccelerate(table);
+	dfaTableDecide(table);
+	dfaTableKill(dfa -> table);
+	dfa -> table = table;
+}
+
+/*
+* description: Finds the row of a state as it is compiled, the destination
+* (stateNr) of each class.
+* param[in]: state - The state.
+* param[in]: classOf - The class of each byte.
+* param[in]: nrOfClasses - Number of classes.
+* param[in]: errorState - The error state, where missing paths lead.
+* param[out]: row - The destination of each class.
+*/
+void dfaStateRow (const state *state, const int *classOf, int nrOfClasses,
+		int errorState, int *row) {
+
+	bool isSet[DFA_ALPHABET] = {false};
+
+	for (int i = 0; i < nrOfClasses; i++) {
+
+		row[i] = errorState;
+	}
+
+	//Paths are inserted first in the list, so the first one found wins.
+	for (path *path = state -> paths; path != NULL; path = path -> nextPath) {
+
+		unsigned char key = (unsigned char)path -> key[0];
+		if (path -> destination != NULL && !isSet[key]) {
+
+			row[classOf[key]] = path -> destination -> stateNr;
+			isSet[key] = true;
+		}
+	}
+}
+
+/*
+* description: Finds the row of a state in a compiled table.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr).
+* param[out]: row - Room for nrOfClasses states, filled if the table is
+* compressed.
+* return: The row, in the table itself if it is dense, else row.
+*/
+const int *dfaTableRow (const dfaTable *table, int state, int *row) {
+
+	if (table -> next != NULL) {
+
+		return &table -> next[(size_t)state * table -> nrOfClasses];
 	}
+	combRow(table -> comb, state, table -> nrOfClasses, row);
+	return row;
 }
 
 /*
-* description: Resets the DFA's current state to its starting state.
-* param[in]: dfa - The dfa to be reset.
+* description: Finds the exit bytes of every state of a compiled table and
+* marks the states which can be accelerated.
+* param[in]: table - The compiled table, with classes and next set.
 */
-void dfaReset (dfa *dfa) {
+void dfaTableAccelerate (dfaTable *table) {
+
+	int classSize[DFA_MAX_CLASSES] = {0};
+	int room[DFA_MAX_CLASSES];
 
-	dfa -> currState = dfa -> startState;
+	table -> exits = calloc(table -> nrOfStates, sizeof(dfaExit));
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		classSize[table -> classes[i]]++;
+	}
+
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		const int *row = dfaTableRow(table, i, room);
+		dfaExit *exit = &table -> exits[i];
+		int nrOfBytes = 0;
+
+		for (int j = 0; j < table -> nrOfClasses &&
+				nrOfBytes <= DFA_EXIT_BYTES; j++) {
+
+			if (row[j] != i) {
+
+				nrOfBytes += classSize[j];
+			}
+		}
+
+		exit -> accelerated = nrOfBytes <= DFA_EXIT_BYTES;
+		exit -> nrOfBytes = 0;
+		for (int j = 0; exit -> accelerated && j < DFA_ALPHABET; j++) {
+
+			if (row[table -> classes[j]] != i) {
+
+				exit -> bytes[exit -> nrOfBytes++] = j;
+			}
+		}
+	}
+}
+
+/*
+* description: Decides the outcome of every state of a compiled table. The
+* states that can reach an acceptable state are found by searching backwards
+* from the acceptable states, all others are dead. An acceptable state that
+* only leads to itself is an accept-sink.
+* param[in]: table - The compiled table, with next and acceptable set.
+*/
+void dfaTableDecide (dfaTable *table) {
+
+	int nrOfStates = table -> nrOfStates;
+	int room[DFA_MAX_CLASSES];
+	int *seen = malloc(sizeof(int) * nrOfStates);
+	size_t *first = calloc((size_t)nrOfStates + 1, sizeof(size_t));
+	int *sources;
+	int *queue = malloc(sizeof(int) * nrOfStates);
+	int head = 0;
+	int tail = 0;
+
+	table -> outcome = malloc(nrOfStates);
+
+	//Counts the distinct states leading into every state. The rows are read
+	//again below rather than held, a compressed table has no room for them.
+	for (int i = 0; i < nrOfStates; i++) {
+
+		seen[i] = -1;
+	}
+	for (int i = 0; i < nrOfStates; i++) {
+
+		const int *row = dfaTableRow(table, i, room);
+
+		for (int j = 0; j < table -> nrOfClasses; j++) {
+
+			if (row[j] != i && seen[row[j]] != i) {
+
+				seen[row[j]] = i;
+				first[row[j] + 1]++;
+			}
+		}
+	}
+	for (int i = 0; i < nrOfStates; i++) {
+
+		first[i + 1] += first[i];
+	}
+
+	//Lists the states leading into every state from first[state] on, moving
+	//first one step up while filling and back down afterwards.
+	sources = malloc(sizeof(int) * (first[nrOfStates] + 1));
+	for (int i = 0; i < nrOfStates; i++) {
+
+		seen[i] = -1;
+	}
+	for (int i = 0; i < nrOfStates; i++) {
+
+		const int *row = dfaTableRow(table, i, room);
+
+		for (int j = 0; j < table -> nrOfClasses; j++) {
+
+			if (row[j] != i && seen[row[j]] != i) {
+
+				seen[row[j]] = i;
+				sources[first[row[j]]++] = i;
+			}
+		}
+	}
+	for (int i = nrOfStates; i > 0; i--) {
+
+		first[i] = first[i - 1];
+	}
+	first[0] = 0;
+
+	//Every state that can reach an acceptable state is open, the rest dead.
+	for (int i = 0; i < nrOfStates; i++) {
+
+		if (table -> acceptable[i]) {
+
+			table -> outcome[i] = DFA_OPEN;
+			queue[tail++] = i;
+		} else {
+
+			table -> outcome[i] = DFA_DEAD;
+		}
+	}
+	while (head < tail) {
+
+		int state = queue[head++];
+
+		for (size_t k = first[state]; k < first[state + 1]; k++) {
+
+			if (table -> outcome[sources[k]] == DFA_DEAD) {
+
+				table -> outcome[sources[k]] = DFA_OPEN;
+				queue[tail++] = sources[k];
+			}
+		}
+	}
+
+	//Of the states left, an acceptable state that only leads to itself is
+	//an accept-sink.
+	for (int i = 0; i < nrOfStates; i++) {
+
+		const int *row;
+		bool sink = table -> acceptable[i];
+
+		if (sink) {
+
+			row = dfaTableRow(table, i, room);
+		}
+		for (int j = 0; j < table -> nrOfClasses && sink; j++) {
+
+			sink = row[j] == i;
+		}
+		if (sink) {
+
+			table -> outcome[i] = DFA_ACCEPT_SINK;
+		}
+	}
+
+	free(seen);
+	free(first);
+	free(sources);
+	free(queue);
+}
+
+/*
+* description: Finds the first exit byte of an accelerated state.
+* param[in]: exit - The exit bytes of the state.
+* param[in]: input - The input to search.
+* param[in]: length - Number of bytes in the input.
+* return: Index of the first exit byte, or length if there is none.
+*/
+size_t dfaSkip (const dfaExit *exit, const unsigned char *input,
+		size_t length) {
+
+	size_t i = 0;
+
+	if (exit -> nrOfBytes == 0) {
+
+		return length;
+	}
+	if (exit -> nrOfBytes == 1) {
+
+		const unsigned char *found = memchr(input, exit -> bytes[0], length);
+		return found != NULL ? (size_t)(found - input) : length;
+	}
+
+#ifdef __SSE2__
+	//Compare 16 bytes at a time against every exit byte.
+	__m128i wanted[DFA_EXIT_BYTES];
+	for (int j = 0; j < exit -> nrOfBytes; j++) {
+
+		wanted[j] = _mm_set1_epi8((char)exit -> bytes[j]);
+	}
+	for (; i + 16 <= length; i += 16) {
+
+		__m128i block = _mm_loadu_si128((const __m128i *)(input + i));
+		__m128i hits = _mm_cmpeq_epi8(block, wanted[0]);
+
+		for (int j = 1; j < exit -> nrOfBytes; j++) {
+
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, wanted[j]));
+		}
+
+		int mask = _mm_movemask_epi8(hits);
+		if (mask != 0) {
+
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < length; i++) {
+
+		for (int j = 0; j < exit -> nrOfBytes; j++) {
+
+			if (input[i] == exit -> bytes[j]) {
+
+				return i;
+			}
+		}
+	}
+	return length;
+}
+
+/*
+* description: Splits the bytes into classes, so that bytes in the same class
+* lead to the same state from every state. Each state refines the classes by
+* the destinations of its paths.
+* param[in]: dfa - The dfa.
+* param[out]: classOf - The class of each byte.
+* return: Number of classes.
+*/
+int dfaComputeClasses (dfa *dfa, int *classOf) {
+
+	int nrOfClasses = 1;
+	int seen[DFA_ALPHABET];
+	keyPair pairs[DFA_ALPHABET];
+
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		classOf[i] = 0;
+		seen[i] = -1;
+	}
+
+	for (int i = 0; i < dfa -> size; i++) {
+
+		int nrOfPairs = 0;
+		for (path *path = dfa -> allStates[i] -> paths; path != NULL;
+				path = path -> nextPath) {
+
+			unsigned char key = (unsigned char)path -> key[0];
+			if (path -> destination != NULL && seen[key] != i) {
+
+				seen[key] = i;
+				pairs[nrOfPairs].key = key;
+				pairs[nrOfPairs].class = classOf[key];
+				pairs[nrOfPairs].destination = path -> destination -> stateNr;
+				nrOfPairs++;
+			}
+		}
+
+		//Keys of the same class leading to the same state stay together.
+		qsort(pairs, nrOfPairs, sizeof(keyPair), dfaCompareKeyPairs);
+		for (int j = 0; j < nrOfPairs; j++) {
+
+			if (j == 0 || dfaCompareKeyPairs(&pairs[j - 1], &pairs[j]) != 0) {
+
+				nrOfClasses++;
+			}
+			classOf[pairs[j].key] = nrOfClasses - 1;
+		}
+		if (nrOfPairs > 0) {
+
+			nrOfClasses = dfaCompactClasses(classOf);
+		}
+	}
+	return nrOfClasses;
+}
+
+/*
+* description: Renumbers classes so that they are numbered from 0 without gaps,
+* in order of their first byte. Class 0 is kept as class 0.
+* param[in]: classOf - The class of each byte.
+* return: Number of classes.
+*/
+int dfaCompactClasses (int *classOf) {
+
+	int newClass[DFA_ALPHABET + DFA_MAX_CLASSES];
+	int nrOfClasses = 1;
+
+	newClass[0] = 0;
+	for (int i = 1; i < DFA_ALPHABET + DFA_MAX_CLASSES; i++) {
+
+		newClass[i] = -1;
+	}
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		if (newClass[classOf[i]] < 0) {
+
+			newClass[classOf[i]] = nrOfClasses++;
+		}
+		classOf[i] = newClass[classOf[i]];
+	}
+	return nrOfClasses;
+}
+
+/*
+* description: Compares two key pairs by class and then destination, for qsort.
+* param[in]: a - The first key pair.
+* param[in]: b - The second key pair.
+* return: Negative, zero or positive as a is before, same as or after b.
+*/
+int dfaCompareKeyPairs (const void *a, const void *b) {
+
+	const keyPair *first = a;
+	const keyPair *second = b;
+
+	if (first -> class != second -> class) {
+
+		return first -> class < second -> class ? -1 : 1;
+	}
+	if (first -> destination != second -> destination) {
+
+		return first -> destination < second -> destination ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+* description: Checks if a byte is a key of any path in a compiled dfa.
+* param[in]: table - The compiled table.
+* param[in]: key - The byte.
+* return: true if the byte is in the alphabet, else false.
+*/
+bool dfaInAlphabet (const dfaTable *table, char key) {
+
+	return table -> classes[(unsigned char)key] != 0;
+}
+
+/*
+* description: Runs a string through the compiled dfa, using only the
+* transition table.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr) to start from.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: The state (stateNr) the dfa ends in. If the string leaves the
+* alphabet the error state is returned.
+*/
+int dfaRun (const dfa *dfa, int state, const char *string, size_t length) {
+
+	return dfaTableRun(dfa -> table, state, string, length);
+}
+
+/*
+* description: Runs a string through a compiled table. This is the loop all
+* runs of a compiled dfa share. When a byte leaves the run in the same state
+* and that state is accelerated, the run skips to its next exit byte. When
+* that state is decided the run stops there.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr) to start from.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: The state (stateNr) the table ends in, or a decided state with the
+* same outcome for any further input.
+*/
+int dfaTableRun (const dfaTable *table, int state, const char *string,
+		size_t length) {
+
+	const int *next = table -> next;
+	const unsigned short *classes = table -> classes;
+	const int nrOfClasses = table -> nrOfClasses;
+	const dfaExit *exits = table -> exits;
+	const unsigned char *outcome = table -> outcome;
+	const unsigned char *input = (const unsigned char *)string;
+
+	for (size_t i = 0; i < length; i++) {
+
+		int prevState = state;
+		state = next != NULL ?
+				next[(size_t)state * nrOfClasses + classes[input[i]]] :
+				dfaCombMove(table -> comb, state, classes[input[i]]);
+#ifdef DFA_PROFILE
+		profileMove(table, prevState, classes[input[i]]);
+#endif
+
+		//Only a state that loops is worth looking up the exits of.
+		if (state == prevState) {
+
+			if (outcome[state] != DFA_OPEN) {
+
+#ifdef DFA_PROFILE
+				profileStop(table, length - i - 1);
+#endif
+				break;
+			}
+			if (exits[state].accelerated) {
+
+				size_t skipped = dfaSkip(&exits[state], input + i + 1,
+						length - i - 1);
+#ifdef DFA_PROFILE
+				profileSkip(table, state, input + i + 1, skipped);
+#endif
+				i += skipped;
+			}
+		}
+	}
+	return state;
+}
+
+/*
+* description: Runs a whole string from the start state of the compiled dfa.
+* param[in]: dfa - The compiled dfa.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the dfa accepts the string, else false.
+*/
+bool dfaAccepts (const dfa *dfa, const char *string, size_t length) {
+
+	int state = dfaRun(dfa, dfa -> table -> startState, string, length);
+	return dfa -> table -> acceptable[state];
+}
+
+/*
+* description: Frees all memory allocated by a compiled transition table, or
+* unmaps the image it was loaded from.
+* param[in]: table - A pointer to the table.
+*/
+void dfaTableKill (dfaTable *table) {
+
+	if (table != NULL) {
+
+		if (table -> image != NULL) {
+
+			munmap(table -> image, table -> imageSize);
+		} else {
+
+			free(table -> next);
+			free(table -> acceptable);
+			free(table -> exits);
+			free(table -> outcome);
+		}
+		combKill(table -> comb);
+#ifdef DFA_PROFILE
+		profileKill(table -> profile);
+#endif
+		free(table);
+	}
 }
 
 /*
@@ -220,46 +956,30 @@ void dfaPrint (dfa *dfa) {
 }
 
 /*
-* description: Frees all memeory allocated by and in the dfa.
+* description: Frees all memeory allocated by and in the dfa. States, paths
+* and names go with the arena in one go.
 * param[in]: dfa - A pointer to the dfa.
 */
 void dfaKill (dfa *dfa) {
 
-    for (int i = 0; i < dfa -> capacity; i++) {
-
-		if (dfa -> allStates[i] != NULL) {
-			stateKill(dfa -> allStates[i]);
-			dfa -> allStates[i] = NULL;
-		}
-    }
+    arenaKill(dfa -> arena);
+    dfaTableKill(dfa -> table);
+    free(dfa -> index);
     free(dfa -> allStates);
     free(dfa);
 }
 
 /*
-* description: Frees all memory allocated by and in the state.
-* param[in]: state - A pointer to the state.
-*/
-void stateKill (state *state) {
-
-	if (state -> stateName != NULL) {
-
-		free(state -> stateName);
-	}
-	pathKill(state -> paths);
-	free(state);
-}
-
-/*
-* description: Allocates memory for a new path. Insterts an initial key for the
-* path.
+* description: Allocates memory for a new path from an arena. Insterts an
+* initial key for the path, which is copied into the arena.
+* param[in]: arena - The arena of the dfa the path is in.
 * param[in]: key - Pointer to the alpabetical key / name of the path.
 * param[in]: destination - A pointer to the destination the key points to.
 * return: The path.
 */
-path *pathEmpty(char *key, state* destination) {
-	path *path = malloc(sizeof(*path));
-	path -> key = key;
+path *pathEmpty(arena *arena, const char *key, state* destination) {
+	path *path = arenaAlloc(arena, sizeof(*path));
+	path -> key = arenaString(arena, key);
 	path -> destination = destination;
 	path -> nextPath = NULL;
 	return path;
@@ -267,19 +987,21 @@ path *pathEmpty(char *key, state* destination) {
 
 /*
 * description: Inserts a new path to a path.
+* param[in]: arena - The arena of the dfa the state is in.
 * param[in]: fromState - State that path goes from.
 * param[in]: key - Alphabetical key / name of the path.
 * param[in]: destination - The state that path will lead too.
 */
-void pathInsert(state *fromState, char* key, state* destination) {
+void pathInsert(arena *arena, state *fromState, const char *key,
+		state *destination) {
 
 	if (fromState -> paths == NULL ) {
 
-		fromState -> paths = pathEmpty(key, destination);
+		fromState -> paths = pathEmpty(arena, key, destination);
 	} else {
 
 		struct path *tempPath = fromState -> paths;
-		fromState -> paths = pathEmpty(key, destination);
+		fromState -> paths = pathEmpty(arena, key, destination);
 		fromState -> paths -> nextPath = tempPath;
 	}
 }
@@ -307,22 +1029,3 @@ state *pathFindState(path* path, char* key) {
 	}
 	return foundState;
 }
-
-/*
-* description:Frees all memeory allocated by and in the path.
-* param[in]: path - Pointer to the path.
-*/
-void pathKill (path *path) {
-
-	while (path != NULL) {
-
-		struct path *tempPath = path;
-		path = path -> nextPath;
-
-		if (tempPath -> key != NULL) {
-
-			free(tempPath -> key);
-		}
-		free(tempPath);
-	}
-}
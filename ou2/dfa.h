@@ -7,6 +7,13 @@
 * -> Q2 for example) can only be one characther long and must. The alphabet
 * must be consisting of numbers or letters.
 *
+* All states, paths and names of a dfa are allocated from an arena owned by
+* the dfa, and are freed all at once by dfaKill.
+*
+* Once built and compiled the dfa is never changed by running it. A run is
+* kept track of by a dfaCursor, which only holds the current state, so any
+* number of cursors (in any number of threads) can share the same dfa.
+*
 * Authors:
 * Buster Hultgren Warn <dv17bhn@cs.umu.se>
 * Victor Liljeholm <dv13vlm@cs.umu.se>
@@ -22,10 +29,38 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
+
 typedef int bool;
 #define true 1
 #define false 0
 
+/*
+* Number of possible input bytes. A compiled dfa maps every byte to a class,
+* so there can be one class more than there are bytes.
+*/
+#define DFA_ALPHABET 256
+#define DFA_MAX_CLASSES (DFA_ALPHABET + 1)
+
+/*
+* Most bytes a state may leave on and still be skipped through with a byte
+* search, see dfaExit.
+*/
+#define DFA_EXIT_BYTES 3
+
+/*
+* What a compiled state tells about the outcome of a run, see dfaTable.
+*/
+#define DFA_OPEN 0
+#define DFA_DEAD 1
+#define DFA_ACCEPT_SINK 2
+
+/*
+* Most bytes a dense table may use before a dfa is compiled into a compressed
+* table instead, see dfaCompile.
+*/
+#define DFA_TABLE_BUDGET ((size_t)1 << 30)
+
 
 typedef struct state {
 
@@ -42,13 +77,132 @@ typedef struct path {
 	struct state *destination;
 } path;
 
+/*
+* A compiled DFA. All transitions are frozen into one contiguous table indexed
+* by [state][class], where state is the stateNr of the state. One extra row is
+* added last, the error state, which every missing path leads to and which
+* never leaves itself. This way a lookup never has to check for a missing path.
+*
+* Bytes which lead to the same state from every state share a class, and
+* classes maps each byte to its class. Class 0 holds the bytes which no state
+* has a path for, that is the bytes outside the alphabet, and always leads to
+* the error state.
+*
+* A table loaded from a binary image (see image.h) points into the mapped
+* image instead of owning next and acceptable, image is then the mapping.
+*
+* exits holds, for every state, the bytes that lead out of it (see dfaExit).
+* outcome tells for every state if the outcome of a run is already decided
+* once the run is in it. It is DFA_DEAD for a state from which no acceptable
+* state can be reached, DFA_ACCEPT_SINK for an acceptable state that only
+* leads to itself and DFA_OPEN otherwise. In a minimized dfa the accept-sink
+* is the only state from which only acceptable states can be reached. A run
+* may stop as soon as it reaches a decided state. exits and outcome are owned
+* by the table, or point into the image.
+*
+* nrOfHotStates is the number of states first in the table that a training
+* run visited, if the states were ordered hot first (see order.h), else 0.
+* Built with DFA_PROFILE, profile holds the counts of the runs of the table
+* once they are counted (see profile.h), else it is NULL.
+*
+* A table whose rows would not fit in the budget of its dfa is compressed (see
+* dfaComb), next is then NULL. Its moves are found by dfaTableMove and its
+* rows by dfaTableRow, which work for any table.
+*/
+typedef struct dfaTable {
+
+	int nrOfStates;
+	int nrOfClasses;
+	int startState;
+	int errorState;
+	unsigned short classes[DFA_ALPHABET];
+	int *next;
+	struct dfaComb *comb;
+	bool *acceptable;
+	struct dfaExit *exits;
+	unsigned char *outcome;
+	void *image;
+	size_t imageSize;
+	int nrOfHotStates;
+#ifdef DFA_PROFILE
+	struct profileCounts *profile;
+#endif
+} dfaTable;
+
+/*
+* The bytes that lead out of a state. If a state loops on every byte but at
+* most DFA_EXIT_BYTES of them, it is accelerated: a run that stays in it can
+* search ahead for the next of those bytes instead of looking up every byte.
+* A sink, such as the error state, has no exit bytes at all.
+*/
+typedef struct dfaExit {
+
+	bool accelerated;
+	int nrOfBytes;
+	unsigned char bytes[DFA_EXIT_BYTES];
+} dfaExit;
+
+/*
+* A compressed table (see comb.h). Only the moves of a state that differ from
+* the moves of its fallback are kept, in slots: the move on class c is in slot
+* base + c if the check of that slot is the state, else it is the move of the
+* fallback on c. The fallback of the error state is itself, and it has no
+* slots, so every state without a move of its own leads to the error state.
+* Rows of different states are packed into the same slots wherever they do
+* not collide.
+*/
+typedef struct dfaCombRow {
+
+	int base;
+	int fallback;
+} dfaCombRow;
+
+typedef struct dfaCombSlot {
+
+	int check;
+	int next;
+} dfaCombSlot;
+
+typedef struct dfaComb {
+
+	dfaCombRow *rows;
+	dfaCombSlot *slots;
+	int nrOfSlots;
+	int errorState;
+} dfaComb;
+
+/*
+* A key of a state while computing the byte classes: the byte, its class and
+* the state its path leads to.
+*/
+typedef struct keyPair {
+
+	int key;
+	int class;
+	int destination;
+} keyPair;
+
+/*
+* A run of a compiled dfa. Holds the current state (stateNr) of the run and
+* the table it runs on, which is only read.
+*/
+typedef struct dfaCursor {
+
+	const struct dfaTable *table;
+	int state;
+} dfaCursor;
+
 typedef struct dfa {
 
     int capacity;
 	int size;
     struct state **allStates;
     struct state *startState;
-    struct state *currState;
+	struct dfaTable *table;
+	size_t tableBudget;
+	int indexCapacity;
+	struct state **index;
+	struct arena *arena;
 } dfa;
 
 /*
@@ -76,34 +230,45 @@ void dfaSetStates (dfa *dfa, int capacity);
 * param[in]: dfa - A pointer to the dfa.
 * param[in]: startState - the state to be set to startState.
 */
-void dfaSetStart (dfa *dfa, char *stateName);
+void dfaSetStart (dfa *dfa, const char *stateName);
 
 /*
 * description: If number of inserted states is smaller than the DFA's capacity,
-* allocate memory for and insert a state.
+* allocate memory for and insert a state. The name is copied into the dfa.
 * param[in]: dfa - A pointer to the dfa.
 * param[in]: acceptable - tells if the state is to be acceptlable or not.
 * param[in]: stateName - The name of the state.
 */
-void dfaInsertState (dfa *dfa, bool acceptable, char *stateName);
+void dfaInsertState (dfa *dfa, bool acceptable, const char *stateName);
 
 /*
-* description: Modifies a state by adding a path.
+* description: Modifies a state by adding a path. The key is copied into the
+* dfa. Nothing is added if any of the arguments is missing.
 * param[in]: dfa - Pointer to dfa which includes the state.
 * param[in]: fromState - Pointer to the state which path are to be modified.
 * param[in]: path - The alpabetical key of the path.
 * param[in]: toState - The state to which the path leads to.
 */
-void dfaModifyState (dfa *dfa, char *fromState, char *path, char *toState);
+void dfaModifyState (dfa *dfa, const char *fromState, const char *path,
+		const char *toState);
+
+/*
+* description: Sets up a cursor to run a compiled dfa from its start state.
+* param[out]: cursor - The cursor.
+* param[in]: dfa - The compiled dfa.
+*/
+void dfaCursorInit (dfaCursor *cursor, const dfa *dfa);
 
 /*
-* description: Changes the current state of the dfa by one of the paths
+* description: Changes the current state of the cursor by one of the paths
 * connected to the current state.
-* param[in]: dfa - Pointer to the dfa.
+* param[in]: cursor - Pointer to the cursor.
 * param[in]: path - The alphabetical key to one of the paths connected to the
 * current state.
+* return: 1 if the path was followed, 0 if the current state has no path with
+* the key and -1 if the current state has no paths at all.
 */
-int dfaChangeState (dfa *dfa, char *key);
+int dfaChangeState (dfaCursor *cursor, char *key);
 
 /*
 * description: Finds a particular state in the DFA.
@@ -111,20 +276,251 @@ int dfaChangeState (dfa *dfa, char *key);
 * param[in]: stateName - The name of the state to be found.
 * return: If found; the state, else NULL.
 */
-state *dfaFindState(dfa *dfa, char *stateName);
+state *dfaFindState(dfa *dfa, const char *stateName);
+
+/*
+* description: Hashes a state name with FNV-1a.
+* param[in]: stateName - The name to be hashed.
+* return: The hash of the name.
+*/
+unsigned int dfaHashName (const char *stateName);
+
+/*
+* description: Hashes the first chars of a string with FNV-1a.
+* param[in]: name - The chars, do not need to be terminated.
+* param[in]: length - Number of chars.
+* return: The hash of the chars.
+*/
+unsigned int dfaHashSubstring (const char *name, size_t length);
+
+/*
+* description: Rebuilds the name index of the dfa so that it can hold at least
+* twice as many names as the dfa has capacity for states. The index is an open
+* addressing hash table with linear probing.
+* param[in]: dfa - The dfa.
+*/
+void dfaIndexRebuild (dfa *dfa);
 
 /*
-* description: Validates if current state in the DFA is acceptable or not.
+* description: Inserts a state in the name index of the dfa. If a state with
+* the same name already is indexed, the old state is kept.
 * param[in]: dfa - The dfa.
+* param[in]: state - The state to be indexed.
+*/
+void dfaIndexInsert (dfa *dfa, state *state);
+
+/*
+* description: Advances the cursor over a buffer of input. The state is kept
+* in the cursor, so input may be fed in any number of buffers of any size.
+* param[in]: cursor - The cursor.
+* param[in]: buffer - The input, does not need to be terminated.
+* param[in]: length - Number of chars in the buffer.
+*/
+void dfaFeed (dfaCursor *cursor, const char *buffer, size_t length);
+
+/*
+* description: Ends the input fed to the cursor. Tells if the dfa accepts it
+* and resets the cursor for the next input.
+* param[in]: cursor - The cursor.
+* return: true if the input was accepted, else false.
+*/
+bool dfaFinalize (dfaCursor *cursor);
+
+/*
+* description: Validates if current state of the cursor is acceptable or not.
+* param[in]: cursor - The cursor.
 * return: If acceptable; 1, else 0.
 */
-bool dfaIsAcceptable (dfa *dfa);
+bool dfaIsAcceptable (const dfaCursor *cursor);
+
+/*
+* description: Resets the cursor's current state to the starting state.
+* param[in]: cursor - The cursor to be reset.
+*/
+void dfaReset (dfaCursor *cursor);
+
+/*
+* description: Checks if a state in a compiled table has any paths at all.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr).
+* return: true if any key leads out of the error state, else false.
+*/
+bool dfaTableHasPaths (const dfaTable *table, int state);
+
+/*
+* description: Compiles the dfa into a transition table. Must be called once
+* the dfa is fully built, any old table is replaced. Paths which have no
+* destination are ignored. If a state has several paths with the same key, the
+* last inserted one is used, just as in pathFindState. The table is dense if
+* it fits in the tableBudget of the dfa, else it is compressed (see comb.h).
+* param[in]: dfa - The dfa to be compiled.
+*/
+void dfaCompile (dfa *dfa);
+
+/*
+* description: Finds the row of a state as it is compiled, the destination
+* (stateNr) of each class.
+* param[in]: state - The state.
+* param[in]: classOf - The class of each byte.
+* param[in]: nrOfClasses - Number of classes.
+* param[in]: errorState - The error state, where missing paths lead.
+* param[out]: row - The destination of each class.
+*/
+void dfaStateRow (const state *state, const int *classOf, int nrOfClasses,
+		int errorState, int *row);
+
+/*
+* description: Finds the row of a state in a compiled table.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr).
+* param[out]: row - Room for nrOfClasses states, filled if the table is
+* compressed.
+* return: The row, in the table itself if it is dense, else row.
+*/
+const int *dfaTableRow (const dfaTable *table, int state, int *row);
+
+/*
+* description: Finds the move of a state in a compressed table, following the
+* fallbacks until a state has a move of its own.
+* param[in]: comb - The compressed table.
+* param[in]: state - The state (stateNr).
+* param[in]: class - The class moved on.
+* return: The state (stateNr) moved to.
+*/
+static inline int dfaCombMove (const dfaComb *comb, int state, int class) {
+
+	while (state != comb -> errorState) {
+
+		const dfaCombSlot *slot = &comb -> slots[comb -> rows[state].base +
+				class];
+		if (slot -> check == state) {
+
+			return slot -> next;
+		}
+		state = comb -> rows[state].fallback;
+	}
+	return state;
+}
+
+/*
+* description: Finds the move of a state in a compiled table, dense or
+* compressed.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr).
+* param[in]: class - The class moved on.
+* return: The state (stateNr) moved to.
+*/
+static inline int dfaTableMove (const dfaTable *table, int state, int class) {
+
+	if (table -> next != NULL) {
+
+		return table -> next[(size_t)state * table -> nrOfClasses + class];
+	}
+	return dfaCombMove(table -> comb, state, class);
+}
+
+/*
+* description: Finds the exit bytes of every state of a compiled table and
+* marks the states which can be accelerated.
+* param[in]: table - The compiled table, with classes and next set.
+*/
+void dfaTableAccelerate (dfaTable *table);
+
+/*
+* description: Decides the outcome of every state of a compiled table. The
+* states that can reach an acceptable state are found by searching backwards
+* from the acceptable states, all others are dead. An acceptable state that
+* only leads to itself is an accept-sink.
+* param[in]: table - The compiled table, with next and acceptable set.
+*/
+void dfaTableDecide (dfaTable *table);
 
 /*
-* description: Resets the DFA's current state to its starting state.
-* param[in]: dfa - The dfa to be reset.
+* description: Finds the first exit byte of an accelerated state.
+* param[in]: exit - The exit bytes of the state.
+* param[in]: input - The input to search.
+* param[in]: length - Number of bytes in the input.
+* return: Index of the first exit byte, or length if there is none.
 */
-void dfaReset (dfa *dfa);
+size_t dfaSkip (const dfaExit *exit, const unsigned char *input,
+		size_t length);
+
+/*
+* description: Splits the bytes into classes, so that bytes in the same class
+* lead to the same state from every state. Each state refines the classes by
+* the destinations of its paths.
+* param[in]: dfa - The dfa.
+* param[out]: classOf - The class of each byte.
+* return: Number of classes.
+*/
+int dfaComputeClasses (dfa *dfa, int *classOf);
+
+/*
+* description: Renumbers classes so that they are numbered from 0 without gaps,
+* in order of their first byte. Class 0 is kept as class 0.
+* param[in]: classOf - The class of each byte.
+* return: Number of classes.
+*/
+int dfaCompactClasses (int *classOf);
+
+/*
+* description: Compares two key pairs by class and then destination, for qsort.
+* param[in]: a - The first key pair.
+* param[in]: b - The second key pair.
+* return: Negative, zero or positive as a is before, same as or after b.
+*/
+int dfaCompareKeyPairs (const void *a, const void *b);
+
+/*
+* description: Checks if a byte is a key of any path in a compiled dfa.
+* param[in]: table - The compiled table.
+* param[in]: key - The byte.
+* return: true if the byte is in the alphabet, else false.
+*/
+bool dfaInAlphabet (const dfaTable *table, char key);
+
+/*
+* description: Runs a string through the compiled dfa, using only the
+* transition table.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr) to start from.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: The state (stateNr) the dfa ends in. If the string leaves the
+* alphabet the error state is returned.
+*/
+int dfaRun (const dfa *dfa, int state, const char *string, size_t length);
+
+/*
+* description: Runs a string through a compiled table. This is the loop all
+* runs of a compiled dfa share. When a byte leaves the run in the same state
+* and that state is accelerated, the run skips to its next exit byte. When
+* that state is decided the run stops there.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr) to start from.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: The state (stateNr) the table ends in, or a decided state with the
+* same outcome for any further input.
+*/
+int dfaTableRun (const dfaTable *table, int state, const char *string,
+		size_t length);
+
+/*
+* description: Runs a whole string from the start state of the compiled dfa.
+* param[in]: dfa - The compiled dfa.
+* param[in]: string - The string to be run, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the dfa accepts the string, else false.
+*/
+bool dfaAccepts (const dfa *dfa, const char *string, size_t length);
+
+/*
+* description: Frees all memory allocated by a compiled transition table, or
+* unmaps the image it was loaded from.
+* param[in]: table - A pointer to the table.
+*/
+void dfaTableKill (dfaTable *table);
 
 /*
 * description: Help function to print DFA states and paths during development.
@@ -133,33 +529,31 @@ void dfaReset (dfa *dfa);
 void dfaPrint (dfa *dfa);
 
 /*
-* description: Frees all memeory allocated by and in the dfa.
+* description: Frees all memeory allocated by and in the dfa. States, paths
+* and names go with the arena in one go.
 * param[in]: dfa - A pointer to the dfa.
 */
 void dfaKill (dfa *dfa);
 
 /*
-* description: Frees all memory allocated by and in the state.
-* param[in]: state - A pointer to the state.
-*/
-void stateKill (state *state);
-
-/*
-* description: Allocates memory for a new path. Insterts an initial key for the
-* path.
+* description: Allocates memory for a new path from an arena. Insterts an
+* initial key for the path, which is copied into the arena.
+* param[in]: arena - The arena of the dfa the path is in.
 * param[in]: key - Pointer to the alpabetical key / name of the path.
 * param[in]: destination - A pointer to the destination the key points to.
 * return: The path.
 */
-path *pathEmpty(char *key, state *destination);
+path *pathEmpty(arena *arena, const char *key, state *destination);
 
 /*
 * description: Inserts a new path to a path.
+* param[in]: arena - The arena of the dfa the state is in.
 * param[in]: fromState - State that path goes from.
 * param[in]: key - Alphabetical key / name of the path.
 * param[in]: destination - The state that path will lead too.
 */
-void pathInsert(state *fromState, char *key, state *destination);
+void pathInsert(arena *arena, state *fromState, const char *key,
+		state *destination);
 
 /*
 * description: Finds a state in a path.
@@ -169,10 +563,4 @@ void pathInsert(state *fromState, char *key, state *destination);
 */
 state *pathFindState(path *path, char *key);
 
-/*
-* description:Frees all memeory allocated by and in the path.
-* param[in]: path - Pointer to the path.
-*/
-void pathKill (path *path);
-
 #endif //DFAMGENERATOR
@@ -0,0 +1,307 @@
+/*
+* emit: Writes a compiled dfa as C source, a standalone matcher with no
+* dependencies on this program. The byte classes become a constant table and
+* every state becomes a label, whose switch on the class of the next byte
+* jumps straight to the label of the next state. Paths into a dead state or
+* an accept-sink are replaced by returning the outcome at once.
+*
+* The generated file defines one function, <name>Accepts, with the same
+* semantics as dfaAccepts. Only states reachable from the start state are
+* written.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include <ctype.h>
+
+#include "emit.h"
+#include "image.h"
+
+/*
+* description: Writes the dfa as C source.
+* param[in]: dfa - The compiled dfa, built or loaded from an image.
+* param[in]: fileName - The file to write to, NULL for stdout.
+* param[in]: name - Prefix of the names in the generated code, must be a C
+* identifier.
+* return: 1 if the source was written, else 0.
+*/
+int emitC (const dfa *dfa, const char *fileName, const char *name) {
+
+	const dfaTable *table = dfa -> table;
+
+	if (!emitIsIdentifier(name)) {
+
+		fprintf(stderr, "'%s' is not a valid C name\n", name);
+		return 0;
+	}
+
+	FILE *fp = fileName != NULL ? fopen(fileName, "w") : stdout;
+	if (fp == NULL) {
+
+		fprintf(stderr, "Cannot write '%s'\n", fileName);
+		return 0;
+	}
+
+	fprintf(fp, "/*\n* Generated by rundfa --emit-c, do not edit.\n"
+			"* States: %d, byte classes: %d.\n*/\n\n", table -> nrOfStates,
+			table -> nrOfClasses);
+	fprintf(fp, "#include <stddef.h>\n\n");
+	if (table -> outcome[table -> startState] == DFA_OPEN) {
+
+		emitClasses(table, name, fp);
+	}
+
+	fprintf(fp, "/*\n* description: Runs a string through the dfa.\n"
+			"* param[in]: string - The string, does not need to be "
+			"terminated.\n"
+			"* param[in]: length - Number of chars in the string.\n"
+			"* return: 1 if the dfa accepts the string, else 0.\n*/\n");
+	fprintf(fp, "int %sAccepts (const char *string, size_t length) {\n\n",
+			name);
+	if (table -> outcome[table -> startState] == DFA_OPEN) {
+
+		fprintf(fp, "\tconst unsigned char *curr = (const unsigned char *)"
+				"string;\n\tconst unsigned char *end = curr + length;\n\n");
+	} else {
+
+		fprintf(fp, "\t(void)string;\n\t(void)length;\n");
+	}
+	fprintf(fp, "\t");
+	emitTarget(table, table -> startState, fp);
+
+	bool *reachable = emitReachable(table);
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (reachable[i]) {
+
+			emitState(dfa, i, name, fp);
+		}
+	}
+	free(reachable);
+	fprintf(fp, "}\n");
+
+	bool written = !ferror(fp);
+	if (fileName != NULL && fclose(fp) != 0) {
+
+		written = false;
+	}
+	if (!written) {
+
+		fprintf(stderr, "Could not write '%s'\n",
+				fileName != NULL ? fileName : "stdout");
+	}
+	return written;
+}
+
+/*
+* description: Writes the constant table of byte classes.
+* param[in]: table - The compiled table.
+* param[in]: name - Prefix of the names in the generated code.
+* param[in]: fp - The file to write to.
+*/
+void emitClasses (const dfaTable *table, const char *name, FILE *fp) {
+
+	fprintf(fp, "static const %s %sClasses[256] = {\n",
+			table -> nrOfClasses <= 256 ? "unsigned char" : "unsigned short",
+			name);
+
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		if (i % EMIT_CLASSES_PER_LINE == 0) {
+
+			fprintf(fp, "\t");
+		}
+		fprintf(fp, "%d%s", table -> classes[i],
+				i == DFA_ALPHABET - 1 ? "\n" :
+				i % EMIT_CLASSES_PER_LINE == EMIT_CLASSES_PER_LINE - 1 ?
+						",\n" : ", ");
+	}
+	fprintf(fp, "};\n\n");
+}
+
+/*
+* description: Writes the label of a state and the switch leading out of it.
+* The most common destination becomes the default case.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr), must not be decided.
+* param[in]: name - Prefix of the names in the generated code.
+* param[in]: fp - The file to write to.
+*/
+void emitState (const dfa *dfa, int state, const char *name, FILE *fp) {
+
+	const dfaTable *table = dfa -> table;
+	int room[DFA_MAX_CLASSES];
+	const int *row = dfaTableRow(table, state, room);
+	const char *stateName = emitStateName(dfa, state);
+	int common = row[0];
+	int commonCount = 0;
+
+	fprintf(fp, "\ns%d:", state);
+	if (stateName != NULL && strstr(stateName, "*/") == NULL) {
+
+		fprintf(fp, " /* %s */", stateName);
+	}
+	fprintf(fp, "\n\tif (curr == end) {\n\n\t\treturn %d;\n\t}\n",
+			table -> acceptable[state] ? 1 : 0);
+
+	for (int i = 0; i < table -> nrOfClasses; i++) {
+
+		int count = 0;
+		for (int j = 0; j < table -> nrOfClasses; j++) {
+
+			count += emitSameTarget(table, row[j], row[i]);
+		}
+		if (count > commonCount) {
+
+			common = row[i];
+			commonCount = count;
+		}
+	}
+
+	fprintf(fp, "\tswitch (%sClasses[*curr++]) {\n\n", name);
+	for (int i = 0; i < table -> nrOfClasses; i++) {
+
+		bool first = true;
+		if (emitSameTarget(table, row[i], common)) {
+
+			continue;
+		}
+		//Each destination is written once, at its first class.
+		for (int j = 0; j < i && first; j++) {
+
+			first = !emitSameTarget(table, row[j], row[i]);
+		}
+		if (!first) {
+
+			continue;
+		}
+
+		fprintf(fp, "\t\tcase %d:", i);
+		for (int j = i + 1; j < table -> nrOfClasses; j++) {
+
+			if (emitSameTarget(table, row[j], row[i])) {
+
+				fprintf(fp, " case %d:", j);
+			}
+		}
+		fprintf(fp, "\n\t\t\t");
+		emitTarget(table, row[i], fp);
+	}
+	fprintf(fp, "\t\tdefault:\n\t\t\t");
+	emitTarget(table, common, fp);
+	fprintf(fp, "\t}\n");
+}
+
+/*
+* description: Writes the statement which moves a run to a state, a goto for
+* an open state and a return for a decided one.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr) to move to.
+* param[in]: fp - The file to write to.
+*/
+void emitTarget (const dfaTable *table, int state, FILE *fp) {
+
+	switch (table -> outcome[state]) {
+
+		case DFA_DEAD:
+			fprintf(fp, "return 0;\n");
+			break;
+
+		case DFA_ACCEPT_SINK:
+			fprintf(fp, "return 1;\n");
+			break;
+
+		default:
+			fprintf(fp, "goto s%d;\n", state);
+			break;
+	}
+}
+
+/*
+* description: Checks if moving to two states is written the same way, that
+* is if they are the same state or both decided with the same outcome.
+* param[in]: table - The compiled table.
+* param[in]: a - The first state (stateNr).
+* param[in]: b - The second state (stateNr).
+* return: true if they are written the same way, else false.
+*/
+bool emitSameTarget (const dfaTable *table, int a, int b) {
+
+	return a == b || (table -> outcome[a] != DFA_OPEN &&
+			table -> outcome[a] == table -> outcome[b]);
+}
+
+/*
+* description: Finds the states which are reachable from the start state
+* without passing a decided state.
+* param[in]: table - The compiled table.
+* return: An array telling which states are reachable.
+*/
+bool *emitReachable (const dfaTable *table) {
+
+	bool *reachable = calloc(table -> nrOfStates, sizeof(bool));
+	int *stack = malloc(sizeof(int) * table -> nrOfStates);
+	int size = 0;
+	int room[DFA_MAX_CLASSES];
+
+	if (table -> outcome[table -> startState] == DFA_OPEN) {
+
+		reachable[table -> startState] = true;
+		stack[size++] = table -> startState;
+	}
+	while (size > 0) {
+
+		const int *row = dfaTableRow(table, stack[--size], room);
+		for (int i = 0; i < table -> nrOfClasses; i++) {
+
+			if (!reachable[row[i]] && table -> outcome[row[i]] == DFA_OPEN) {
+
+				reachable[row[i]] = true;
+				stack[size++] = row[i];
+			}
+		}
+	}
+	free(stack);
+	return reachable;
+}
+
+/*
+* description: Finds the name of a state, for a built dfa or one loaded from
+* an image.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr).
+* return: The name, NULL if the state has none.
+*/
+const char *emitStateName (const dfa *dfa, int state) {
+
+	if (dfa -> table -> image != NULL) {
+
+		return imageStateName(dfa, state);
+	}
+	return state < dfa -> size ? dfa -> allStates[state] -> stateName : NULL;
+}
+
+/*
+* description: Checks if a string can be used as a C identifier.
+* param[in]: name - The string.
+* return: true if it is an identifier, else false.
+*/
+bool emitIsIdentifier (const char *name) {
+
+	if (name == NULL || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {
+
+		return false;
+	}
+	for (int i = 1; name[i] != '\0'; i++) {
+
+		if (!isalnum((unsigned char)name[i]) && name[i] != '_') {
+
+			return false;
+		}
+	}
+	return true;
+}
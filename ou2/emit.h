@@ -0,0 +1,100 @@
+/*
+* emit: Writes a compiled dfa as C source, a standalone matcher with no
+* dependencies on this program. The byte classes become a constant table and
+* every state becomes a label, whose switch on the class of the next byte
+* jumps straight to the label of the next state. Paths into a dead state or
+* an accept-sink are replaced by returning the outcome at once.
+*
+* The generated file defines one function, <name>Accepts, with the same
+* semantics as dfaAccepts. Only states reachable from the start state are
+* written.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef EMIT
+#define EMIT
+
+#include <stdio.h>
+
+#include "dfa.h"
+
+#define EMIT_DEFAULT_NAME "generated"
+#define EMIT_CLASSES_PER_LINE 16
+
+/*
+* description: Writes the dfa as C source.
+* param[in]: dfa - The compiled dfa, built or loaded from an image.
+* param[in]: fileName - The file to write to, NULL for stdout.
+* param[in]: name - Prefix of the names in the generated code, must be a C
+* identifier.
+* return: 1 if the source was written, else 0.
+*/
+int emitC (const dfa *dfa, const char *fileName, const char *name);
+
+/*
+* description: Writes the constant table of byte classes.
+* param[in]: table - The compiled table.
+* param[in]: name - Prefix of the names in the generated code.
+* param[in]: fp - The file to write to.
+*/
+void emitClasses (const dfaTable *table, const char *name, FILE *fp);
+
+/*
+* description: Writes the label of a state and the switch leading out of it.
+* The most common destination becomes the default case.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr), must not be decided.
+* param[in]: name - Prefix of the names in the generated code.
+* param[in]: fp - The file to write to.
+*/
+void emitState (const dfa *dfa, int state, const char *name, FILE *fp);
+
+/*
+* description: Writes the statement which moves a run to a state, a goto for
+* an open state and a return for a decided one.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr) to move to.
+* param[in]: fp - The file to write to.
+*/
+void emitTarget (const dfaTable *table, int state, FILE *fp);
+
+/*
+* description: Checks if moving to two states is written the same way, that
+* is if they are the same state or both decided with the same outcome.
+* param[in]: table - The compiled table.
+* param[in]: a - The first state (stateNr).
+* param[in]: b - The second state (stateNr).
+* return: true if they are written the same way, else false.
+*/
+bool emitSameTarget (const dfaTable *table, int a, int b);
+
+/*
+* description: Finds the states which are reachable from the start state
+* without passing a decided state.
+* param[in]: table - The compiled table.
+* return: An array telling which states are reachable.
+*/
+bool *emitReachable (const dfaTable *table);
+
+/*
+* description: Finds the name of a state, for a built dfa or one loaded from
+* an image.
+* param[in]: dfa - The compiled dfa.
+* param[in]: state - The state (stateNr).
+* return: The name, NULL if the state has none.
+*/
+const char *emitStateName (const dfa *dfa, int state);
+
+/*
+* description: Checks if a string can be used as a C identifier.
+* param[in]: name - The string.
+* return: true if it is an identifier, else false.
+*/
+bool emitIsIdentifier (const char *name);
+
+#endif //EMIT
@@ -0,0 +1,494 @@
+/*
+* image: A binary, memory mappable file format for compiled dfas. An image is
+* loaded by mapping the file and pointing the transition table straight into
+* the mapping, so nothing is parsed or copied but the header. See image.h.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+
+/*
+* description: Writes the compiled dfa as a binary image. State names are
+* taken from the states of the dfa, if it has any.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file to write to.
+* return: 1 if the image was written, else 0.
+*/
+int imageWrite (const dfa *dfa, const char *fileName) {
+
+	const dfaTable *table = dfa -> table;
+	imageHeader header;
+	size_t nextSize = sizeof(int32_t) * table -> nrOfStates *
+			table -> nrOfClasses;
+	size_t acceptableSize = sizeof(int32_t) * table -> nrOfStates;
+	size_t exitsSize = sizeof(dfaExit) * table -> nrOfStates;
+	size_t outcomeSize = table -> nrOfStates;
+
+	//Names of the states, the error state has an empty name.
+	uint32_t nrOfOffsets = table -> nrOfStates + 1;
+	uint32_t *nameOffsets = malloc(sizeof(uint32_t) * nrOfOffsets);
+	size_t namesLength = 0;
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		nameOffsets[i] = namesLength;
+		if (i < dfa -> size) {
+
+			namesLength += strlen(dfa -> allStates[i] -> stateName);
+		}
+		namesLength++;
+	}
+	nameOffsets[table -> nrOfStates] = namesLength;
+
+	size_t namesSize = sizeof(uint32_t) * nrOfOffsets + namesLength;
+	char *names = calloc(namesSize, 1);
+	memcpy(names, nameOffsets, sizeof(uint32_t) * nrOfOffsets);
+	for (int i = 0; i < dfa -> size && i < table -> nrOfStates; i++) {
+
+		strcpy(names + sizeof(uint32_t) * nrOfOffsets + nameOffsets[i],
+				dfa -> allStates[i] -> stateName);
+	}
+	free(nameOffsets);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, IMAGE_MAGIC, 4);
+	header.version = IMAGE_VERSION;
+	header.byteOrder = IMAGE_BYTE_ORDER;
+	header.nrOfStates = table -> nrOfStates;
+	header.nrOfClasses = table -> nrOfClasses;
+	header.startState = table -> startState;
+	header.errorState = table -> errorState;
+	header.nrOfHotStates = table -> nrOfHotStates;
+	header.nextOffset = imageAlign(sizeof(header));
+	header.acceptableOffset = imageAlign(header.nextOffset + nextSize);
+	header.exitsOffset = imageAlign(header.acceptableOffset + acceptableSize);
+	header.outcomeOffset = imageAlign(header.exitsOffset + exitsSize);
+	header.namesOffset = imageAlign(header.outcomeOffset + outcomeSize);
+	header.fileSize = header.namesOffset + namesSize;
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		header.classes[i] = table -> classes[i];
+	}
+
+	header.dataChecksum = imageChecksumRows(IMAGE_CHECKSUM_SEED, table);
+	header.dataChecksum = imageChecksum(header.dataChecksum,
+			table -> acceptable, acceptableSize);
+	header.dataChecksum = imageChecksum(header.dataChecksum,
+			table -> exits, exitsSize);
+	header.dataChecksum = imageChecksum(header.dataChecksum,
+			table -> outcome, outcomeSize);
+	header.dataChecksum = imageChecksum(header.dataChecksum, names, namesSize);
+	header.headerChecksum = imageChecksum(IMAGE_CHECKSUM_SEED, &header,
+			offsetof(imageHeader, headerChecksum));
+
+	FILE *fp = fopen(fileName, "wb");
+	int written = 0;
+	if (fp != NULL) {
+
+		written = imageWriteSection(fp, 0, &header, sizeof(header)) &&
+				imageWriteRows(fp, header.nextOffset, table) &&
+				imageWriteSection(fp, header.acceptableOffset,
+						table -> acceptable, acceptableSize) &&
+				imageWriteSection(fp, header.exitsOffset, table -> exits,
+						exitsSize) &&
+				imageWriteSection(fp, header.outcomeOffset, table -> outcome,
+						outcomeSize) &&
+				imageWriteSection(fp, header.namesOffset, names, namesSize);
+		if (fclose(fp) != 0) {
+
+			written = 0;
+		}
+	}
+	if (!written) {
+
+		fprintf(stderr, "Could not write image '%s'\n", fileName);
+	}
+	free(names);
+	return written;
+}
+
+/*
+* description: Loads a binary image by mapping it into memory. The header is
+* validated, but not the data checksum. Unless the image is trusted, its data
+* is checked by imageCheck too. The dfa has a table but no states.
+* param[in]: fileName - The file with the image.
+* param[in]: trusted - true to skip imageCheck.
+* return: The compiled dfa, NULL if the image is not valid.
+*/
+dfa *imageLoad (const char *fileName, bool trusted) {
+
+	struct stat fileStat;
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &fileStat) != 0 ||
+			(size_t)fileStat.st_size < sizeof(imageHeader)) {
+
+		fprintf(stderr, "Could not read image '%s'\n", fileName);
+		if (fd >= 0) {
+
+			close(fd);
+		}
+		return NULL;
+	}
+
+	size_t size = fileStat.st_size;
+	char *image = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED) {
+
+		fprintf(stderr, "Could not map image '%s'\n", fileName);
+		return NULL;
+	}
+
+	const imageHeader *header = (const imageHeader *)image;
+	uint64_t states = header -> nrOfStates;
+	uint64_t classes = header -> nrOfClasses;
+	bool valid = memcmp(header -> magic, IMAGE_MAGIC, 4) == 0 &&
+			header -> version == IMAGE_VERSION &&
+			header -> byteOrder == IMAGE_BYTE_ORDER &&
+			header -> headerChecksum == imageChecksum(IMAGE_CHECKSUM_SEED,
+					header, offsetof(imageHeader, headerChecksum)) &&
+			header -> fileSize == size && sizeof(int) == sizeof(int32_t) &&
+			states > 0 && states <= INT_MAX &&
+			classes > 0 && classes <= DFA_MAX_CLASSES &&
+			header -> startState < states && header -> errorState < states &&
+			header -> nrOfHotStates <= states &&
+			imageFits(header -> nextOffset, states * classes * 4,
+					header -> acceptableOffset) &&
+			imageFits(header -> acceptableOffset, states * 4,
+					header -> exitsOffset) &&
+			imageFits(header -> exitsOffset, states * sizeof(dfaExit),
+					header -> outcomeOffset) &&
+			imageFits(header -> outcomeOffset, states,
+					header -> namesOffset) &&
+			imageFits(header -> namesOffset, (states + 1) * 4, size);
+
+	for (int i = 0; valid && i < DFA_ALPHABET; i++) {
+
+		valid = header -> classes[i] < classes;
+	}
+	if (!valid) {
+
+		fprintf(stderr, "'%s' is not a valid image\n", fileName);
+		munmap(image, size);
+		return NULL;
+	}
+
+	dfaTable *table = malloc(sizeof(struct dfaTable));
+	table -> nrOfStates = states;
+	table -> nrOfClasses = classes;
+	table -> startState = header -> startState;
+	table -> errorState = header -> errorState;
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		table -> classes[i] = header -> classes[i];
+	}
+	table -> next = (int *)(image + header -> nextOffset);
+	table -> comb = NULL;
+	table -> acceptable = (bool *)(image + header -> acceptableOffset);
+	table -> exits = (dfaExit *)(image + header -> exitsOffset);
+	table -> outcome = (unsigned char *)(image + header -> outcomeOffset);
+	table -> image = image;
+	table -> imageSize = size;
+	table -> nrOfHotStates = header -> nrOfHotStates;
+#ifdef DFA_PROFILE
+	table -> profile = NULL;
+#endif
+
+	dfa *dfa = dfaEmpty();
+	dfa -> table = table;
+	if (!trusted && !imageCheck(dfa)) {
+
+		fprintf(stderr, "'%s' is not a valid image\n", fileName);
+		dfaKill(dfa);
+		return NULL;
+	}
+	return dfa;
+}
+
+/*
+* description: Advises the kernel how the image of a dfa too large to be read
+* in will be read: at random, but the hot states first.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* param[in]: budget - Most bytes of rows of hot states to read in.
+*/
+void imagePage (const dfa *dfa, size_t budget) {
+
+	const dfaTable *table = dfa -> table;
+	size_t nrOfHotStates = table -> nrOfHotStates;
+
+	if (nrOfHotStates > budget / (sizeof(int) * table -> nrOfClasses)) {
+
+		nrOfHotStates = budget / (sizeof(int) * table -> nrOfClasses);
+	}
+
+	posix_madvise(table -> image, table -> imageSize, POSIX_MADV_RANDOM);
+	if (nrOfHotStates > 0) {
+
+		imageWillNeed(table, table -> next,
+				sizeof(int) * nrOfHotStates * table -> nrOfClasses);
+		imageWillNeed(table, table -> acceptable,
+				sizeof(bool) * nrOfHotStates);
+		imageWillNeed(table, table -> exits, sizeof(dfaExit) * nrOfHotStates);
+		imageWillNeed(table, table -> outcome, nrOfHotStates);
+	}
+}
+
+/*
+* description: Advises a part of the image of a table as needed.
+* param[in]: table - The table, loaded by imageLoad.
+* param[in]: data - The first byte of the part, in the image.
+* param[in]: size - Number of bytes.
+*/
+void imageWillNeed (const dfaTable *table, const void *data, size_t size) {
+
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t begin = ((const char *)data - (const char *)table -> image) /
+			pageSize * pageSize;
+	size_t end = (const char *)data + size - (const char *)table -> image;
+
+	posix_madvise((char *)table -> image + begin, end - begin,
+			POSIX_MADV_WILLNEED);
+}
+
+/*
+* description: Checks the data checksum of a dfa loaded from an image, and
+* checks its data as imageCheck does.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* return: true if the data is intact, else false.
+*/
+bool imageVerify (const dfa *dfa) {
+
+	const char *image = dfa -> table -> image;
+	const imageHeader *header = (const imageHeader *)image;
+	uint64_t checksum = IMAGE_CHECKSUM_SEED;
+
+	if (image == NULL) {
+
+		return false;
+	}
+	checksum = imageChecksum(checksum, image + header -> nextOffset,
+			(size_t)header -> nrOfStates * header -> nrOfClasses * 4);
+	checksum = imageChecksum(checksum, image + header -> acceptableOffset,
+			(size_t)header -> nrOfStates * 4);
+	checksum = imageChecksum(checksum, image + header -> exitsOffset,
+			(size_t)header -> nrOfStates * sizeof(dfaExit));
+	checksum = imageChecksum(checksum, image + header -> outcomeOffset,
+			header -> nrOfStates);
+	checksum = imageChecksum(checksum, image + header -> namesOffset,
+			header -> fileSize - header -> namesOffset);
+	//The data is what was written, but may still have been written wrong.
+	return checksum == header -> dataChecksum && imageCheck(dfa);
+}
+
+/*
+* description: Checks that the data of a dfa loaded from an image can be run
+* without reading outside of it: every move leads to a state of the table, and
+* the exits and outcomes are in range.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* return: true if the data can be run, else false.
+*/
+bool imageCheck (const dfa *dfa) {
+
+	const dfaTable *table = dfa -> table;
+	const int *next = table -> next;
+
+	for (size_t i = 0; i < (size_t)table -> nrOfStates *
+			table -> nrOfClasses; i++) {
+
+		if (next[i] < 0 || next[i] >= table -> nrOfStates) {
+
+			return false;
+		}
+	}
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (table -> exits[i].nrOfBytes < 0 ||
+				table -> exits[i].nrOfBytes > DFA_EXIT_BYTES ||
+				table -> outcome[i] > DFA_ACCEPT_SINK) {
+
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+* description: Checks if a file starts like a binary image.
+* param[in]: fileName - The file.
+* return: true if the file is an image, else false.
+*/
+bool imageIsImage (const char *fileName) {
+
+	char magic[4];
+	bool isImage = false;
+	FILE *fp = fopen(fileName, "rb");
+
+	if (fp != NULL) {
+
+		isImage = fread(magic, 1, 4, fp) == 4 &&
+				memcmp(magic, IMAGE_MAGIC, 4) == 0;
+		fclose(fp);
+	}
+	return isImage;
+}
+
+/*
+* description: Finds the name of a state in a dfa loaded from an image.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* param[in]: state - The state (stateNr).
+* return: The name, NULL for the error state or if the image has no names.
+*/
+const char *imageStateName (const dfa *dfa, int state) {
+
+	const char *image = dfa -> table -> image;
+	if (image == NULL || state < 0 || state >= dfa -> table -> nrOfStates) {
+
+		return NULL;
+	}
+
+	const imageHeader *header = (const imageHeader *)image;
+	const uint32_t *offsets = (const uint32_t *)(image + header -> namesOffset);
+	const char *names = (const char *)(offsets + header -> nrOfStates + 1);
+	uint64_t end = header -> namesOffset +
+			sizeof(uint32_t) * (header -> nrOfStates + 1) + offsets[state + 1];
+
+	if (offsets[state + 1] <= offsets[state] || end > header -> fileSize ||
+			names[offsets[state + 1] - 1] != '\0' ||
+			offsets[state + 1] - offsets[state] == 1) {
+
+		return NULL;
+	}
+	return names + offsets[state];
+}
+
+/*
+* description: Adds bytes to a 64 bit FNV-1a checksum.
+* param[in]: checksum - The checksum so far.
+* param[in]: data - The bytes to add.
+* param[in]: size - Number of bytes.
+* return: The new checksum.
+*/
+uint64_t imageChecksum (uint64_t checksum, const void *data, size_t size) {
+
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+
+		checksum ^= bytes[i];
+		checksum *= UINT64_C(1099511628211);
+	}
+	return checksum;
+}
+
+/*
+* description: Checks that a section lies after the header and before an end,
+* and starts at a multiple of IMAGE_ALIGNMENT. Checked by subtraction, so that
+* no offset, however large, wraps around.
+* param[in]: offset - Where the section starts.
+* param[in]: length - Number of bytes in the section.
+* param[in]: end - Where the section must end by, at most the file size.
+* return: true if the section fits, else false.
+*/
+bool imageFits (uint64_t offset, uint64_t length, uint64_t end) {
+
+	return offset >= sizeof(imageHeader) && offset % IMAGE_ALIGNMENT == 0 &&
+			offset <= end && end - offset >= length;
+}
+
+/*
+* description: Rounds an offset up to the image alignment.
+* param[in]: offset - The offset.
+* return: The aligned offset.
+*/
+uint64_t imageAlign (uint64_t offset) {
+
+	return (offset + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+}
+
+/*
+* description: Writes a section at its offset, padding the file up to it.
+* param[in]: fp - The file.
+* param[in]: offset - Where the section starts.
+* param[in]: data - The section.
+* param[in]: size - Number of bytes in the section.
+* return: 1 if written, else 0.
+*/
+int imageWriteSection (FILE *fp, uint64_t offset, const void *data,
+		size_t size) {
+
+	long position = ftell(fp);
+	while (position >= 0 && (uint64_t)position < offset) {
+
+		if (fputc(0, fp) == EOF) {
+
+			return 0;
+		}
+		position++;
+	}
+	return fwrite(data, 1, size, fp) == size;
+}
+
+/*
+* description: Adds the rows of a compiled table to a checksum, as they are
+* written by imageWriteRows.
+* param[in]: checksum - The checksum so far.
+* param[in]: table - The compiled table.
+* return: The new checksum.
+*/
+uint64_t imageChecksumRows (uint64_t checksum, const dfaTable *table) {
+
+	int room[DFA_MAX_CLASSES];
+
+	if (table -> next != NULL) {
+
+		return imageChecksum(checksum, table -> next, sizeof(int32_t) *
+				table -> nrOfStates * table -> nrOfClasses);
+	}
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		checksum = imageChecksum(checksum, dfaTableRow(table, i, room),
+				sizeof(int32_t) * table -> nrOfClasses);
+	}
+	return checksum;
+}
+
+/*
+* description: Writes the rows of a compiled table as the next section. The
+* rows of a compressed table are written one at a time, so the image is dense
+* without the whole dense table ever being in memory.
+* param[in]: fp - The file.
+* param[in]: offset - Where the section starts.
+* param[in]: table - The compiled table.
+* return: 1 if written, else 0.
+*/
+int imageWriteRows (FILE *fp, uint64_t offset, const dfaTable *table) {
+
+	int room[DFA_MAX_CLASSES];
+	int written = 1;
+
+	if (table -> next != NULL) {
+
+		return imageWriteSection(fp, offset, table -> next, sizeof(int32_t) *
+				table -> nrOfStates * table -> nrOfClasses);
+	}
+
+	//Only the first row is padded up to the offset, the others follow it.
+	for (int i = 0; written && i < table -> nrOfStates; i++) {
+
+		written = imageWriteSection(fp, offset, dfaTableRow(table, i, room),
+				sizeof(int32_t) * table -> nrOfClasses);
+	}
+	return written;
+}
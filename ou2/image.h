@@ -0,0 +1,201 @@
+/*
+* image: A binary, memory mappable file format for compiled dfas. An image is
+* loaded by mapping the file and pointing the transition table straight into
+* the mapping, so nothing is parsed or copied but the header. Processes that
+* load the same image share its pages in the page cache. Nothing is computed
+* per state when loading either, so an image larger than memory can be run,
+* its pages being faulted in as the moves of a run reach them.
+*
+* The kernel reads ahead of a fault by default, which for a large table reads
+* in rows of states that are not likely to be run next, and in a table larger
+* than memory pushes out rows that are. imagePage advises such an image as
+* random instead, so a fault only reads its own page. The states of an image
+* ordered hot first (see order.h) that a training run visited are the first
+* states of each per state section, and as many of them as the budget allows
+* are advised as needed, to be read in up front.
+*
+* Layout, in the byte order of the machine that wrote it:
+* - imageHeader, with the byte classes and checksums.
+* - next, nrOfStates * nrOfClasses 32 bit states. A compressed table (see
+*   comb.h) is written dense.
+* - acceptable, nrOfStates 32 bit flags.
+* - exits, nrOfStates dfaExit, see dfaTableAccelerate.
+* - outcome, nrOfStates bytes, see dfaTableDecide.
+* - names, nrOfStates + 1 32 bit offsets followed by the names of the states.
+* Every section starts at a multiple of IMAGE_ALIGNMENT. The header checksum
+* is checked on every load, the data checksum only by imageVerify. Unless the
+* image is trusted, every load also checks that the moves lead to states of
+* the table and that the exits and outcomes are in range, so a corrupt image
+* is rejected instead of being run outside of its table. That reads the whole
+* table, so an image too large to be read in is best loaded trusted.
+*
+* nrOfHotStates is kept from the table that was written, see dfaTable.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef IMAGE
+#define IMAGE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dfa.h"
+
+#define IMAGE_MAGIC "DFAB"
+#define IMAGE_VERSION 2
+#define IMAGE_BYTE_ORDER 0x01020304u
+#define IMAGE_ALIGNMENT 64
+#define IMAGE_CHECKSUM_SEED UINT64_C(14695981039346656037)
+
+typedef struct imageHeader {
+
+	char magic[4];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t nrOfStates;
+	uint32_t nrOfClasses;
+	uint32_t startState;
+	uint32_t errorState;
+	uint32_t nrOfHotStates;
+	uint64_t nextOffset;
+	uint64_t acceptableOffset;
+	uint64_t exitsOffset;
+	uint64_t outcomeOffset;
+	uint64_t namesOffset;
+	uint64_t fileSize;
+	uint64_t dataChecksum;
+	uint16_t classes[DFA_ALPHABET];
+	uint64_t headerChecksum;
+} imageHeader;
+
+/*
+* description: Writes the compiled dfa as a binary image. State names are
+* taken from the states of the dfa, if it has any.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file to write to.
+* return: 1 if the image was written, else 0.
+*/
+int imageWrite (const dfa *dfa, const char *fileName);
+
+/*
+* description: Loads a binary image by mapping it into memory. The header is
+* validated, but not the data checksum. Unless the image is trusted, its data
+* is checked by imageCheck too. The dfa has a table but no states.
+* param[in]: fileName - The file with the image.
+* param[in]: trusted - true to skip imageCheck.
+* return: The compiled dfa, NULL if the image is not valid.
+*/
+dfa *imageLoad (const char *fileName, bool trusted);
+
+/*
+* description: Advises the kernel how the image of a dfa too large to be read
+* in will be read: at random, but the hot states first.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* param[in]: budget - Most bytes of rows of hot states to read in.
+*/
+void imagePage (const dfa *dfa, size_t budget);
+
+/*
+* description: Checks the data checksum of a dfa loaded from an image, and
+* checks its data as imageCheck does.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* return: true if the data is intact, else false.
+*/
+bool imageVerify (const dfa *dfa);
+
+/*
+* description: Checks that the data of a dfa loaded from an image can be run
+* without reading outside of it: every move leads to a state of the table, and
+* the exits and outcomes are in range.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* return: true if the data can be run, else false.
+*/
+bool imageCheck (const dfa *dfa);
+
+/*
+* description: Checks if a file starts like a binary image.
+* param[in]: fileName - The file.
+* return: true if the file is an image, else false.
+*/
+bool imageIsImage (const char *fileName);
+
+/*
+* description: Finds the name of a state in a dfa loaded from an image.
+* param[in]: dfa - The dfa loaded by imageLoad.
+* param[in]: state - The state (stateNr).
+* return: The name, NULL for the error state or if the image has no names.
+*/
+const char *imageStateName (const dfa *dfa, int state);
+
+/*
+* description: Advises a part of the image of a table as needed.
+* param[in]: table - The table, loaded by imageLoad.
+* param[in]: data - The first byte of the part, in the image.
+* param[in]: size - Number of bytes.
+*/
+void imageWillNeed (const dfaTable *table, const void *data, size_t size);
+
+/*
+* description: Adds bytes to a 64 bit FNV-1a checksum.
+* param[in]: checksum - The checksum so far.
+* param[in]: data - The bytes to add.
+* param[in]: size - Number of bytes.
+* return: The new checksum.
+*/
+uint64_t imageChecksum (uint64_t checksum, const void *data, size_t size);
+
+/*
+* description: Checks that a section lies after the header and before an end,
+* and starts at a multiple of IMAGE_ALIGNMENT. Checked by subtraction, so that
+* no offset, however large, wraps around.
+* param[in]: offset - Where the section starts.
+* param[in]: length - Number of bytes in the section.
+* param[in]: end - Where the section must end by, at most the file size.
+* return: true if the section fits, else false.
+*/
+bool imageFits (uint64_t offset, uint64_t length, uint64_t end);
+
+/*
+* description: Rounds an offset up to the image alignment.
+* param[in]: offset - The offset.
+* return: The aligned offset.
+*/
+uint64_t imageAlign (uint64_t offset);
+
+/*
+* description: Writes a section at its offset, padding the file up to it.
+* param[in]: fp - The file.
+* param[in]: offset - Where the section starts.
+* param[in]: data - The section.
+* param[in]: size - Number of bytes in the section.
+* return: 1 if written, else 0.
+*/
+int imageWriteSection (FILE *fp, uint64_t offset, const void *data,
+		size_t size);
+
+/*
+* description: Adds the rows of a compiled table to a checksum, as they are
+* written by imageWriteRows.
+* param[in]: checksum - The checksum so far.
+* param[in]: table - The compiled table.
+* return: The new checksum.
+*/
+uint64_t imageChecksumRows (uint64_t checksum, const dfaTable *table);
+
+/*
+* description: Writes the rows of a compiled table as the next section. The
+* rows of a compressed table are written one at a time, so the image is dense
+* without the whole dense table ever being in memory.
+* param[in]: fp - The file.
+* param[in]: offset - Where the section starts.
+* param[in]: table - The compiled table.
+* return: 1 if written, else 0.
+*/
+int imageWriteRows (FILE *fp, uint64_t offset, const dfaTable *table);
+
+#endif //IMAGE
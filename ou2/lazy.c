@@ -0,0 +1,365 @@
+/*
+* lazy: Runs a pattern on a dfa that is built while it runs. Instead of
+* building every dfa state up front, which for some patterns means
+* exponentially many, a state (a set of NFA states, see nfa.h) is built the
+* first time a run moves into it and kept in a cache. Moves already taken are
+* then as fast as in a compiled table.
+*
+* The cache is bounded by a budget in bytes. When a new state does not fit,
+* the whole cache is flushed and building starts over. If the cache is flushed
+* too often for the number of bytes run, the rest of the string is run by
+* simulating the NFA directly instead, which needs no cache at all.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include <limits.h>
+
+#include "lazy.h"
+
+/*
+* description: Creates a lazy dfa for an NFA, with an empty cache.
+* param[in]: nfa - The NFA, which is freed with the lazy dfa.
+* param[in]: budget - Number of bytes the cached states may use.
+* return: The lazy dfa, ready to run.
+*/
+lazyDfa *lazyEmpty (nfa *nfa, size_t budget) {
+
+	lazyDfa *lazy = calloc(1, sizeof(lazyDfa));
+
+	lazy -> nfa = nfa;
+	lazy -> nrOfClasses = nfaClasses(nfa, lazy -> classOf,
+			lazy -> representative);
+	lazy -> budget = budget;
+	lazy -> mark = calloc(nfa -> size, sizeof(int));
+	lazy -> stack = malloc(sizeof(int) * nfa -> size);
+	lazy -> set = malloc(sizeof(int) * nfa -> size);
+	lazy -> runSet = malloc(sizeof(int) * nfa -> size);
+	lazy -> startSet = malloc(sizeof(int) * nfa -> size);
+	lazy -> startSize = nfaStart(nfa, lazy -> mark, lazyGeneration(lazy),
+			lazy -> stack, lazy -> startSet);
+	lazy -> start = -1;
+	lazy -> dead = -1;
+
+	lazyReset(lazy);
+	return lazy;
+}
+
+/*
+* description: Runs a part of a string. The string may be split over any
+* number of feeds.
+* param[in]: lazy - The lazy dfa.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void lazyFeed (lazyDfa *lazy, const char *buffer, size_t length) {
+
+	const unsigned char *input = (const unsigned char *)buffer;
+	const int *classOf = lazy -> classOf;
+	long long fed = lazy -> bytes;
+	size_t i = 0;
+
+	if (!lazy -> simulating) {
+
+		const int *next = lazy -> next;
+		int nrOfClasses = lazy -> nrOfClasses;
+		int current = lazy -> current;
+
+		//Nothing is accepted after the dead state, the rest is skipped.
+		for (; i < length && current != lazy -> dead; i++) {
+
+			int to = next[current * nrOfClasses + classOf[input[i]]];
+			if (to < 0) {
+
+				lazy -> bytes = fed + i;
+				to = lazyBuild(lazy, current, classOf[input[i]]);
+				next = lazy -> next;
+				if (to < 0) {
+
+					i++;
+					break;
+				}
+			}
+			current = to;
+		}
+		lazy -> current = current;
+	}
+
+	if (lazy -> simulating) {
+
+		for (; i < length && lazy -> runSize > 0; i++) {
+
+			int *moved = lazy -> set;
+			lazy -> runSize = nfaStep(lazy -> nfa, lazy -> runSet,
+					lazy -> runSize, input[i], lazy -> mark,
+					lazyGeneration(lazy), lazy -> stack, moved);
+			lazy -> set = lazy -> runSet;
+			lazy -> runSet = moved;
+		}
+	}
+	lazy -> bytes = fed + length;
+}
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: lazy - The lazy dfa.
+* return: true if the string is accepted, else false.
+*/
+bool lazyFinalize (lazyDfa *lazy) {
+
+	bool accepted;
+
+	if (lazy -> simulating) {
+
+		accepted = nfaSetAccepts(lazy -> nfa, lazy -> runSet, lazy -> runSize);
+	} else {
+
+		accepted = lazy -> acceptable[lazy -> current];
+	}
+	lazyReset(lazy);
+	return accepted;
+}
+
+/*
+* description: Runs a whole string.
+* param[in]: lazy - The lazy dfa.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the string is accepted, else false.
+*/
+bool lazyAccepts (lazyDfa *lazy, const char *string, size_t length) {
+
+	lazyFeed(lazy, string, length);
+	return lazyFinalize(lazy);
+}
+
+/*
+* description: lazyFeed for batchStream.
+* param[in]: lazy - The lazy dfa.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void lazyStreamFeed (void *lazy, const char *buffer, size_t length) {
+
+	lazyFeed(lazy, buffer, length);
+}
+
+/*
+* description: Ends a string for batchStream, see lazyFinalize.
+* param[in]: lazy - The lazy dfa.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void lazyStreamEnd (void *lazy, FILE *out, batchResult *result) {
+
+	batchEndLine(lazyFinalize(lazy), out, result);
+}
+
+/*
+* description: Starts a new run in the start state.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyReset (lazyDfa *lazy) {
+
+	lazy -> simulating = false;
+	if (lazy -> start < 0) {
+
+		lazy -> start = lazyAdd(lazy, lazy -> startSet, lazy -> startSize);
+	}
+	lazy -> current = lazy -> start;
+
+	if (lazy -> start < 0) {
+
+		lazySimulate(lazy, lazy -> startSet, lazy -> startSize);
+	}
+}
+
+/*
+* description: Builds the move of a cached state on a class. Flushes the cache
+* if the new state does not fit, or starts simulating the NFA if flushing
+* does not pay off.
+* param[in]: lazy - The lazy dfa.
+* param[in]: from - The cached state moved from.
+* param[in]: class - The class of the byte moved on.
+* return: The cached state moved to, -1 if the run is now simulating.
+*/
+int lazyBuild (lazyDfa *lazy, int from, int class) {
+
+	nfaSubsets *cache = &lazy -> cache;
+	int setSize = nfaStep(lazy -> nfa, &cache -> states[cache -> begin[from]],
+			cache -> begin[from + 1] - cache -> begin[from],
+			lazy -> representative[class], lazy -> mark, lazyGeneration(lazy),
+			lazy -> stack, lazy -> set);
+	qsort(lazy -> set, setSize, sizeof(int), nfaCompareStates);
+
+	int to = nfaSubsetsLookup(cache, lazy -> set, setSize);
+	if (to >= 0) {
+
+		lazy -> next[from * lazy -> nrOfClasses + class] = to;
+		return to;
+	}
+
+	//Few bytes per state built means the cache would just be flushed again.
+	bool full = lazyUsed(lazy) + lazyStateCost(lazy, setSize) > lazy -> budget;
+	if (full && lazy -> bytes - lazy -> bytesAtFlush <
+			(long long)LAZY_BYTES_PER_STATE * cache -> size) {
+
+		lazySimulate(lazy, lazy -> set, setSize);
+		return -1;
+	}
+
+	to = lazyAdd(lazy, lazy -> set, setSize);
+	if (to < 0) {
+
+		lazySimulate(lazy, lazy -> set, setSize);
+	} else if (!full) {
+
+		lazy -> next[from * lazy -> nrOfClasses + class] = to;
+	}
+	return to;
+}
+
+/*
+* description: Adds a state to the cache, flushing it first if the state does
+* not fit.
+* param[in]: lazy - The lazy dfa.
+* param[in]: set - The NFA states of the state, in order.
+* param[in]: setSize - Number of NFA states.
+* return: The cached state, -1 if it does not fit in the budget at all.
+*/
+int lazyAdd (lazyDfa *lazy, const int *set, int setSize) {
+
+	nfaSubsets *cache = &lazy -> cache;
+	int nrOfClasses = lazy -> nrOfClasses;
+	size_t cost = lazyStateCost(lazy, setSize);
+
+	if (cost > lazy -> budget) {
+
+		return -1;
+	}
+	if (lazyUsed(lazy) + cost > lazy -> budget) {
+
+		lazyFlush(lazy);
+	}
+
+	int state = nfaSubsetsAdd(cache, set, setSize);
+	if (cache -> capacity > lazy -> nextCapacity) {
+
+		lazy -> nextCapacity = cache -> capacity;
+		lazy -> next = realloc(lazy -> next,
+				sizeof(int) * lazy -> nextCapacity * nrOfClasses);
+		lazy -> acceptable = realloc(lazy -> acceptable,
+				sizeof(bool) * lazy -> nextCapacity);
+	}
+
+	//The empty set never moves anywhere else.
+	for (int i = 0; i < nrOfClasses; i++) {
+
+		lazy -> next[state * nrOfClasses + i] = setSize == 0 ? state : -1;
+	}
+	lazy -> acceptable[state] = nfaSetAccepts(lazy -> nfa, set, setSize);
+	if (setSize == 0) {
+
+		lazy -> dead = state;
+	}
+	lazy -> built++;
+	return state;
+}
+
+/*
+* description: Starts simulating the NFA for the rest of the string.
+* param[in]: lazy - The lazy dfa.
+* param[in]: set - The NFA states the run is in.
+* param[in]: setSize - Number of NFA states.
+*/
+void lazySimulate (lazyDfa *lazy, const int *set, int setSize) {
+
+	memcpy(lazy -> runSet, set, sizeof(int) * setSize);
+	lazy -> runSize = setSize;
+	lazy -> simulating = true;
+	lazy -> simulations++;
+}
+
+/*
+* description: Throws away all cached states.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyFlush (lazyDfa *lazy) {
+
+	nfaSubsetsClear(&lazy -> cache);
+	lazy -> start = -1;
+	lazy -> dead = -1;
+	lazy -> bytesAtFlush = lazy -> bytes;
+	lazy -> flushes++;
+}
+
+/*
+* description: Finds the number of bytes a cached state uses.
+* param[in]: lazy - The lazy dfa.
+* param[in]: setSize - Number of NFA states of the state.
+* return: The number of bytes.
+*/
+size_t lazyStateCost (const lazyDfa *lazy, int setSize) {
+
+	//The set, the moves, its begin and two slots of the index.
+	return sizeof(int) * (setSize + lazy -> nrOfClasses + 3) + sizeof(bool);
+}
+
+/*
+* description: Finds the number of bytes all cached states use.
+* param[in]: lazy - The lazy dfa.
+* return: The number of bytes.
+*/
+size_t lazyUsed (const lazyDfa *lazy) {
+
+	return sizeof(int) * lazy -> cache.statesSize +
+			lazyStateCost(lazy, 0) * lazy -> cache.size;
+}
+
+/*
+* description: Starts a new generation of marks for building a set.
+* param[in]: lazy - The lazy dfa.
+* return: The generation.
+*/
+int lazyGeneration (lazyDfa *lazy) {
+
+	if (lazy -> generation == INT_MAX) {
+
+		memset(lazy -> mark, 0, sizeof(int) * lazy -> nfa -> size);
+		lazy -> generation = 0;
+	}
+	return ++lazy -> generation;
+}
+
+/*
+* description: Writes what the lazy dfa has done.
+* param[in]: lazy - The lazy dfa.
+* param[in]: fp - The file to write to.
+*/
+void lazyPrintStats (const lazyDfa *lazy, FILE *fp) {
+
+	fprintf(fp, "lazy states built: %lld flushes: %lld simulated: %lld\n",
+			lazy -> built, lazy -> flushes, lazy -> simulations);
+}
+
+/*
+* description: Frees the lazy dfa and its NFA.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyKill (lazyDfa *lazy) {
+
+	nfaSubsetsKill(&lazy -> cache);
+	free(lazy -> next);
+	free(lazy -> acceptable);
+	free(lazy -> startSet);
+	free(lazy -> runSet);
+	free(lazy -> mark);
+	free(lazy -> stack);
+	free(lazy -> set);
+	nfaKill(lazy -> nfa);
+	free(lazy);
+}
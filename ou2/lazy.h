@@ -0,0 +1,196 @@
+/*
+* lazy: Runs a pattern on a dfa that is built while it runs. Instead of
+* building every dfa state up front, which for some patterns means
+* exponentially many, a state (a set of NFA states, see nfa.h) is built the
+* first time a run moves into it and kept in a cache. Moves already taken are
+* then as fast as in a compiled table.
+*
+* The cache is bounded by a budget in bytes. When a new state does not fit,
+* the whole cache is flushed and building starts over. If the cache is flushed
+* too often for the number of bytes run, the rest of the string is run by
+* simulating the NFA directly instead, which needs no cache at all.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef LAZY
+#define LAZY
+
+#include <stdio.h>
+
+#include "dfa.h"
+#include "nfa.h"
+#include "batch.h"
+
+#define LAZY_DEFAULT_BUDGET (8 << 20)
+#define LAZY_BYTES_PER_STATE 10
+
+/*
+* A dfa built on demand. The cached states are the sets in cache, the move of
+* state s on class c is next[s * nrOfClasses + c], -1 if not built yet.
+*
+* A run is in the state current, or when simulating in the NFA states of
+* runSet. start and dead are the cached start state and the state of the empty
+* set, -1 while not cached. mark, stack and set are room for building sets.
+* bytes, built, flushes and simulations count what the dfa has done.
+*/
+typedef struct lazyDfa {
+
+	nfa *nfa;
+	int classOf[DFA_ALPHABET];
+	int representative[DFA_MAX_CLASSES];
+	int nrOfClasses;
+	size_t budget;
+	nfaSubsets cache;
+	int *next;
+	bool *acceptable;
+	int nextCapacity;
+	int *startSet;
+	int startSize;
+	int start;
+	int dead;
+	int current;
+	bool simulating;
+	int *runSet;
+	int runSize;
+	int *mark;
+	int *stack;
+	int *set;
+	int generation;
+	long long bytes;
+	long long bytesAtFlush;
+	long long built;
+	long long flushes;
+	long long simulations;
+} lazyDfa;
+
+/*
+* description: Creates a lazy dfa for an NFA, with an empty cache.
+* param[in]: nfa - The NFA, which is freed with the lazy dfa.
+* param[in]: budget - Number of bytes the cached states may use.
+* return: The lazy dfa, ready to run.
+*/
+lazyDfa *lazyEmpty (nfa *nfa, size_t budget);
+
+/*
+* description: Runs a part of a string. The string may be split over any
+* number of feeds.
+* param[in]: lazy - The lazy dfa.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void lazyFeed (lazyDfa *lazy, const char *buffer, size_t length);
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: lazy - The lazy dfa.
+* return: true if the string is accepted, else false.
+*/
+bool lazyFinalize (lazyDfa *lazy);
+
+/*
+* description: Runs a whole string.
+* param[in]: lazy - The lazy dfa.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the string is accepted, else false.
+*/
+bool lazyAccepts (lazyDfa *lazy, const char *string, size_t length);
+
+/*
+* description: lazyFeed for batchStream.
+* param[in]: lazy - The lazy dfa.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void lazyStreamFeed (void *lazy, const char *buffer, size_t length);
+
+/*
+* description: Ends a string for batchStream, see lazyFinalize.
+* param[in]: lazy - The lazy dfa.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void lazyStreamEnd (void *lazy, FILE *out, batchResult *result);
+
+/*
+* description: Starts a new run in the start state.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyReset (lazyDfa *lazy);
+
+/*
+* description: Builds the move of a cached state on a class. Flushes the cache
+* if the new state does not fit, or starts simulating the NFA if flushing
+* does not pay off.
+* param[in]: lazy - The lazy dfa.
+* param[in]: from - The cached state moved from.
+* param[in]: class - The class of the byte moved on.
+* return: The cached state moved to, -1 if the run is now simulating.
+*/
+int lazyBuild (lazyDfa *lazy, int from, int class);
+
+/*
+* description: Adds a state to the cache, flushing it first if the state does
+* not fit.
+* param[in]: lazy - The lazy dfa.
+* param[in]: set - The NFA states of the state, in order.
+* param[in]: setSize - Number of NFA states.
+* return: The cached state, -1 if it does not fit in the budget at all.
+*/
+int lazyAdd (lazyDfa *lazy, const int *set, int setSize);
+
+/*
+* description: Starts simulating the NFA for the rest of the string.
+* param[in]: lazy - The lazy dfa.
+* param[in]: set - The NFA states the run is in.
+* param[in]: setSize - Number of NFA states.
+*/
+void lazySimulate (lazyDfa *lazy, const int *set, int setSize);
+
+/*
+* description: Throws away all cached states.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyFlush (lazyDfa *lazy);
+
+/*
+* description: Finds the number of bytes a cached state uses.
+* param[in]: lazy - The lazy dfa.
+* param[in]: setSize - Number of NFA states of the state.
+* return: The number of bytes.
+*/
+size_t lazyStateCost (const lazyDfa *lazy, int setSize);
+
+/*
+* description: Finds the number of bytes all cached states use.
+* param[in]: lazy - The lazy dfa.
+* return: The number of bytes.
+*/
+size_t lazyUsed (const lazyDfa *lazy);
+
+/*
+* description: Starts a new generation of marks for building a set.
+* param[in]: lazy - The lazy dfa.
+* return: The generation.
+*/
+int lazyGeneration (lazyDfa *lazy);
+
+/*
+* description: Writes what the lazy dfa has done.
+* param[in]: lazy - The lazy dfa.
+* param[in]: fp - The file to write to.
+*/
+void lazyPrintStats (const lazyDfa *lazy, FILE *fp);
+
+/*
+* description: Frees the lazy dfa and its NFA.
+* param[in]: lazy - The lazy dfa.
+*/
+void lazyKill (lazyDfa *lazy);
+
+#endif //LAZY
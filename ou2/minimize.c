@@ -0,0 +1,363 @@
+/*
+* minimize: Minimizes a dfa with Hopcroft's partition refinement. States that
+* can not be reached from the start state are removed and states that accept
+* exactly the same strings are merged into one.
+*
+* The partition is kept in one array of states, where every block is a range.
+* When a block is split by a splitter the marked states are moved to the front
+* of the block, and the smaller of the two parts becomes the new block. Only
+* the new block then needs to be added as splitter, for every key.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "minimize.h"
+
+/*
+* description: Creates a new, minimal and compiled dfa which accepts the same
+* strings as a dfa. Each merged state gets the name of its first state. Paths
+* are only kept where the first state had them, so the alphabet of each state
+* stays the same. The old dfa is compiled if it is not already.
+* param[in]: dfa - The dfa to be minimized.
+* return: The minimized dfa, NULL if the dfa has no start state.
+*/
+dfa *dfaMinimize (dfa *dfa) {
+
+	if (dfa -> startState == NULL) {
+
+		return NULL;
+	}
+	if (dfa -> table == NULL) {
+
+		dfaCompile(dfa);
+	}
+
+	const dfaTable *table = dfa -> table;
+	int n = table -> nrOfStates;
+	int nrOfClasses = table -> nrOfClasses;
+	int keys[DFA_MAX_CLASSES];
+	int nrOfKeys = 0;
+
+	//Class 0 always leads to the error state and can not tell states apart.
+	for (int class = 1; class < nrOfClasses; class++) {
+
+		keys[nrOfKeys++] = class;
+	}
+
+	bool *reachable = minimizeReachable(table, keys, nrOfKeys);
+	partition p;
+	p.elements = malloc(sizeof(int) * n);
+	p.location = malloc(sizeof(int) * n);
+	p.blockOf = malloc(sizeof(int) * n);
+	p.blockStart = malloc(sizeof(int) * n);
+	p.blockEnd = malloc(sizeof(int) * n);
+	p.marked = calloc(n, sizeof(int));
+	p.nrOfBlocks = 0;
+
+	//Start with acceptable states first, then the others.
+	int m = 0;
+	int nrOfAcceptable = 0;
+	for (int pass = 1; pass >= 0; pass--) {
+
+		for (int s = 0; s < n; s++) {
+
+			if (reachable[s] && table -> acceptable[s] == pass) {
+
+				p.location[s] = m;
+				p.elements[m++] = s;
+				nrOfAcceptable += pass;
+			}
+		}
+	}
+	for (int i = 0; i < m; i++) {
+
+		p.blockOf[p.elements[i]] = nrOfAcceptable > 0 && i >= nrOfAcceptable;
+	}
+
+	splitters stack = {0, 0, NULL};
+	if (nrOfAcceptable > 0) {
+
+		p.blockStart[0] = 0;
+		p.blockEnd[0] = nrOfAcceptable;
+		p.nrOfBlocks = 1;
+	}
+	if (nrOfAcceptable < m) {
+
+		p.blockStart[p.nrOfBlocks] = nrOfAcceptable;
+		p.blockEnd[p.nrOfBlocks] = m;
+		p.nrOfBlocks++;
+	}
+	if (p.nrOfBlocks == 2) {
+
+		int smaller = nrOfAcceptable <= m - nrOfAcceptable ? 0 : 1;
+		for (int k = 0; k < nrOfKeys; k++) {
+
+			splittersPush(&stack, smaller, k);
+		}
+	}
+
+	//Inverse transitions of reachable states, grouped by key and target.
+	int *inverseStart = calloc((size_t)nrOfKeys * n + 1, sizeof(int));
+	int *inverse = malloc(sizeof(int) * ((size_t)nrOfKeys * m + 1));
+	for (int k = 0; k < nrOfKeys; k++) {
+
+		for (int s = 0; s < n; s++) {
+
+			if (reachable[s]) {
+
+				inverseStart[(size_t)k * n +
+						dfaTableMove(table, s, keys[k]) + 1]++;
+			}
+		}
+	}
+	for (size_t i = 0; i < (size_t)nrOfKeys * n; i++) {
+
+		inverseStart[i + 1] += inverseStart[i];
+	}
+	int *fill = malloc(sizeof(int) * ((size_t)nrOfKeys * n));
+	memcpy(fill, inverseStart, sizeof(int) * ((size_t)nrOfKeys * n));
+	for (int k = 0; k < nrOfKeys; k++) {
+
+		for (int s = 0; s < n; s++) {
+
+			if (reachable[s]) {
+
+				int target = dfaTableMove(table, s, keys[k]);
+				inverse[fill[(size_t)k * n + target]++] = s;
+			}
+		}
+	}
+	free(fill);
+
+	int *predecessors = malloc(sizeof(int) * n);
+	int *touched = malloc(sizeof(int) * n);
+
+	while (stack.size > 0) {
+
+		stack.size--;
+		int splitter = stack.pairs[stack.size * 2];
+		int k = stack.pairs[stack.size * 2 + 1];
+		int nrOfPredecessors = 0;
+		int nrOfTouched = 0;
+
+		//Collect first, marking moves states around inside the blocks.
+		for (int i = p.blockStart[splitter]; i < p.blockEnd[splitter]; i++) {
+
+			size_t target = (size_t)k * n + p.elements[i];
+			for (int j = inverseStart[target]; j < inverseStart[target + 1];
+					j++) {
+
+				predecessors[nrOfPredecessors++] = inverse[j];
+			}
+		}
+		for (int i = 0; i < nrOfPredecessors; i++) {
+
+			minimizeMark(&p, predecessors[i], touched, &nrOfTouched);
+		}
+		for (int i = 0; i < nrOfTouched; i++) {
+
+			int newBlock = minimizeSplit(&p, touched[i]);
+			if (newBlock >= 0) {
+
+				for (int key = 0; key < nrOfKeys; key++) {
+
+					splittersPush(&stack, newBlock, key);
+				}
+			}
+		}
+	}
+
+	//Each block with a real state becomes a state, named after its first one.
+	int *newNr = malloc(sizeof(int) * p.nrOfBlocks);
+	int *first = malloc(sizeof(int) * p.nrOfBlocks);
+	int nrOfNewStates = 0;
+	for (int b = 0; b < p.nrOfBlocks; b++) {
+
+		newNr[b] = -1;
+	}
+	for (int s = 0; s < dfa -> size; s++) {
+
+		if (reachable[s] && newNr[p.blockOf[s]] < 0) {
+
+			newNr[p.blockOf[s]] = nrOfNewStates;
+			first[nrOfNewStates] = s;
+			nrOfNewStates++;
+		}
+	}
+
+	struct dfa *minimal = dfaEmpty();
+	minimal -> tableBudget = dfa -> tableBudget;
+	dfaSetStates(minimal, nrOfNewStates);
+	for (int i = 0; i < nrOfNewStates; i++) {
+
+		dfaInsertState(minimal, table -> acceptable[first[i]],
+				dfa -> allStates[first[i]] -> stateName);
+	}
+	minimal -> startState =
+			minimal -> allStates[newNr[p.blockOf[table -> startState]]];
+
+	for (int i = 0; i < nrOfNewStates; i++) {
+
+		//Inserted backwards, since paths are inserted first in the list.
+		for (int key = DFA_ALPHABET - 1; key >= 0; key--) {
+
+			int class = table -> classes[key];
+			int target = dfaTableMove(table, first[i], class);
+			if (class != 0 && target != table -> errorState) {
+
+				char keyName[2] = {(char)key, '\0'};
+				pathInsert(minimal -> arena, minimal -> allStates[i], keyName,
+						minimal -> allStates[newNr[p.blockOf[target]]]);
+			}
+		}
+	}
+	dfaCompile(minimal);
+
+	free(newNr);
+	free(first);
+	free(predecessors);
+	free(touched);
+	free(inverse);
+	free(inverseStart);
+	free(stack.pairs);
+	free(p.elements);
+	free(p.location);
+	free(p.blockOf);
+	free(p.blockStart);
+	free(p.blockEnd);
+	free(p.marked);
+	free(reachable);
+	return minimal;
+}
+
+/*
+* description: Finds all states that can be reached from the start state. The
+* error state is always counted as reachable.
+* param[in]: table - The compiled table.
+* param[in]: keys - The keys in use.
+* param[in]: nrOfKeys - Number of keys in use.
+* return: An array telling which states are reachable.
+*/
+bool *minimizeReachable (const dfaTable *table, const int *keys, int nrOfKeys) {
+
+	bool *reachable = calloc(table -> nrOfStates, sizeof(bool));
+	int *queue = malloc(sizeof(int) * table -> nrOfStates);
+	int head = 0;
+	int tail = 0;
+
+	reachable[table -> errorState] = true;
+	if (!reachable[table -> startState]) {
+
+		reachable[table -> startState] = true;
+		queue[tail++] = table -> startState;
+	}
+
+	while (head < tail) {
+
+		int state = queue[head++];
+		for (int k = 0; k < nrOfKeys; k++) {
+
+			int target = dfaTableMove(table, state, keys[k]);
+			if (!reachable[target]) {
+
+				reachable[target] = true;
+				queue[tail++] = target;
+			}
+		}
+	}
+	free(queue);
+	return reachable;
+}
+
+/*
+* description: Marks a state in its block by moving it to the front of it.
+* param[in]: p - The partition.
+* param[in]: state - The state to be marked.
+* param[in]: touched - Blocks with marked states, the block is added if this
+* is its first marked state.
+* param[in]: nrOfTouched - Number of touched blocks.
+*/
+void minimizeMark (partition *p, int state, int *touched, int *nrOfTouched) {
+
+	int block = p -> blockOf[state];
+	int i = p -> location[state];
+	int j = p -> blockStart[block] + p -> marked[block];
+
+	if (i >= j) {
+
+		int other = p -> elements[j];
+		p -> elements[j] = state;
+		p -> elements[i] = other;
+		p -> location[state] = j;
+		p -> location[other] = i;
+
+		if (p -> marked[block] == 0) {
+
+			touched[(*nrOfTouched)++] = block;
+		}
+		p -> marked[block]++;
+	}
+}
+
+/*
+* description: Splits a block in its marked and unmarked parts, if both are
+* non-empty. The smaller part becomes a new block.
+* param[in]: p - The partition.
+* param[in]: block - The block to be split.
+* return: The new block, -1 if the block was not split.
+*/
+int minimizeSplit (partition *p, int block) {
+
+	int start = p -> blockStart[block];
+	int end = p -> blockEnd[block];
+	int middle = start + p -> marked[block];
+	int newBlock = -1;
+
+	p -> marked[block] = 0;
+	if (middle < end) {
+
+		newBlock = p -> nrOfBlocks++;
+		if (middle - start <= end - middle) {
+
+			p -> blockStart[newBlock] = start;
+			p -> blockEnd[newBlock] = middle;
+			p -> blockStart[block] = middle;
+		} else {
+
+			p -> blockStart[newBlock] = middle;
+			p -> blockEnd[newBlock] = end;
+			p -> blockEnd[block] = middle;
+		}
+
+		for (int i = p -> blockStart[newBlock]; i < p -> blockEnd[newBlock];
+				i++) {
+
+			p -> blockOf[p -> elements[i]] = newBlock;
+		}
+	}
+	return newBlock;
+}
+
+/*
+* description: Pushes a splitter on the stack.
+* param[in]: stack - The stack.
+* param[in]: block - The block of the splitter.
+* param[in]: key - Index of the key of the splitter.
+*/
+void splittersPush (splitters *stack, int block, int key) {
+
+	if (stack -> size == stack -> capacity) {
+
+		stack -> capacity = stack -> capacity == 0 ? 64 :
+				stack -> capacity * 2;
+		stack -> pairs = realloc(stack -> pairs,
+				sizeof(int) * 2 * stack -> capacity);
+	}
+	stack -> pairs[stack -> size * 2] = block;
+	stack -> pairs[stack -> size * 2 + 1] = key;
+	stack -> size++;
+}
@@ -0,0 +1,100 @@
+/*
+* minimize: Minimizes a dfa with Hopcroft's partition refinement. States that
+* can not be reached from the start state are removed and states that accept
+* exactly the same strings are merged into one.
+*
+* The partition is kept in one array of states, where every block is a range.
+* When a block is split by a splitter the marked states are moved to the front
+* of the block, and the smaller of the two parts becomes the new block. Only
+* the new block then needs to be added as splitter, for every key.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef MINIMIZE
+#define MINIMIZE
+
+#include "dfa.h"
+
+/*
+* The partition of the states while refining it.
+* elements - All states, block by block.
+* location - Index of each state in elements.
+* blockOf - The block each state is in.
+* blockStart, blockEnd - The range of each block in elements.
+* marked - Number of marked states at the front of each block.
+* nrOfBlocks - Number of blocks.
+*/
+typedef struct partition {
+
+	int *elements;
+	int *location;
+	int *blockOf;
+	int *blockStart;
+	int *blockEnd;
+	int *marked;
+	int nrOfBlocks;
+} partition;
+
+/*
+* A stack of splitters, each a block and the index of a key.
+*/
+typedef struct splitters {
+
+	int size;
+	int capacity;
+	int *pairs;
+} splitters;
+
+/*
+* description: Creates a new, minimal and compiled dfa which accepts the same
+* strings as a dfa. Each merged state gets the name of its first state. Paths
+* are only kept where the first state had them, so the alphabet of each state
+* stays the same. The old dfa is compiled if it is not already.
+* param[in]: dfa - The dfa to be minimized.
+* return: The minimized dfa, NULL if the dfa has no start state.
+*/
+dfa *dfaMinimize (dfa *dfa);
+
+/*
+* description: Finds all states that can be reached from the start state. The
+* error state is always counted as reachable.
+* param[in]: table - The compiled table.
+* param[in]: keys - The keys in use.
+* param[in]: nrOfKeys - Number of keys in use.
+* return: An array telling which states are reachable.
+*/
+bool *minimizeReachable (const dfaTable *table, const int *keys, int nrOfKeys);
+
+/*
+* description: Marks a state in its block by moving it to the front of it.
+* param[in]: p - The partition.
+* param[in]: state - The state to be marked.
+* param[in]: touched - Blocks with marked states, the block is added if this
+* is its first marked state.
+* param[in]: nrOfTouched - Number of touched blocks.
+*/
+void minimizeMark (partition *p, int state, int *touched, int *nrOfTouched);
+
+/*
+* description: Splits a block in its marked and unmarked parts, if both are
+* non-empty. The smaller part becomes a new block.
+* param[in]: p - The partition.
+* param[in]: block - The block to be split.
+* return: The new block, -1 if the block was not split.
+*/
+int minimizeSplit (partition *p, int block);
+
+/*
+* description: Pushes a splitter on the stack.
+* param[in]: stack - The stack.
+* param[in]: block - The block of the splitter.
+* param[in]: key - Index of the key of the splitter.
+*/
+void splittersPush (splitters *stack, int block, int key);
+
+#endif //MINIMIZE
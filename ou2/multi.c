@@ -0,0 +1,468 @@
+/*
+* multi: Runs several compiled dfas over the same strings in one pass. The dfas
+* are run as their product: a dfa whose states are tuples holding a state of
+* each dfa, moving all of them at once. A move of the product is then a
+* single lookup however many dfas there are.
+*
+* Like in lazy.h the product is only built where it is run, its states kept in
+* a cache bounded by a budget in bytes and flushed when full. If the cache is
+* flushed too often for the number of bytes run, the rest of the string is
+* instead run through the tables of the dfas one after the other, each byte
+* being looked up in every table before the next byte is read.
+*
+* A dfa stops moving as soon as its outcome is decided (see dfaTableDecide),
+* which keeps the product small, and a string is run no further once every
+* dfa is decided.
+*
+* The result of a string is a bitmask with bit i set if dfa i accepts it,
+* written as hex digits with the highest bit first.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "multi.h"
+
+/*
+* description: Creates a run of several compiled dfas, with an empty cache.
+* param[in]: dfas - The dfas, which must stay alive while they are run.
+* param[in]: size - Number of dfas, at most MULTI_MAX_DFAS.
+* param[in]: budget - Number of bytes the cached states may use.
+* return: The run, ready for the first string.
+*/
+multiDfa *multiEmpty (dfa **dfas, int size, size_t budget) {
+
+	multiDfa *multi = calloc(1, sizeof(multiDfa));
+
+	multi -> size = size;
+	for (int i = 0; i < size; i++) {
+
+		multi -> tables[i] = dfas[i] -> table;
+	}
+	multi -> nrOfClasses = multiClasses(multi);
+	multi -> budget = budget;
+	multi -> start = -1;
+
+	multiReset(multi);
+	return multi;
+}
+
+/*
+* description: Runs a part of a string through every dfa. The string may be
+* split over any number of feeds.
+* param[in]: multi - The run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiFeed (multiDfa *multi, const char *buffer, size_t length) {
+
+	const unsigned char *input = (const unsigned char *)buffer;
+	const int *classOf = multi -> classOf;
+	long long fed = multi -> bytes;
+	size_t i = 0;
+
+	if (!multi -> inLanes) {
+
+		const int *next = multi -> next;
+		const bool *decided = multi -> decided;
+		int nrOfClasses = multi -> nrOfClasses;
+		int current = multi -> current;
+
+		//Once every dfa is decided the rest is skipped.
+		for (; i < length && !decided[current]; i++) {
+
+			int to = next[current * nrOfClasses + classOf[input[i]]];
+			if (to < 0) {
+
+				multi -> bytes = fed + i;
+				to = multiBuild(multi, current, classOf[input[i]]);
+				next = multi -> next;
+				decided = multi -> decided;
+				if (to < 0) {
+
+					i++;
+					break;
+				}
+			}
+			current = to;
+		}
+		multi -> current = current;
+	}
+
+	if (multi -> inLanes) {
+
+		multiFeedLanes(multi, input + i, length - i);
+	}
+	multi -> bytes = fed + length;
+}
+
+/*
+* description: Runs a part of a string through the table of every dfa still
+* in the lanes.
+* param[in]: multi - The run.
+* param[in]: input - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiFeedLanes (multiDfa *multi, const unsigned char *input,
+		size_t length) {
+
+	multiLane *live = multi -> live;
+	int nrOfLive = multi -> nrOfLive;
+
+	for (size_t i = 0; i < length && nrOfLive > 0; i++) {
+
+		for (int j = 0; j < nrOfLive; j++) {
+
+			multiLane *lane = &live[j];
+			int class = lane -> classes[input[i]];
+			int state = lane -> next != NULL ?
+					lane -> next[(size_t)lane -> state * lane -> nrOfClasses +
+							class] :
+					dfaCombMove(multi -> tables[lane -> dfa] -> comb,
+							lane -> state, class);
+
+			lane -> state = state;
+			if (lane -> outcome[state] != DFA_OPEN) {
+
+				//The last lane takes its place and is stepped next.
+				multi -> states[lane -> dfa] = state;
+				*lane = live[--nrOfLive];
+				j--;
+			}
+		}
+	}
+	multi -> nrOfLive = nrOfLive;
+}
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: multi - The run.
+* return: The dfas that accept the string, bit i for dfa i.
+*/
+uint64_t multiFinalize (multiDfa *multi) {
+
+	uint64_t accepted = 0;
+
+	if (multi -> inLanes) {
+
+		for (int j = 0; j < multi -> nrOfLive; j++) {
+
+			multi -> states[multi -> live[j].dfa] = multi -> live[j].state;
+		}
+		for (int i = 0; i < multi -> size; i++) {
+
+			if (multi -> tables[i] -> acceptable[multi -> states[i]]) {
+
+				accepted |= (uint64_t)1 << i;
+			}
+		}
+	} else {
+
+		accepted = multi -> accepting[multi -> current];
+	}
+
+	for (uint64_t left = accepted; left != 0; left &= left - 1) {
+
+		multi -> accepted[__builtin_ctzll(left)]++;
+	}
+	multiReset(multi);
+	return accepted;
+}
+
+/*
+* description: Starts a new string in the start state of every dfa.
+* param[in]: multi - The run.
+*/
+void multiReset (multiDfa *multi) {
+
+	multi -> inLanes = false;
+	if (multi -> start < 0) {
+
+		for (int i = 0; i < multi -> size; i++) {
+
+			multi -> tuple[i] = multi -> tables[i] -> startState;
+		}
+		multi -> start = multiAdd(multi, multi -> tuple);
+	}
+	multi -> current = multi -> start;
+
+	if (multi -> start < 0) {
+
+		multiToLanes(multi, multi -> tuple);
+	}
+}
+
+/*
+* description: multiFeed for batchStream.
+* param[in]: multi - The run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiStreamFeed (void *multi, const char *buffer, size_t length) {
+
+	multiFeed(multi, buffer, length);
+}
+
+/*
+* description: Ends a string for batchStream, writing the bitmask of the dfas
+* that accept it. It counts as accepted if any dfa accepts it.
+* param[in]: multi - The run.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void multiStreamEnd (void *multi, FILE *out, batchResult *result) {
+
+	int digits = (((multiDfa *)multi) -> size + 3) / 4;
+	uint64_t accepted = multiFinalize(multi);
+
+	for (int i = digits - 1; i >= 0; i--) {
+
+		putc("0123456789abcdef"[(accepted >> (i * 4)) & 0xf], out);
+	}
+	putc('\n', out);
+	if (accepted != 0) {
+
+		result -> accepted++;
+	} else {
+
+		result -> rejected++;
+	}
+}
+
+/*
+* description: Builds the move of a cached state on a class. Flushes the cache
+* if the new state does not fit, or moves the run to the lanes if flushing
+* does not pay off.
+* param[in]: multi - The run.
+* param[in]: from - The cached state moved from.
+* param[in]: class - The class of the byte moved on.
+* return: The cached state moved to, -1 if the run is now in the lanes.
+*/
+int multiBuild (multiDfa *multi, int from, int class) {
+
+	nfaSubsets *cache = &multi -> cache;
+	const int *tuple = &cache -> states[cache -> begin[from]];
+	int byte = multi -> representative[class];
+
+	//A decided dfa is left where it is, its outcome does not change.
+	for (int i = 0; i < multi -> size; i++) {
+
+		const dfaTable *table = multi -> tables[i];
+		int state = tuple[i];
+
+		if (table -> outcome[state] == DFA_OPEN) {
+
+			state = dfaTableMove(table, state, table -> classes[byte]);
+		}
+		multi -> tuple[i] = state;
+	}
+
+	int to = nfaSubsetsLookup(cache, multi -> tuple, multi -> size);
+	if (to >= 0) {
+
+		multi -> next[from * multi -> nrOfClasses + class] = to;
+		return to;
+	}
+
+	//Few bytes per state built means the cache would just be flushed again.
+	//Building a state costs a lookup in every table, so more dfas need more.
+	bool full = multiStateCost(multi) * (cache -> size + 1) > multi -> budget;
+	if (full && multi -> bytes - multi -> bytesAtFlush <
+			(long long)MULTI_BYTES_PER_STATE * multi -> size * cache -> size) {
+
+		multiToLanes(multi, multi -> tuple);
+		return -1;
+	}
+
+	to = multiAdd(multi, multi -> tuple);
+	if (to < 0) {
+
+		multiToLanes(multi, multi -> tuple);
+	} else if (!full) {
+
+		multi -> next[from * multi -> nrOfClasses + class] = to;
+	}
+	return to;
+}
+
+/*
+* description: Adds a state to the cache, flushing it first if the state does
+* not fit.
+* param[in]: multi - The run.
+* param[in]: tuple - The state of each dfa.
+* return: The cached state, -1 if it does not fit in the budget at all.
+*/
+int multiAdd (multiDfa *multi, const int *tuple) {
+
+	nfaSubsets *cache = &multi -> cache;
+	int nrOfClasses = multi -> nrOfClasses;
+	size_t cost = multiStateCost(multi);
+
+	if (cost > multi -> budget) {
+
+		return -1;
+	}
+	if (cost * (cache -> size + 1) > multi -> budget) {
+
+		multiFlush(multi);
+	}
+
+	int state = nfaSubsetsAdd(cache, tuple, multi -> size);
+	if (cache -> capacity > multi -> nextCapacity) {
+
+		multi -> nextCapacity = cache -> capacity;
+		multi -> next = realloc(multi -> next,
+				sizeof(int) * multi -> nextCapacity * nrOfClasses);
+		multi -> accepting = realloc(multi -> accepting,
+				sizeof(uint64_t) * multi -> nextCapacity);
+		multi -> decided = realloc(multi -> decided,
+				sizeof(bool) * multi -> nextCapacity);
+	}
+
+	for (int i = 0; i < nrOfClasses; i++) {
+
+		multi -> next[state * nrOfClasses + i] = -1;
+	}
+	multi -> accepting[state] = 0;
+	multi -> decided[state] = true;
+	for (int i = 0; i < multi -> size; i++) {
+
+		const dfaTable *table = multi -> tables[i];
+		if (table -> acceptable[tuple[i]]) {
+
+			multi -> accepting[state] |= (uint64_t)1 << i;
+		}
+		if (table -> outcome[tuple[i]] == DFA_OPEN) {
+
+			multi -> decided[state] = false;
+		}
+	}
+	multi -> built++;
+	return state;
+}
+
+/*
+* description: Moves the run to the lanes for the rest of the string.
+* param[in]: multi - The run.
+* param[in]: tuple - The state of each dfa.
+*/
+void multiToLanes (multiDfa *multi, const int *tuple) {
+
+	multi -> nrOfLive = 0;
+
+	for (int i = 0; i < multi -> size; i++) {
+
+		const dfaTable *table = multi -> tables[i];
+		multi -> states[i] = tuple[i];
+
+		if (table -> outcome[tuple[i]] == DFA_OPEN) {
+
+			multiLane *lane = &multi -> live[multi -> nrOfLive++];
+			lane -> next = table -> next;
+			lane -> classes = table -> classes;
+			lane -> outcome = table -> outcome;
+			lane -> nrOfClasses = table -> nrOfClasses;
+			lane -> state = tuple[i];
+			lane -> dfa = i;
+		}
+	}
+	multi -> inLanes = true;
+	multi -> lanes++;
+}
+
+/*
+* description: Throws away all cached states.
+* param[in]: multi - The run.
+*/
+void multiFlush (multiDfa *multi) {
+
+	nfaSubsetsClear(&multi -> cache);
+	multi -> start = -1;
+	multi -> bytesAtFlush = multi -> bytes;
+	multi -> flushes++;
+}
+
+/*
+* description: Finds the number of bytes a cached state uses.
+* param[in]: multi - The run.
+* return: The number of bytes.
+*/
+size_t multiStateCost (const multiDfa *multi) {
+
+	//The tuple, the moves, its begin and two slots of the index.
+	return sizeof(int) * (multi -> size + multi -> nrOfClasses + 3) +
+			sizeof(uint64_t) + sizeof(bool);
+}
+
+/*
+* description: Finds the classes of the product, the bytes every dfa puts in
+* the same class sharing one.
+* param[in]: multi - The run, with its tables set.
+* return: Number of classes.
+*/
+int multiClasses (multiDfa *multi) {
+
+	int nrOfClasses = 0;
+
+	for (int byte = 0; byte < DFA_ALPHABET; byte++) {
+
+		int class = 0;
+		bool same = false;
+
+		for (; class < nrOfClasses && !same; class++) {
+
+			int other = multi -> representative[class];
+			same = true;
+			for (int i = 0; i < multi -> size && same; i++) {
+
+				same = multi -> tables[i] -> classes[byte] ==
+						multi -> tables[i] -> classes[other];
+			}
+		}
+
+		if (same) {
+
+			class--;
+		} else {
+
+			multi -> representative[nrOfClasses++] = byte;
+		}
+		multi -> classOf[byte] = class;
+	}
+	return nrOfClasses;
+}
+
+/*
+* description: Writes the number of strings each dfa has accepted, and what
+* the run has done.
+* param[in]: multi - The run.
+* param[in]: names - The name of each dfa.
+* param[in]: fp - The file to write to.
+*/
+void multiPrintSummary (const multiDfa *multi, const char * const *names,
+		FILE *fp) {
+
+	for (int i = 0; i < multi -> size; i++) {
+
+		fprintf(fp, "%d %s accepted: %lld\n", i, names[i],
+				multi -> accepted[i]);
+	}
+	fprintf(fp, "product states built: %lld flushes: %lld in lanes: %lld\n",
+			multi -> built, multi -> flushes, multi -> lanes);
+}
+
+/*
+* description: Frees the run, but not its dfas.
+* param[in]: multi - The run.
+*/
+void multiKill (multiDfa *multi) {
+
+	nfaSubsetsKill(&multi -> cache);
+	free(multi -> next);
+	free(multi -> accepting);
+	free(multi -> decided);
+	free(multi);
+}
@@ -0,0 +1,219 @@
+/*
+* multi: Runs several compiled dfas over the same strings in one pass. The dfas
+* are run as their product: a dfa whose states are tuples holding a state of
+* each dfa, moving all of them at once. A move of the product is then a
+* single lookup however many dfas there are.
+*
+* Like in lazy.h the product is only built where it is run, its states kept in
+* a cache bounded by a budget in bytes and flushed when full. If the cache is
+* flushed too often for the number of bytes run, the rest of the string is
+* instead run through the tables of the dfas one after the other, each byte
+* being looked up in every table before the next byte is read.
+*
+* A dfa stops moving as soon as its outcome is decided (see dfaTableDecide),
+* which keeps the product small, and a string is run no further once every
+* dfa is decided.
+*
+* The result of a string is a bitmask with bit i set if dfa i accepts it,
+* written as hex digits with the highest bit first.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef MULTI
+#define MULTI
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dfa.h"
+#include "nfa.h"
+#include "batch.h"
+
+#define MULTI_MAX_DFAS 64
+#define MULTI_BYTES_PER_STATE 40
+
+/*
+* A dfa still running the current string when not running the product. Holds
+* what the lookups of its table need, its current state and the index of its
+* dfa.
+*/
+typedef struct multiLane {
+
+	const int *next;
+	const unsigned short *classes;
+	const unsigned char *outcome;
+	int nrOfClasses;
+	int state;
+	int dfa;
+} multiLane;
+
+/*
+* The dfas run together. Bytes which every dfa puts in the same class share a
+* class of the product, classOf maps each byte to it. The cached states of the
+* product are the tuples in cache, the move of state s on class c is
+* next[s * nrOfClasses + c], -1 if not built yet. accepting holds the dfas
+* that accept in each state and decided if all of them are decided.
+*
+* A run is in the state current, or when not running the product in the lanes
+* of live, the first nrOfLive lanes being the dfas not decided yet. states
+* then holds the state every other dfa stopped in.
+*
+* accepted counts the strings each dfa has accepted, and bytes, built,
+* flushes and lanes count what the run has done.
+*/
+typedef struct multiDfa {
+
+	int size;
+	const dfaTable *tables[MULTI_MAX_DFAS];
+	int classOf[DFA_ALPHABET];
+	int representative[DFA_MAX_CLASSES];
+	int nrOfClasses;
+	size_t budget;
+	nfaSubsets cache;
+	int *next;
+	uint64_t *accepting;
+	bool *decided;
+	int nextCapacity;
+	int start;
+	int current;
+	bool inLanes;
+	int states[MULTI_MAX_DFAS];
+	multiLane live[MULTI_MAX_DFAS];
+	int nrOfLive;
+	int tuple[MULTI_MAX_DFAS];
+	long long accepted[MULTI_MAX_DFAS];
+	long long bytes;
+	long long bytesAtFlush;
+	long long built;
+	long long flushes;
+	long long lanes;
+} multiDfa;
+
+/*
+* description: Creates a run of several compiled dfas, with an empty cache.
+* param[in]: dfas - The dfas, which must stay alive while they are run.
+* param[in]: size - Number of dfas, at most MULTI_MAX_DFAS.
+* param[in]: budget - Number of bytes the cached states may use.
+* return: The run, ready for the first string.
+*/
+multiDfa *multiEmpty (dfa **dfas, int size, size_t budget);
+
+/*
+* description: Runs a part of a string through every dfa. The string may be
+* split over any number of feeds.
+* param[in]: multi - The run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiFeed (multiDfa *multi, const char *buffer, size_t length);
+
+/*
+* description: Runs a part of a string through the table of every dfa still
+* in the lanes.
+* param[in]: multi - The run.
+* param[in]: input - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiFeedLanes (multiDfa *multi, const unsigned char *input,
+		size_t length);
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: multi - The run.
+* return: The dfas that accept the string, bit i for dfa i.
+*/
+uint64_t multiFinalize (multiDfa *multi);
+
+/*
+* description: Starts a new string in the start state of every dfa.
+* param[in]: multi - The run.
+*/
+void multiReset (multiDfa *multi);
+
+/*
+* description: multiFeed for batchStream.
+* param[in]: multi - The run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void multiStreamFeed (void *multi, const char *buffer, size_t length);
+
+/*
+* description: Ends a string for batchStream, writing the bitmask of the dfas
+* that accept it. It counts as accepted if any dfa accepts it.
+* param[in]: multi - The run.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void multiStreamEnd (void *multi, FILE *out, batchResult *result);
+
+/*
+* description: Builds the move of a cached state on a class. Flushes the cache
+* if the new state does not fit, or moves the run to the lanes if flushing
+* does not pay off.
+* param[in]: multi - The run.
+* param[in]: from - The cached state moved from.
+* param[in]: class - The class of the byte moved on.
+* return: The cached state moved to, -1 if the run is now in the lanes.
+*/
+int multiBuild (multiDfa *multi, int from, int class);
+
+/*
+* description: Adds a state to the cache, flushing it first if the state does
+* not fit.
+* param[in]: multi - The run.
+* param[in]: tuple - The state of each dfa.
+* return: The cached state, -1 if it does not fit in the budget at all.
+*/
+int multiAdd (multiDfa *multi, const int *tuple);
+
+/*
+* description: Moves the run to the lanes for the rest of the string.
+* param[in]: multi - The run.
+* param[in]: tuple - The state of each dfa.
+*/
+void multiToLanes (multiDfa *multi, const int *tuple);
+
+/*
+* description: Throws away all cached states.
+* param[in]: multi - The run.
+*/
+void multiFlush (multiDfa *multi);
+
+/*
+* description: Finds the number of bytes a cached state uses.
+* param[in]: multi - The run.
+* return: The number of bytes.
+*/
+size_t multiStateCost (const multiDfa *multi);
+
+/*
+* description: Finds the classes of the product, the bytes every dfa puts in
+* the same class sharing one.
+* param[in]: multi - The run, with its tables set.
+* return: Number of classes.
+*/
+int multiClasses (multiDfa *multi);
+
+/*
+* description: Writes the number of strings each dfa has accepted, and what
+* the run has done.
+* param[in]: multi - The run.
+* param[in]: names - The name of each dfa.
+* param[in]: fp - The file to write to.
+*/
+void multiPrintSummary (const multiDfa *multi, const char * const *names,
+		FILE *fp);
+
+/*
+* description: Frees the run, but not its dfas.
+* param[in]: multi - The run.
+*/
+void multiKill (multiDfa *multi);
+
+#endif //MULTI
@@ -0,0 +1,1147 @@
+/*
+* nfa: Compiles regular expressions into dfas. A pattern is parsed into a
+* syntax tree, the tree is built into a Thompson NFA and the NFA is turned into
+* a dfa by subset construction. The dfa can then be minimized and compiled
+* like any other.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include <ctype.h>
+
+#include "nfa.h"
+
+/*
+* description: Compiles a pattern into an NFA. If the pattern is invalid the
+* reason is written to stderr.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* return: The NFA, NULL if the pattern is invalid.
+*/
+nfa *nfaCompile (const char *pattern, int flags) {
+
+	arena *arena = arenaEmpty();
+	nfaNode *root = nfaParse(pattern, flags, arena);
+	nfa *nfa = root != NULL ? nfaFromTree(root) : NULL;
+
+	arenaKill(arena);
+	return nfa;
+}
+
+/*
+* description: Parses a pattern into a syntax tree. If the pattern is invalid
+* the reason is written to stderr.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* param[in]: arena - The arena to allocate the nodes from.
+* return: The root of the tree, NULL if the pattern is invalid.
+*/
+nfaNode *nfaParse (const char *pattern, int flags, arena *arena) {
+
+	nfaParser parser;
+	parser.pattern = pattern;
+	parser.pos = 0;
+	parser.flags = flags;
+	parser.arena = arena;
+	parser.error = NULL;
+
+	nfaNode *root = nfaParseAlternation(&parser);
+	if (root != NULL && pattern[parser.pos] != '\0') {
+
+		root = nfaParseError(&parser, "unmatched ')'");
+	}
+	if (root == NULL) {
+
+		fprintf(stderr, "Invalid pattern at %d: %s\n", parser.pos,
+				parser.error);
+	}
+	return root;
+}
+
+/*
+* description: Builds the NFA of a syntax tree. If it gets too large the reason
+* is written to stderr.
+* param[in]: root - The root of the tree.
+* return: The NFA, NULL if it needs more than NFA_MAX_STATES states.
+*/
+nfa *nfaFromTree (const nfaNode *root) {
+
+	nfa *nfa = malloc(sizeof(struct nfa));
+	nfa -> size = 0;
+	nfa -> capacity = 64;
+	nfa -> states = malloc(sizeof(nfaState) * nfa -> capacity);
+
+	nfaFragment fragment = nfaBuild(nfa, root);
+	int match = nfaAddState(nfa, NFA_MATCH, -1, -1);
+	nfa -> states[fragment.end].out = match;
+	nfa -> start = fragment.start;
+
+	if (nfa -> size > NFA_MAX_STATES) {
+
+		fprintf(stderr, "Pattern needs more than %d NFA states\n",
+				NFA_MAX_STATES);
+		nfaKill(nfa);
+		return NULL;
+	}
+	return nfa;
+}
+
+/*
+* description: Builds a dfa accepting the same strings as an NFA by subset
+* construction. The dfa is not compiled. The states are named d0, d1 and so
+* on, d0 being the start state.
+* param[in]: nfa - The NFA.
+* param[in]: maxStates - The most states the dfa may get.
+* return: The dfa, NULL if it would get more than maxStates states.
+*/
+dfa *nfaDeterminize (const nfa *nfa, int maxStates) {
+
+	int classOf[DFA_ALPHABET];
+	int representative[DFA_MAX_CLASSES];
+	int nrOfClasses = nfaClasses(nfa, classOf, representative);
+	int *mark = calloc(nfa -> size, sizeof(int));
+	int *stack = malloc(sizeof(int) * nfa -> size);
+	int *set = malloc(sizeof(int) * nfa -> size);
+	int *current = malloc(sizeof(int) * nfa -> size);
+	int generation = 1;
+	int setSize;
+	int nextCapacity = 0;
+	int *next = NULL;
+	bool tooLarge = false;
+	nfaSubsets subsets = {0, 0, NULL, NULL, 0, 0, 0, NULL};
+
+	setSize = nfaStart(nfa, mark, generation, stack, set);
+	nfaSubsetsFind(&subsets, set, setSize);
+
+	//The subsets found are handled in order, new ones are added last.
+	for (int i = 0; i < subsets.size && !tooLarge; i++) {
+
+		int currentSize = subsets.begin[i + 1] - subsets.begin[i];
+		memcpy(current, &subsets.states[subsets.begin[i]],
+				sizeof(int) * currentSize);
+
+		if (subsets.capacity * nrOfClasses > nextCapacity) {
+
+			nextCapacity = subsets.capacity * nrOfClasses;
+			next = realloc(next, sizeof(int) * nextCapacity);
+		}
+
+		for (int c = 0; c < nrOfClasses; c++) {
+
+			setSize = nfaStep(nfa, current, currentSize, representative[c],
+					mark, ++generation, stack, set);
+			qsort(set, setSize, sizeof(int), nfaCompareStates);
+			if (setSize == 0) {
+
+				next[i * nrOfClasses + c] = -1;
+				continue;
+			}
+			next[i * nrOfClasses + c] = nfaSubsetsFind(&subsets, set, setSize);
+
+			if (subsets.size > maxStates) {
+
+				tooLarge = true;
+				break;
+			}
+		}
+	}
+
+	dfa *dfa = NULL;
+	if (!tooLarge) {
+
+		char name[16];
+		char key[2] = {'\0', '\0'};
+
+		dfa = dfaEmpty();
+		dfaSetStates(dfa, subsets.size);
+		for (int i = 0; i < subsets.size; i++) {
+
+			snprintf(name, sizeof(name), "d%d", i);
+			dfaInsertState(dfa, nfaSetAccepts(nfa,
+					&subsets.states[subsets.begin[i]],
+					subsets.begin[i + 1] - subsets.begin[i]), name);
+		}
+		dfaSetStart(dfa, "d0");
+
+		for (int i = 0; i < subsets.size; i++) {
+
+			for (int byte = 1; byte < DFA_ALPHABET; byte++) {
+
+				int destination = next[i * nrOfClasses + classOf[byte]];
+				if (destination >= 0) {
+
+					key[0] = (char)byte;
+					pathInsert(dfa -> arena, dfa -> allStates[i], key,
+							dfa -> allStates[destination]);
+				}
+			}
+		}
+	}
+
+	free(mark);
+	free(stack);
+	free(set);
+	free(current);
+	free(next);
+	nfaSubsetsKill(&subsets);
+	return dfa;
+}
+
+/*
+* description: Compiles a pattern into a dfa, see nfaCompile and
+* nfaDeterminize. The dfa may get at most NFA_MAX_SUBSETS states.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* return: The dfa, NULL if the pattern is invalid or too large.
+*/
+dfa *nfaBuildDfa (const char *pattern, int flags) {
+
+	nfa *nfa = nfaCompile(pattern, flags);
+	if (nfa == NULL) {
+
+		return NULL;
+	}
+
+	dfa *dfa = nfaDeterminize(nfa, NFA_MAX_SUBSETS);
+	if (dfa == NULL) {
+
+		fprintf(stderr, "Pattern needs more than %d dfa states\n",
+				NFA_MAX_SUBSETS);
+	}
+	nfaKill(nfa);
+	return dfa;
+}
+
+/*
+* description: Frees all memory allocated by an NFA.
+* param[in]: nfa - The NFA.
+*/
+void nfaKill (nfa *nfa) {
+
+	if (nfa != NULL) {
+
+		free(nfa -> states);
+		free(nfa);
+	}
+}
+
+/*
+* description: Parses alternatives separated by '|'.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseAlternation (nfaParser *parser) {
+
+	nfaNode *node = nfaParseConcat(parser);
+
+	while (node != NULL && parser -> pattern[parser -> pos] == '|') {
+
+		parser -> pos++;
+		nfaNode *right = nfaParseConcat(parser);
+		node = right != NULL ?
+				nfaNodeEmpty(parser, NFA_NODE_ALTERNATE, node, right) : NULL;
+	}
+	return node;
+}
+
+/*
+* description: Parses a sequence of repeated atoms.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseConcat (nfaParser *parser) {
+
+	nfaNode *node = nfaNodeEmpty(parser, NFA_NODE_EMPTY, NULL, NULL);
+	char c;
+
+	while ((c = parser -> pattern[parser -> pos]) != '\0' && c != '|' &&
+			c != ')') {
+
+		nfaNode *next = nfaParseRepeat(parser);
+		if (next == NULL) {
+
+			return NULL;
+		}
+		node = node -> type == NFA_NODE_EMPTY ? next :
+				nfaNodeEmpty(parser, NFA_NODE_CONCAT, node, next);
+	}
+	return node;
+}
+
+/*
+* description: Parses an atom followed by any number of repetitions.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseRepeat (nfaParser *parser) {
+
+	nfaNode *node = nfaParseAtom(parser);
+
+	while (node != NULL) {
+
+		char c = parser -> pattern[parser -> pos];
+		int min;
+		int max;
+
+		if (c == '*') {
+
+			min = 0;
+			max = -1;
+		} else if (c == '+') {
+
+			min = 1;
+			max = -1;
+		} else if (c == '?') {
+
+			min = 0;
+			max = 1;
+		} else if (c == '{') {
+
+			parser -> pos++;
+			min = nfaParseNumber(parser);
+			max = min;
+			if (min < 0) {
+
+				return nfaParseError(parser, "expected a number");
+			}
+			if (parser -> pattern[parser -> pos] == ',') {
+
+				parser -> pos++;
+				max = parser -> pattern[parser -> pos] == '}' ? -1 :
+						nfaParseNumber(parser);
+				if (max < 0 && parser -> pattern[parser -> pos] != '}') {
+
+					return nfaParseError(parser, "expected a number");
+				}
+			}
+			if (parser -> pattern[parser -> pos] != '}') {
+
+				return nfaParseError(parser, "missing '}'");
+			}
+			if (min > NFA_MAX_REPEAT || max > NFA_MAX_REPEAT) {
+
+				return nfaParseError(parser, "repetition is too large");
+			}
+			if (max >= 0 && max < min) {
+
+				return nfaParseError(parser, "repetition is out of order");
+			}
+		} else {
+
+			break;
+		}
+
+		parser -> pos++;
+		node = nfaNodeEmpty(parser, NFA_NODE_REPEAT, node, NULL);
+		node -> min = min;
+		node -> max = max;
+	}
+	return node;
+}
+
+/*
+* description: Parses a group, a set or a single char.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseAtom (nfaParser *parser) {
+
+	char c = parser -> pattern[parser -> pos];
+	nfaNode *node;
+
+	switch (c) {
+
+		case '(':
+			parser -> pos++;
+			node = nfaParseAlternation(parser);
+			if (node == NULL) {
+
+				return NULL;
+			}
+			if (parser -> pattern[parser -> pos] != ')') {
+
+				return nfaParseError(parser, "missing ')'");
+			}
+			parser -> pos++;
+			return node;
+
+		case '*':
+		case '+':
+		case '?':
+		case '{':
+			return nfaParseError(parser, "nothing to repeat");
+
+		case '^':
+		case '$':
+			return nfaParseError(parser, "anchors are not supported");
+	}
+
+	node = nfaNodeEmpty(parser, NFA_NODE_SET, NULL, NULL);
+	parser -> pos++;
+
+	if (c == '[') {
+
+		if (!nfaParseClass(parser, node -> set)) {
+
+			return NULL;
+		}
+		return node;
+	} else if (c == '.') {
+
+		for (int i = 1; i < DFA_ALPHABET; i++) {
+
+			nfaSetAdd(node -> set, i);
+		}
+	} else if (c == '\\') {
+
+		nfaParseEscape(parser, node -> set);
+		if (parser -> error != NULL) {
+
+			return NULL;
+		}
+	} else {
+
+		nfaSetAdd(node -> set, (unsigned char)c);
+	}
+
+	if (parser -> flags & NFA_ICASE) {
+
+		nfaSetFold(node -> set);
+	}
+	return node;
+}
+
+/*
+* description: Parses a bracketed set, after its '['.
+* param[in]: parser - The parser.
+* param[out]: set - The bytes of the set.
+* return: true if the set is valid, else false.
+*/
+bool nfaParseClass (nfaParser *parser, unsigned char *set) {
+
+	unsigned char members[NFA_SET_SIZE] = {0};
+	unsigned char scratch[NFA_SET_SIZE] = {0};
+	bool negated = false;
+	bool first = true;
+
+	if (parser -> pattern[parser -> pos] == '^') {
+
+		negated = true;
+		parser -> pos++;
+	}
+
+	//A ']' first in the set is a member of it.
+	while (parser -> pattern[parser -> pos] != ']' || first) {
+
+		const char *pattern = parser -> pattern;
+		int low;
+		first = false;
+
+		if (pattern[parser -> pos] == '\0') {
+
+			nfaParseError(parser, "missing ']'");
+			return false;
+		}
+		if (pattern[parser -> pos] == '\\') {
+
+			parser -> pos++;
+			low = nfaParseEscape(parser, members);
+			if (parser -> error != NULL) {
+
+				return false;
+			}
+			if (low < 0) {
+
+				continue;
+			}
+		} else {
+
+			low = (unsigned char)pattern[parser -> pos++];
+		}
+
+		if (pattern[parser -> pos] != '-' ||
+				pattern[parser -> pos + 1] == ']' ||
+				pattern[parser -> pos + 1] == '\0') {
+
+			nfaSetAdd(members, low);
+			continue;
+		}
+
+		int high;
+		parser -> pos++;
+		if (pattern[parser -> pos] == '\\') {
+
+			parser -> pos++;
+			high = nfaParseEscape(parser, scratch);
+			if (parser -> error != NULL) {
+
+				return false;
+			}
+		} else {
+
+			high = (unsigned char)pattern[parser -> pos++];
+		}
+		if (high < low) {
+
+			nfaParseError(parser, "invalid range");
+			return false;
+		}
+		for (int i = low; i <= high; i++) {
+
+			nfaSetAdd(members, i);
+		}
+	}
+	parser -> pos++;
+
+	if (parser -> flags & NFA_ICASE) {
+
+		nfaSetFold(members);
+	}
+	for (int i = 1; i < DFA_ALPHABET; i++) {
+
+		if (nfaSetHas(members, i) != negated) {
+
+			nfaSetAdd(set, i);
+		}
+	}
+	return true;
+}
+
+/*
+* description: Parses an escape, after its '\', and adds its bytes to a set.
+* param[in]: parser - The parser.
+* param[out]: set - The set to add to.
+* return: The byte if the escape is a single byte, else -1.
+*/
+int nfaParseEscape (nfaParser *parser, unsigned char *set) {
+
+	char c = parser -> pattern[parser -> pos];
+	unsigned char members[NFA_SET_SIZE] = {0};
+	int byte = -1;
+
+	if (c == '\0') {
+
+		nfaParseError(parser, "trailing '\\'");
+		return -1;
+	}
+	parser -> pos++;
+
+	switch (tolower((unsigned char)c)) {
+
+		case 'd':
+		case 'w':
+		case 's':
+			for (int i = 1; i < DFA_ALPHABET; i++) {
+
+				if ((tolower((unsigned char)c) == 'd' && isdigit(i)) ||
+						(tolower((unsigned char)c) == 'w' &&
+								(isalnum(i) || i == '_')) ||
+						(tolower((unsigned char)c) == 's' && isspace(i))) {
+
+					nfaSetAdd(members, i);
+				}
+			}
+			//The upper case escapes are the complements.
+			for (int i = 1; i < DFA_ALPHABET; i++) {
+
+				if (nfaSetHas(members, i) != (isupper((unsigned char)c) != 0)) {
+
+					nfaSetAdd(set, i);
+				}
+			}
+			return -1;
+
+		case 'b':
+			nfaParseError(parser, "word boundaries are not supported");
+			return -1;
+
+		case 'n':
+			byte = c == 'n' ? '\n' : 'N';
+			break;
+
+		case 't':
+			byte = c == 't' ? '\t' : 'T';
+			break;
+
+		case 'r':
+			byte = c == 'r' ? '\r' : 'R';
+			break;
+
+		default:
+			byte = (unsigned char)c;
+			break;
+	}
+
+	nfaSetAdd(set, byte);
+	return byte;
+}
+
+/*
+* description: Parses a number of a counted repetition.
+* param[in]: parser - The parser.
+* return: The number, -1 if there is none.
+*/
+int nfaParseNumber (nfaParser *parser) {
+
+	int number = -1;
+	char c;
+
+	while (isdigit((unsigned char)(c = parser -> pattern[parser -> pos]))) {
+
+		//Anything larger than NFA_MAX_REPEAT is rejected anyway.
+		number = number < 0 ? 0 : number;
+		if (number <= NFA_MAX_REPEAT) {
+
+			number = number * 10 + (c - '0');
+		}
+		parser -> pos++;
+	}
+	return number;
+}
+
+/*
+* description: Creates a syntax tree node.
+* param[in]: parser - The parser.
+* param[in]: type - The kind of node.
+* param[in]: left - The first child, or NULL.
+* param[in]: right - The second child, or NULL.
+* return: The node.
+*/
+nfaNode *nfaNodeEmpty (nfaParser *parser, int type, nfaNode *left,
+		nfaNode *right) {
+
+	nfaNode *node = arenaAlloc(parser -> arena, sizeof(struct nfaNode));
+	node -> type = type;
+	memset(node -> set, 0, NFA_SET_SIZE);
+	node -> left = left;
+	node -> right = right;
+	node -> min = 0;
+	node -> max = 0;
+	return node;
+}
+
+/*
+* description: Records the first error found in a pattern.
+* param[in]: parser - The parser.
+* param[in]: error - Description of the error.
+* return: NULL, to be returned by the failing parse function.
+*/
+nfaNode *nfaParseError (nfaParser *parser, const char *error) {
+
+	if (parser -> error == NULL) {
+
+		parser -> error = error;
+	}
+	return NULL;
+}
+
+/*
+* description: Builds the NFA states of a syntax tree node. A node is built
+* again for every time it is repeated. Once the NFA has more than
+* NFA_MAX_STATES states nothing more is built.
+* param[in]: nfa - The NFA.
+* param[in]: node - The node.
+* return: The fragment for the node.
+*/
+nfaFragment nfaBuild (nfa *nfa, const nfaNode *node) {
+
+	nfaFragment fragment;
+	nfaFragment next;
+	int end;
+
+	if (nfa -> size > NFA_MAX_STATES) {
+
+		fragment.start = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+		fragment.end = fragment.start;
+		return fragment;
+	}
+
+	switch (node -> type) {
+
+		case NFA_NODE_SET:
+			fragment.start = nfaAddState(nfa, NFA_SET, -1, -1);
+			fragment.end = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+			memcpy(nfa -> states[fragment.start].set, node -> set,
+					NFA_SET_SIZE);
+			nfa -> states[fragment.start].out = fragment.end;
+			break;
+
+		case NFA_NODE_CONCAT:
+			fragment = nfaBuild(nfa, node -> left);
+			next = nfaBuild(nfa, node -> right);
+			nfa -> states[fragment.end].out = next.start;
+			fragment.end = next.end;
+			break;
+
+		case NFA_NODE_ALTERNATE:
+			fragment = nfaBuild(nfa, node -> left);
+			next = nfaBuild(nfa, node -> right);
+			end = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+			nfa -> states[fragment.end].out = end;
+			nfa -> states[next.end].out = end;
+			fragment.start = nfaAddState(nfa, NFA_SPLIT, fragment.start,
+					next.start);
+			fragment.end = end;
+			break;
+
+		case NFA_NODE_REPEAT:
+			fragment.start = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+			fragment.end = fragment.start;
+
+			for (int i = 0; i < node -> max || i < node -> min ||
+					(node -> max < 0 && i == node -> min); i++) {
+
+				next = nfaBuild(nfa, node -> left);
+				if (node -> max < 0 && i == node -> min) {
+
+					next = nfaBuildStar(nfa, next);
+				} else if (i >= node -> min) {
+
+					next = nfaBuildOptional(nfa, next);
+				}
+				nfa -> states[fragment.end].out = next.start;
+				fragment.end = next.end;
+			}
+			break;
+
+		default:
+			fragment.start = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+			fragment.end = fragment.start;
+			break;
+	}
+	return fragment;
+}
+
+/*
+* description: Builds a fragment matching another fragment zero or more times.
+* param[in]: nfa - The NFA.
+* param[in]: fragment - The fragment to repeat.
+* return: The new fragment.
+*/
+nfaFragment nfaBuildStar (nfa *nfa, nfaFragment fragment) {
+
+	nfaFragment star;
+	star.end = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+	star.start = nfaAddState(nfa, NFA_SPLIT, fragment.start, star.end);
+	nfa -> states[fragment.end].out = star.start;
+	return star;
+}
+
+/*
+* description: Builds a fragment matching another fragment or nothing.
+* param[in]: nfa - The NFA.
+* param[in]: fragment - The optional fragment.
+* return: The new fragment.
+*/
+nfaFragment nfaBuildOptional (nfa *nfa, nfaFragment fragment) {
+
+	nfaFragment optional;
+	optional.end = nfaAddState(nfa, NFA_EPSILON, -1, -1);
+	optional.start = nfaAddState(nfa, NFA_SPLIT, fragment.start, optional.end);
+	nfa -> states[fragment.end].out = optional.end;
+	return optional;
+}
+
+/*
+* description: Adds a state to an NFA.
+* param[in]: nfa - The NFA.
+* param[in]: type - The kind of state.
+* param[in]: out - The state it leads to, or -1.
+* param[in]: out1 - The second state a split leads to, or -1.
+* return: Index of the new state.
+*/
+int nfaAddState (nfa *nfa, int type, int out, int out1) {
+
+	if (nfa -> size == nfa -> capacity) {
+
+		nfa -> capacity *= 2;
+		nfa -> states = realloc(nfa -> states,
+				sizeof(nfaState) * nfa -> capacity);
+	}
+
+	nfaState *state = &nfa -> states[nfa -> size];
+	state -> type = type;
+	memset(state -> set, 0, NFA_SET_SIZE);
+	state -> out = out;
+	state -> out1 = out1;
+	return nfa -> size++;
+}
+
+/*
+* description: Finds the set of states a run of the NFA starts in.
+* param[in]: nfa - The NFA.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - A generation not used before.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: set - The set of states, in order.
+* return: Number of states in the set.
+*/
+int nfaStart (const nfa *nfa, int *mark, int generation, int *stack,
+		int *set) {
+
+	int setSize = 0;
+	nfaClosure(nfa, nfa -> start, mark, generation, stack, set, &setSize);
+	qsort(set, setSize, sizeof(int), nfaCompareStates);
+	return setSize;
+}
+
+/*
+* description: Finds the set of states an NFA moves to from a set of states
+* on a byte.
+* param[in]: nfa - The NFA.
+* param[in]: set - The states moved from.
+* param[in]: setSize - Number of states moved from.
+* param[in]: byte - The byte.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - A generation not used before.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: next - The states moved to, not in order. Must not be set.
+* return: Number of states moved to.
+*/
+int nfaStep (const nfa *nfa, const int *set, int setSize, int byte, int *mark,
+		int generation, int *stack, int *next) {
+
+	int nextSize = 0;
+
+	//No set holds the byte 0.
+	for (int i = 0; i < setSize && byte != 0; i++) {
+
+		const nfaState *state = &nfa -> states[set[i]];
+		if (state -> type == NFA_SET && nfaSetHas(state -> set, byte)) {
+
+			nfaClosure(nfa, state -> out, mark, generation, stack, next,
+					&nextSize);
+		}
+	}
+	return nextSize;
+}
+
+/*
+* description: Checks if a set of states holds the match state.
+* param[in]: nfa - The NFA.
+* param[in]: set - The states.
+* param[in]: setSize - Number of states.
+* return: true if a run in the set has matched, else false.
+*/
+bool nfaSetAccepts (const nfa *nfa, const int *set, int setSize) {
+
+	for (int i = 0; i < setSize; i++) {
+
+		if (nfa -> states[set[i]].type == NFA_MATCH) {
+
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+* description: Adds the states reachable from a state without consuming any
+* byte to a set of states. Only set and match states are added.
+* param[in]: nfa - The NFA.
+* param[in]: state - The state to start from.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - The generation of the set being built.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: set - The set of states.
+* param[in/out]: setSize - Number of states in the set.
+*/
+void nfaClosure (const nfa *nfa, int state, int *mark, int generation,
+		int *stack, int *set, int *setSize) {
+
+	int size = 0;
+
+	if (mark[state] != generation) {
+
+		mark[state] = generation;
+		stack[size++] = state;
+	}
+	while (size > 0) {
+
+		const nfaState *curr = &nfa -> states[stack[--size]];
+
+		if (curr -> type == NFA_SET || curr -> type == NFA_MATCH) {
+
+			set[(*setSize)++] = curr - nfa -> states;
+			continue;
+		}
+		if (curr -> out >= 0 && mark[curr -> out] != generation) {
+
+			mark[curr -> out] = generation;
+			stack[size++] = curr -> out;
+		}
+		if (curr -> type == NFA_SPLIT && mark[curr -> out1] != generation) {
+
+			mark[curr -> out1] = generation;
+			stack[size++] = curr -> out1;
+		}
+	}
+}
+
+/*
+* description: Splits the bytes into classes, so that bytes in the same class
+* are in the same sets of the NFA. The byte 0 gets a class of its own.
+* param[in]: nfa - The NFA.
+* param[out]: classOf - The class of each byte.
+* param[out]: representative - A byte of each class.
+* return: Number of classes.
+*/
+int nfaClasses (const nfa *nfa, int *classOf, int *representative) {
+
+	int nrOfClasses = 2;
+	int split[2][DFA_MAX_CLASSES];
+
+	classOf[0] = 0;
+	for (int i = 1; i < DFA_ALPHABET; i++) {
+
+		classOf[i] = 1;
+	}
+
+	//Every set splits the classes into the bytes in it and those not in it.
+	for (int s = 0; s < nfa -> size; s++) {
+
+		if (nfa -> states[s].type != NFA_SET) {
+
+			continue;
+		}
+		for (int i = 0; i < nrOfClasses; i++) {
+
+			split[0][i] = -1;
+			split[1][i] = -1;
+		}
+
+		int newClasses = 1;
+		for (int i = 1; i < DFA_ALPHABET; i++) {
+
+			int has = nfaSetHas(nfa -> states[s].set, i);
+			if (split[has][classOf[i]] < 0) {
+
+				split[has][classOf[i]] = newClasses++;
+			}
+			classOf[i] = split[has][classOf[i]];
+		}
+		nrOfClasses = newClasses;
+	}
+
+	for (int i = DFA_ALPHABET - 1; i >= 0; i--) {
+
+		representative[classOf[i]] = i;
+	}
+	return nrOfClasses;
+}
+
+/*
+* description: Finds a set of states, or adds it if it is new.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set.
+*/
+int nfaSubsetsFind (nfaSubsets *subsets, const int *set, int setSize) {
+
+	int found = nfaSubsetsLookup(subsets, set, setSize);
+	return found >= 0 ? found : nfaSubsetsAdd(subsets, set, setSize);
+}
+
+/*
+* description: Finds a set of states.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set, -1 if it has not been found.
+*/
+int nfaSubsetsLookup (const nfaSubsets *subsets, const int *set, int setSize) {
+
+	if (subsets -> indexCapacity == 0) {
+
+		return -1;
+	}
+
+	int mask = subsets -> indexCapacity - 1;
+	int slot = nfaSubsetsHash(set, setSize) & mask;
+	while (subsets -> index[slot] >= 0) {
+
+		int i = subsets -> index[slot];
+		int size = subsets -> begin[i + 1] - subsets -> begin[i];
+		if (size == setSize && memcmp(&subsets -> states[subsets -> begin[i]],
+				set, sizeof(int) * setSize) == 0) {
+
+			return i;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+/*
+* description: Adds a set of states, which must not have been found before.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set.
+*/
+int nfaSubsetsAdd (nfaSubsets *subsets, const int *set, int setSize) {
+
+	if (subsets -> size + 1 >= subsets -> capacity) {
+
+		subsets -> capacity = subsets -> capacity == 0 ? 64 :
+				2 * subsets -> capacity;
+		subsets -> begin = realloc(subsets -> begin,
+				sizeof(int) * (subsets -> capacity + 1));
+		subsets -> begin[0] = 0;
+	}
+	if (subsets -> statesSize + setSize > subsets -> statesCapacity) {
+
+		while (subsets -> statesSize + setSize > subsets -> statesCapacity) {
+
+			subsets -> statesCapacity = subsets -> statesCapacity == 0 ? 256 :
+					2 * subsets -> statesCapacity;
+		}
+		subsets -> states = realloc(subsets -> states,
+				sizeof(int) * subsets -> statesCapacity);
+	}
+
+	memcpy(&subsets -> states[subsets -> statesSize], set,
+			sizeof(int) * setSize);
+	subsets -> statesSize += setSize;
+	subsets -> begin[subsets -> size + 1] = subsets -> statesSize;
+	subsets -> size++;
+
+	if (2 * subsets -> size > subsets -> indexCapacity) {
+
+		subsets -> indexCapacity = subsets -> indexCapacity == 0 ? 64 :
+				2 * subsets -> indexCapacity;
+		free(subsets -> index);
+		subsets -> index = malloc(sizeof(int) * subsets -> indexCapacity);
+		nfaSubsetsIndex(subsets, 0);
+	} else {
+
+		nfaSubsetsIndex(subsets, subsets -> size - 1);
+	}
+	return subsets -> size - 1;
+}
+
+/*
+* description: Puts sets into the index. With first 0 the index is cleared
+* and every set is put back into it.
+* param[in]: subsets - The sets.
+* param[in]: first - Index of the first set to put into the index.
+*/
+void nfaSubsetsIndex (nfaSubsets *subsets, int first) {
+
+	int mask = subsets -> indexCapacity - 1;
+
+	if (first == 0) {
+
+		for (int i = 0; i < subsets -> indexCapacity; i++) {
+
+			subsets -> index[i] = -1;
+		}
+	}
+	for (int i = first; i < subsets -> size; i++) {
+
+		const int *set = &subsets -> states[subsets -> begin[i]];
+		int slot = nfaSubsetsHash(set, subsets -> begin[i + 1] -
+				subsets -> begin[i]) & mask;
+		while (subsets -> index[slot] >= 0) {
+
+			slot = (slot + 1) & mask;
+		}
+		subsets -> index[slot] = i;
+	}
+}
+
+/*
+* description: Hashes a set of states (FNV-1a).
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: The hash.
+*/
+unsigned int nfaSubsetsHash (const int *set, int setSize) {
+
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < setSize; i++) {
+
+		hash = (hash ^ (unsigned int)set[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+* description: Forgets all sets, keeping the memory for new ones.
+* param[in]: subsets - The sets.
+*/
+void nfaSubsetsClear (nfaSubsets *subsets) {
+
+	subsets -> size = 0;
+	subsets -> statesSize = 0;
+	for (int i = 0; i < subsets -> indexCapacity; i++) {
+
+		subsets -> index[i] = -1;
+	}
+}
+
+/*
+* description: Frees the memory of the sets.
+* param[in]: subsets - The sets.
+*/
+void nfaSubsetsKill (nfaSubsets *subsets) {
+
+	free(subsets -> begin);
+	free(subsets -> states);
+	free(subsets -> index);
+}
+
+/*
+* description: Adds the other case of every letter in a set.
+* param[in/out]: set - The set.
+*/
+void nfaSetFold (unsigned char *set) {
+
+	for (int i = 'a'; i <= 'z'; i++) {
+
+		if (nfaSetHas(set, i) || nfaSetHas(set, toupper(i))) {
+
+			nfaSetAdd(set, i);
+			nfaSetAdd(set, toupper(i));
+		}
+	}
+}
+
+/*
+* description: Compares two NFA states, for sorting sets of them.
+* param[in]: a - The first state.
+* param[in]: b - The second state.
+* return: Negative, zero or positive as a is before, same as or after b.
+*/
+int nfaCompareStates (const void *a, const void *b) {
+
+	int first = *(const int *)a;
+	int second = *(const int *)b;
+	return (first > second) - (first < second);
+}
+
+/*
+* description: Checks if a byte is in a set.
+* param[in]: set - The set.
+* param[in]: byte - The byte.
+* return: true if it is in the set, else false.
+*/
+bool nfaSetHas (const unsigned char *set, int byte) {
+
+	return (set[byte >> 3] >> (byte & 7)) & 1;
+}
+
+/*
+* description: Adds a byte to a set.
+* param[out]: set - The set.
+* param[in]: byte - The byte.
+*/
+void nfaSetAdd (unsigned char *set, int byte) {
+
+	set[byte >> 3] |= 1 << (byte & 7);
+}
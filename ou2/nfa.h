@@ -0,0 +1,434 @@
+/*
+* nfa: Compiles regular expressions into dfas. A pattern is parsed into a
+* syntax tree, the tree is built into a Thompson NFA and the NFA is turned into
+* a dfa by subset construction. The dfa can then be minimized and compiled
+* like any other.
+*
+* Patterns always match whole strings. The syntax is a subset of POSIX
+* extended expressions:
+* - Any char but the special ones below matches itself.
+* - '.' matches any byte, [abc], [a-z] and [^abc] match sets of bytes.
+* - \d, \w and \s match digits, word chars and white space, \D, \W and \S
+*   everything else. \n, \t and \r are the control chars, any other escaped
+*   char matches itself.
+* - (...) groups and | separates alternatives.
+* - *, +, ?, {n}, {n,} and {n,m} repeat what is before them.
+* Anchors and word boundaries are not supported. The byte 0 can never be
+* matched, since it can not be the key of a path.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef NFA
+#define NFA
+
+#include <stdio.h>
+
+#include "dfa.h"
+#include "arena.h"
+
+#define NFA_ICASE 1
+#define NFA_MAX_REPEAT 1000
+#define NFA_MAX_STATES (1 << 20)
+#define NFA_MAX_SUBSETS (1 << 16)
+#define NFA_SET_SIZE (DFA_ALPHABET / 8)
+
+/*
+* Kinds of nodes in the syntax tree.
+*/
+#define NFA_NODE_SET 0
+#define NFA_NODE_EMPTY 1
+#define NFA_NODE_CONCAT 2
+#define NFA_NODE_ALTERNATE 3
+#define NFA_NODE_REPEAT 4
+
+/*
+* Kinds of NFA states. A set state moves on the bytes in its set, an epsilon
+* state moves on nothing to out and a split state to both out and out1.
+*/
+#define NFA_SET 0
+#define NFA_EPSILON 1
+#define NFA_SPLIT 2
+#define NFA_MATCH 3
+
+/*
+* A node of the syntax tree. Sets use set, concatenation and alternation left
+* and right, and repetition left, min and max, max being -1 if unbounded.
+*/
+typedef struct nfaNode {
+
+	int type;
+	unsigned char set[NFA_SET_SIZE];
+	struct nfaNode *left;
+	struct nfaNode *right;
+	int min;
+	int max;
+} nfaNode;
+
+/*
+* A pattern being parsed. The nodes are allocated from the arena. error is
+* set, together with pos, as soon as the pattern is found to be invalid.
+*/
+typedef struct nfaParser {
+
+	const char *pattern;
+	int pos;
+	int flags;
+	arena *arena;
+	const char *error;
+} nfaParser;
+
+typedef struct nfaState {
+
+	int type;
+	unsigned char set[NFA_SET_SIZE];
+	int out;
+	int out1;
+} nfaState;
+
+/*
+* A Thompson NFA. A state is referred to by its index in states, -1 meaning
+* no state.
+*/
+typedef struct nfa {
+
+	int size;
+	int capacity;
+	nfaState *states;
+	int start;
+} nfa;
+
+/*
+* A part of an NFA being built. It is entered at start and left from end,
+* an epsilon state whose out is not set yet.
+*/
+typedef struct nfaFragment {
+
+	int start;
+	int end;
+} nfaFragment;
+
+/*
+* The sets of NFA states found while building a dfa, stored one after the
+* other in states. The sets are looked up through an open addressing index.
+*/
+typedef struct nfaSubsets {
+
+	int size;
+	int capacity;
+	int *begin;
+	int *states;
+	int statesSize;
+	int statesCapacity;
+	int indexCapacity;
+	int *index;
+} nfaSubsets;
+
+/*
+* description: Compiles a pattern into an NFA. If the pattern is invalid the
+* reason is written to stderr.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* return: The NFA, NULL if the pattern is invalid.
+*/
+nfa *nfaCompile (const char *pattern, int flags);
+
+/*
+* description: Parses a pattern into a syntax tree. If the pattern is invalid
+* the reason is written to stderr.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* param[in]: arena - The arena to allocate the nodes from.
+* return: The root of the tree, NULL if the pattern is invalid.
+*/
+nfaNode *nfaParse (const char *pattern, int flags, arena *arena);
+
+/*
+* description: Builds the NFA of a syntax tree. If it gets too large the reason
+* is written to stderr.
+* param[in]: root - The root of the tree.
+* return: The NFA, NULL if it needs more than NFA_MAX_STATES states.
+*/
+nfa *nfaFromTree (const nfaNode *root);
+
+/*
+* description: Builds a dfa accepting the same strings as an NFA by subset
+* construction. The dfa is not compiled. The states are named d0, d1 and so
+* on, d0 being the start state.
+* param[in]: nfa - The NFA.
+* param[in]: maxStates - The most states the dfa may get.
+* return: The dfa, NULL if it would get more than maxStates states.
+*/
+dfa *nfaDeterminize (const nfa *nfa, int maxStates);
+
+/*
+* description: Compiles a pattern into a dfa, see nfaCompile and
+* nfaDeterminize. The dfa may get at most NFA_MAX_SUBSETS states.
+* param[in]: pattern - The pattern, terminated.
+* param[in]: flags - NFA_ICASE to ignore the case of letters, else 0.
+* return: The dfa, NULL if the pattern is invalid or too large.
+*/
+dfa *nfaBuildDfa (const char *pattern, int flags);
+
+/*
+* description: Frees all memory allocated by an NFA.
+* param[in]: nfa - The NFA.
+*/
+void nfaKill (nfa *nfa);
+
+/*
+* description: Parses alternatives separated by '|'.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseAlternation (nfaParser *parser);
+
+/*
+* description: Parses a sequence of repeated atoms.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseConcat (nfaParser *parser);
+
+/*
+* description: Parses an atom followed by any number of repetitions.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseRepeat (nfaParser *parser);
+
+/*
+* description: Parses a group, a set or a single char.
+* param[in]: parser - The parser.
+* return: The node, NULL on error.
+*/
+nfaNode *nfaParseAtom (nfaParser *parser);
+
+/*
+* description: Parses a bracketed set, after its '['.
+* param[in]: parser - The parser.
+* param[out]: set - The bytes of the set.
+* return: true if the set is valid, else false.
+*/
+bool nfaParseClass (nfaParser *parser, unsigned char *set);
+
+/*
+* description: Parses an escape, after its '\', and adds its bytes to a set.
+* param[in]: parser - The parser.
+* param[out]: set - The set to add to.
+* return: The byte if the escape is a single byte, else -1.
+*/
+int nfaParseEscape (nfaParser *parser, unsigned char *set);
+
+/*
+* description: Parses a number of a counted repetition.
+* param[in]: parser - The parser.
+* return: The number, -1 if there is none.
+*/
+int nfaParseNumber (nfaParser *parser);
+
+/*
+* description: Creates a syntax tree node.
+* param[in]: parser - The parser.
+* param[in]: type - The kind of node.
+* param[in]: left - The first child, or NULL.
+* param[in]: right - The second child, or NULL.
+* return: The node.
+*/
+nfaNode *nfaNodeEmpty (nfaParser *parser, int type, nfaNode *left,
+		nfaNode *right);
+
+/*
+* description: Records the first error found in a pattern.
+* param[in]: parser - The parser.
+* param[in]: error - Description of the error.
+* return: NULL, to be returned by the failing parse function.
+*/
+nfaNode *nfaParseError (nfaParser *parser, const char *error);
+
+/*
+* description: Builds the NFA states of a syntax tree node. A node is built
+* again for every time it is repeated. Once the NFA has more than
+* NFA_MAX_STATES states nothing more is built.
+* param[in]: nfa - The NFA.
+* param[in]: node - The node.
+* return: The fragment for the node.
+*/
+nfaFragment nfaBuild (nfa *nfa, const nfaNode *node);
+
+/*
+* description: Builds a fragment matching another fragment zero or more times.
+* param[in]: nfa - The NFA.
+* param[in]: fragment - The fragment to repeat.
+* return: The new fragment.
+*/
+nfaFragment nfaBuildStar (nfa *nfa, nfaFragment fragment);
+
+/*
+* description: Builds a fragment matching another fragment or nothing.
+* param[in]: nfa - The NFA.
+* param[in]: fragment - The optional fragment.
+* return: The new fragment.
+*/
+nfaFragment nfaBuildOptional (nfa *nfa, nfaFragment fragment);
+
+/*
+* description: Adds a state to an NFA.
+* param[in]: nfa - The NFA.
+* param[in]: type - The kind of state.
+* param[in]: out - The state it leads to, or -1.
+* param[in]: out1 - The second state a split leads to, or -1.
+* return: Index of the new state.
+*/
+int nfaAddState (nfa *nfa, int type, int out, int out1);
+
+/*
+* description: Finds the set of states a run of the NFA starts in.
+* param[in]: nfa - The NFA.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - A generation not used before.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: set - The set of states, in order.
+* return: Number of states in the set.
+*/
+int nfaStart (const nfa *nfa, int *mark, int generation, int *stack,
+		int *set);
+
+/*
+* description: Finds the set of states an NFA moves to from a set of states
+* on a byte.
+* param[in]: nfa - The NFA.
+* param[in]: set - The states moved from.
+* param[in]: setSize - Number of states moved from.
+* param[in]: byte - The byte.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - A generation not used before.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: next - The states moved to, not in order. Must not be set.
+* return: Number of states moved to.
+*/
+int nfaStep (const nfa *nfa, const int *set, int setSize, int byte, int *mark,
+		int generation, int *stack, int *next);
+
+/*
+* description: Checks if a set of states holds the match state.
+* param[in]: nfa - The NFA.
+* param[in]: set - The states.
+* param[in]: setSize - Number of states.
+* return: true if a run in the set has matched, else false.
+*/
+bool nfaSetAccepts (const nfa *nfa, const int *set, int setSize);
+
+/*
+* description: Adds the states reachable from a state without consuming any
+* byte to a set of states. Only set and match states are added.
+* param[in]: nfa - The NFA.
+* param[in]: state - The state to start from.
+* param[in/out]: mark - The generation each state was last visited in.
+* param[in]: generation - The generation of the set being built.
+* param[in/out]: stack - Room for nfa -> size states.
+* param[out]: set - The set of states.
+* param[in/out]: setSize - Number of states in the set.
+*/
+void nfaClosure (const nfa *nfa, int state, int *mark, int generation,
+		int *stack, int *set, int *setSize);
+
+/*
+* description: Splits the bytes into classes, so that bytes in the same class
+* are in the same sets of the NFA. The byte 0 gets a class of its own.
+* param[in]: nfa - The NFA.
+* param[out]: classOf - The class of each byte.
+* param[out]: representative - A byte of each class.
+* return: Number of classes.
+*/
+int nfaClasses (const nfa *nfa, int *classOf, int *representative);
+
+/*
+* description: Finds a set of states, or adds it if it is new.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set.
+*/
+int nfaSubsetsFind (nfaSubsets *subsets, const int *set, int setSize);
+
+/*
+* description: Finds a set of states.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set, -1 if it has not been found.
+*/
+int nfaSubsetsLookup (const nfaSubsets *subsets, const int *set, int setSize);
+
+/*
+* description: Adds a set of states, which must not have been found before.
+* param[in]: subsets - The sets found so far.
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: Index of the set.
+*/
+int nfaSubsetsAdd (nfaSubsets *subsets, const int *set, int setSize);
+
+/*
+* description: Puts sets into the index. With first 0 the index is cleared
+* and every set is put back into it.
+* param[in]: subsets - The sets.
+* param[in]: first - Index of the first set to put into the index.
+*/
+void nfaSubsetsIndex (nfaSubsets *subsets, int first);
+
+/*
+* description: Hashes a set of states (FNV-1a).
+* param[in]: set - The states, in order.
+* param[in]: setSize - Number of states.
+* return: The hash.
+*/
+unsigned int nfaSubsetsHash (const int *set, int setSize);
+
+/*
+* description: Forgets all sets, keeping the memory for new ones.
+* param[in]: subsets - The sets.
+*/
+void nfaSubsetsClear (nfaSubsets *subsets);
+
+/*
+* description: Frees the memory of the sets.
+* param[in]: subsets - The sets.
+*/
+void nfaSubsetsKill (nfaSubsets *subsets);
+
+/*
+* description: Adds the other case of every letter in a set.
+* param[in/out]: set - The set.
+*/
+void nfaSetFold (unsigned char *set);
+
+/*
+* description: Compares two NFA states, for sorting sets of them.
+* param[in]: a - The first state.
+* param[in]: b - The second state.
+* return: Negative, zero or positive as a is before, same as or after b.
+*/
+int nfaCompareStates (const void *a, const void *b);
+
+/*
+* description: Checks if a byte is in a set.
+* param[in]: set - The set.
+* param[in]: byte - The byte.
+* return: true if it is in the set, else false.
+*/
+bool nfaSetHas (const unsigned char *set, int byte);
+
+/*
+* description: Adds a byte to a set.
+* param[out]: set - The set.
+* param[in]: byte - The byte.
+*/
+void nfaSetAdd (unsigned char *set, int byte);
+
+#endif //NFA
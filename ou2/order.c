@@ -0,0 +1,317 @@
+/*
+* order: Renumbers the states of a compiled dfa, so that states which are run
+* one after the other are close in its table. See order.h.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "order.h"
+#include "profile.h"
+
+/*
+* description: Numbers the states of a compiled table in breadth first order
+* from the start state. States that cannot be reached follow in their old
+* order.
+* param[in]: table - The table.
+* return: The new number of each state, to be freed by the caller.
+*/
+int *orderBreadthFirst (const dfaTable *table) {
+
+	int nrOfStates = table -> nrOfStates;
+	int nrOfClasses = table -> nrOfClasses;
+	int *newNr = malloc(sizeof(int) * nrOfStates);
+	int *queue = malloc(sizeof(int) * nrOfStates);
+	int head = 0;
+	int tail = 0;
+	int room[DFA_MAX_CLASSES];
+
+	for (int i = 0; i < nrOfStates; i++) {
+
+		newNr[i] = -1;
+	}
+	newNr[table -> errorState] = nrOfStates - 1;
+	if (table -> startState != table -> errorState) {
+
+		newNr[table -> startState] = tail;
+		queue[tail++] = table -> startState;
+	}
+
+	//Class 0 always leads to the error state.
+	while (head < tail) {
+
+		const int *row = dfaTableRow(table, queue[head++], room);
+		for (int c = 1; c < nrOfClasses; c++) {
+
+			if (newNr[row[c]] < 0) {
+
+				newNr[row[c]] = tail;
+				queue[tail++] = row[c];
+			}
+		}
+	}
+
+	for (int i = 0; i < nrOfStates; i++) {
+
+		if (newNr[i] < 0) {
+
+			newNr[i] = tail++;
+		}
+	}
+	free(queue);
+	return newNr;
+}
+
+/*
+* description: Numbers the states of a compiled table by their visits, the
+* most visited first and ties in breadth first order.
+* param[in]: table - The table.
+* param[in]: visits - The number of visits of each state.
+* return: The new number of each state, to be freed by the caller.
+*/
+int *orderHotFirst (const dfaTable *table, const long long *visits) {
+
+	int *newNr = orderBreadthFirst(table);
+	orderRank *ranks = malloc(sizeof(orderRank) * table -> nrOfStates);
+	int nrOfRanks = 0;
+
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (i != table -> errorState) {
+
+			ranks[nrOfRanks].visits = visits[i];
+			ranks[nrOfRanks].rank = newNr[i];
+			ranks[nrOfRanks].state = i;
+			nrOfRanks++;
+		}
+	}
+	qsort(ranks, nrOfRanks, sizeof(orderRank), orderCompareRanks);
+
+	for (int i = 0; i < nrOfRanks; i++) {
+
+		newNr[ranks[i].state] = i;
+	}
+	free(ranks);
+	return newNr;
+}
+
+/*
+* description: Counts the states a training run visited, other than the error
+* state. Ordered hot first, these are the first states of the table.
+* param[in]: table - The table.
+* param[in]: visits - The number of visits of each state.
+* return: The number of visited states.
+*/
+int orderCountHot (const dfaTable *table, const long long *visits) {
+
+	int nrOfHotStates = 0;
+
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (i != table -> errorState && visits[i] > 0) {
+
+			nrOfHotStates++;
+		}
+	}
+	return nrOfHotStates;
+}
+
+/*
+* description: Counts the visits of each state while running newline
+* separated strings through a compiled table. Every string visits the start
+* state.
+* param[in]: table - The table.
+* param[in]: in - The file with the strings.
+* return: The number of visits of each state, to be freed by the caller.
+*/
+long long *orderTrain (const dfaTable *table, FILE *in) {
+
+	orderProfile profile;
+	batchResult result;
+
+	profile.table = table;
+	profile.state = table -> startState;
+	profile.started = false;
+	profile.visits = calloc(table -> nrOfStates, sizeof(long long));
+
+	batchStream(&profile, orderProfileFeed, orderProfileEnd, in, NULL,
+			&result);
+	return profile.visits;
+}
+
+/*
+* description: Reads the visits of each state from a profile dump (see
+* profile.h), matching the states by name. States the dump does not name are
+* not visited.
+* param[in]: dfa - The built and compiled dfa.
+* param[in]: in - The file, read from its start.
+* return: The number of visits of each state, to be freed by the caller, or
+* NULL if the file is not a profile dump.
+*/
+long long *orderLoadProfile (dfa *dfa, FILE *in) {
+
+	char *line = NULL;
+	size_t capacity = 0;
+	size_t magicLength = strlen(PROFILE_MAGIC);
+
+	if (getline(&line, &capacity, in) <= 0 ||
+			strncmp(line, PROFILE_MAGIC, magicLength) != 0 ||
+			line[magicLength] != '\t') {
+
+		free(line);
+		return NULL;
+	}
+
+	long long *visits = calloc(dfa -> table -> nrOfStates, sizeof(long long));
+	while (getline(&line, &capacity, in) > 0) {
+
+		char *tab = strrchr(line, '\t');
+
+		if (strncmp(line, "state\t", 6) != 0 || tab == line + 5) {
+
+			continue;
+		}
+		*tab = '\0';
+
+		state *state = dfaFindState(dfa, line + 6);
+		if (state != NULL) {
+
+			visits[state -> stateNr] = strtoll(tab + 1, NULL, 10);
+		}
+	}
+	free(line);
+	return visits;
+}
+
+/*
+* description: Renumbers the states of a built and compiled dfa, moving the
+* rows of its table along.
+* param[in]: dfa - The dfa, not loaded from an image.
+* param[in]: newNr - The new number of each state, the error state kept last.
+*/
+void orderApply (dfa *dfa, const int *newNr) {
+
+	dfaTable *table = dfa -> table;
+	int nrOfStates = table -> nrOfStates;
+	int nrOfClasses = table -> nrOfClasses;
+	state **allStates = malloc(sizeof(state *) * dfa -> capacity);
+
+	for (int i = 0; i < dfa -> size; i++) {
+
+		allStates[newNr[i]] = dfa -> allStates[i];
+		allStates[newNr[i]] -> stateNr = newNr[i];
+	}
+	free(dfa -> allStates);
+	dfa -> allStates = allStates;
+
+	//A compressed table is packed again, in the new order.
+	if (table -> next == NULL) {
+
+		dfaCompile(dfa);
+		return;
+	}
+
+	int *next = malloc(sizeof(int) * nrOfStates * nrOfClasses);
+	bool *acceptable = malloc(sizeof(bool) * nrOfStates);
+	dfaExit *exits = calloc(nrOfStates, sizeof(dfaExit));
+	unsigned char *outcome = malloc(nrOfStates);
+
+	for (int i = 0; i < nrOfStates; i++) {
+
+		const int *row = &table -> next[(size_t)i * nrOfClasses];
+		int *newRow = &next[(size_t)newNr[i] * nrOfClasses];
+
+		for (int c = 0; c < nrOfClasses; c++) {
+
+			newRow[c] = newNr[row[c]];
+		}
+		acceptable[newNr[i]] = table -> acceptable[i];
+		exits[newNr[i]] = table -> exits[i];
+		outcome[newNr[i]] = table -> outcome[i];
+	}
+
+	free(table -> next);
+	free(table -> acceptable);
+	free(table -> exits);
+	free(table -> outcome);
+	table -> next = next;
+	table -> acceptable = acceptable;
+	table -> exits = exits;
+	table -> outcome = outcome;
+	table -> startState = newNr[table -> startState];
+}
+
+/*
+* description: Runs a part of a string for batchStream, counting the visits.
+* The first part of a string counts the visit of the start state.
+* param[in]: profile - The training run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void orderProfileFeed (void *profile, const char *buffer, size_t length) {
+
+	orderProfile *run = profile;
+	const dfaTable *table = run -> table;
+	const unsigned char *input = (const unsigned char *)buffer;
+	int state = run -> state;
+
+	if (!run -> started) {
+
+		run -> visits[state]++;
+		run -> started = true;
+	}
+
+	//The error state is never left, and is not renumbered anyway.
+	for (size_t i = 0; i < length && state != table -> errorState; i++) {
+
+		state = dfaTableMove(table, state, table -> classes[input[i]]);
+		run -> visits[state]++;
+	}
+	run -> state = state;
+}
+
+/*
+* description: Ends a string for batchStream, starting the next one in the
+* start state. An empty string only visits the start state. Nothing is
+* written.
+* param[in]: profile - The training run.
+* param[in]: out - Not used.
+* param[out]: result - Not used.
+*/
+void orderProfileEnd (void *profile, FILE *out, batchResult *result) {
+
+	orderProfile *run = profile;
+
+	(void)out;
+	(void)result;
+	if (!run -> started) {
+
+		run -> visits[run -> state]++;
+	}
+	run -> state = run -> table -> startState;
+	run -> started = false;
+}
+
+/*
+* description: Compares two states for qsort, the most visited first and ties
+* in breadth first order.
+* param[in]: a - The first orderRank.
+* param[in]: b - The second orderRank.
+* return: Negative if a goes first, positive if b goes first.
+*/
+int orderCompareRanks (const void *a, const void *b) {
+
+	const orderRank *first = a;
+	const orderRank *second = b;
+
+	if (first -> visits != second -> visits) {
+
+		return first -> visits > second -> visits ? -1 : 1;
+	}
+	return first -> rank - second -> rank;
+}
@@ -0,0 +1,149 @@
+/*
+* order: Renumbers the states of a compiled dfa, so that states which are run
+* one after the other are close in its table. A state keeps its name and its
+* paths, only its stateNr and so its row in the table change. The numbers
+* states get when built follow the order they were inserted in, which for a
+* large dfa scatters the states of a run over the whole table, each move then
+* being a miss in the cache and often in the TLB.
+*
+* In breadth first order states are numbered in the order a search from the
+* start state finds them, over the classes in order. The states a few moves
+* from the start, where every run begins, then share the first rows, and a
+* state lies near the states it leads to.
+*
+* In hot first order the states are numbered by how often a training run
+* visited them, the most visited first, ties kept in breadth first order. The
+* states most runs spend their time in then fit in as few cache lines and
+* pages as they can. Their number is kept in the table (see dfaTable), so that
+* an image too large to be read in can still read them in up front (see
+* image.h). The visits can also be taken from a profile dump of earlier runs
+* (see profile.h).
+*
+* The error state is always kept last.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef ORDER
+#define ORDER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+#include "batch.h"
+
+/*
+* A training run of a compiled dfa, counting the visits of each state. state
+* is the current state of the run, and started tells if the visit of the
+* start state has been counted for the current string.
+*/
+typedef struct orderProfile {
+
+	const dfaTable *table;
+	int state;
+	bool started;
+	long long *visits;
+} orderProfile;
+
+/*
+* A state while sorting the states in hot first order, with its number of
+* visits and its number in breadth first order.
+*/
+typedef struct orderRank {
+
+	long long visits;
+	int rank;
+	int state;
+} orderRank;
+
+/*
+* description: Numbers the states of a compiled table in breadth first order
+* from the start state. States that cannot be reached follow in their old
+* order.
+* param[in]: table - The table.
+* return: The new number of each state, to be freed by the caller.
+*/
+int *orderBreadthFirst (const dfaTable *table);
+
+/*
+* description: Numbers the states of a compiled table by their visits, the
+* most visited first and ties in breadth first order.
+* param[in]: table - The table.
+* param[in]: visits - The number of visits of each state.
+* return: The new number of each state, to be freed by the caller.
+*/
+int *orderHotFirst (const dfaTable *table, const long long *visits);
+
+/*
+* description: Counts the states a training run visited, other than the error
+* state. Ordered hot first, these are the first states of the table.
+* param[in]: table - The table.
+* param[in]: visits - The number of visits of each state.
+* return: The number of visited states.
+*/
+int orderCountHot (const dfaTable *table, const long long *visits);
+
+/*
+* description: Counts the visits of each state while running newline
+* separated strings through a compiled table. Every string visits the start
+* state.
+* param[in]: table - The table.
+* param[in]: in - The file with the strings.
+* return: The number of visits of each state, to be freed by the caller.
+*/
+long long *orderTrain (const dfaTable *table, FILE *in);
+
+/*
+* description: Reads the visits of each state from a profile dump (see
+* profile.h), matching the states by name. States the dump does not name are
+* not visited.
+* param[in]: dfa - The built and compiled dfa.
+* param[in]: in - The file, read from its start.
+* return: The number of visits of each state, to be freed by the caller, or
+* NULL if the file is not a profile dump.
+*/
+long long *orderLoadProfile (dfa *dfa, FILE *in);
+
+/*
+* description: Renumbers the states of a built and compiled dfa, moving the
+* rows of its table along.
+* param[in]: dfa - The dfa, not loaded from an image.
+* param[in]: newNr - The new number of each state, the error state kept last.
+*/
+void orderApply (dfa *dfa, const int *newNr);
+
+/*
+* description: Runs a part of a string for batchStream, counting the visits.
+* The first part of a string counts the visit of the start state.
+* param[in]: profile - The training run.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void orderProfileFeed (void *profile, const char *buffer, size_t length);
+
+/*
+* description: Ends a string for batchStream, starting the next one in the
+* start state. An empty string only visits the start state. Nothing is
+* written.
+* param[in]: profile - The training run.
+* param[in]: out - Not used.
+* param[out]: result - Not used.
+*/
+void orderProfileEnd (void *profile, FILE *out, batchResult *result);
+
+/*
+* description: Compares two states for qsort, the most visited first and ties
+* in breadth first order.
+* param[in]: a - The first orderRank.
+* param[in]: b - The second orderRank.
+* return: Negative if a goes first, positive if b goes first.
+*/
+int orderCompareRanks (const void *a, const void *b);
+
+#endif //ORDER
@@ -0,0 +1,246 @@
+/*
+* profile: Counts what the runs of a compiled dfa do, and writes the counts as
+* a report or a dump. See profile.h.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "profile.h"
+#include "emit.h"
+
+/*
+* description: Starts counting the runs of a compiled table, from 0.
+* param[in]: table - The compiled table.
+*/
+void profileStart (dfaTable *table) {
+
+	profileCounts *profile = malloc(sizeof(profileCounts));
+
+	profile -> hits = calloc((size_t)table -> nrOfStates *
+			table -> nrOfClasses, sizeof(long long));
+	profile -> bytes = 0;
+	profile -> stops = 0;
+	profile -> unread = 0;
+	profileKill(table -> profile);
+	table -> profile = profile;
+}
+
+/*
+* description: Counts the bytes a run skips in an accelerated state, each as
+* the move it stands for, if the table is profiled.
+* param[in]: table - The compiled table.
+* param[in]: state - The accelerated state (stateNr).
+* param[in]: input - The skipped bytes.
+* param[in]: length - Number of skipped bytes.
+*/
+void profileSkip (const dfaTable *table, int state,
+		const unsigned char *input, size_t length) {
+
+	for (size_t i = 0; i < length; i++) {
+
+		profileMove(table, state, table -> classes[input[i]]);
+	}
+}
+
+/*
+* description: Finds the visits of each state of a profiled table.
+* param[in]: table - The profiled table.
+* return: The visits of each state, to be freed by the caller.
+*/
+long long *profileVisits (const dfaTable *table) {
+
+	long long *visits = calloc(table -> nrOfStates, sizeof(long long));
+	const long long *hits = table -> profile -> hits;
+
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		for (int c = 0; c < table -> nrOfClasses; c++) {
+
+			visits[i] += hits[(size_t)i * table -> nrOfClasses + c];
+		}
+	}
+	return visits;
+}
+
+/*
+* description: Writes a report of the counts of a profiled dfa, with the most
+* visited states.
+* param[in]: dfa - The profiled dfa.
+* param[in]: fp - The file to write to.
+*/
+void profileReport (const dfa *dfa, FILE *fp) {
+
+	const dfaTable *table = dfa -> table;
+	const profileCounts *profile = table -> profile;
+	long long *visits = profileVisits(table);
+	profileRank *ranks = malloc(sizeof(profileRank) * table -> nrOfStates);
+	int nrOfVisited = 0;
+
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (visits[i] > 0) {
+
+			ranks[nrOfVisited].visits = visits[i];
+			ranks[nrOfVisited].state = i;
+			nrOfVisited++;
+		}
+	}
+	qsort(ranks, nrOfVisited, sizeof(profileRank), profileCompareRanks);
+
+	fprintf(fp, "profile: %lld bytes run in %d of %d states, %lld early "
+			"exits leaving %lld bytes unread\n", profile -> bytes,
+			nrOfVisited, table -> nrOfStates, profile -> stops,
+			profile -> unread);
+	for (int i = 0; i < nrOfVisited && i < PROFILE_REPORT_STATES; i++) {
+
+		fprintf(fp, "%12lld %5.1f%% ", ranks[i].visits,
+				100.0 * ranks[i].visits / profile -> bytes);
+		profileWriteName(dfa, ranks[i].state, fp);
+		fprintf(fp, "\n");
+	}
+	free(ranks);
+	free(visits);
+}
+
+/*
+* description: Writes a dump of the counts of a profiled dfa.
+* param[in]: dfa - The profiled dfa.
+* param[in]: fileName - The file to write to.
+* return: 1 if the dump was written, else 0.
+*/
+int profileDump (const dfa *dfa, const char *fileName) {
+
+	const dfaTable *table = dfa -> table;
+	const profileCounts *profile = table -> profile;
+	FILE *fp = fopen(fileName, "w");
+
+	if (fp == NULL) {
+
+		fprintf(stderr, "Could not write profile '%s'\n", fileName);
+		return 0;
+	}
+
+	long long *visits = profileVisits(table);
+	fprintf(fp, "%s\t%d\n", PROFILE_MAGIC, PROFILE_VERSION);
+	fprintf(fp, "bytes\t%lld\nstops\t%lld\nunread\t%lld\n", profile -> bytes,
+			profile -> stops, profile -> unread);
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		if (visits[i] > 0) {
+
+			fprintf(fp, "state\t");
+			profileWriteName(dfa, i, fp);
+			fprintf(fp, "\t%lld\n", visits[i]);
+		}
+	}
+
+	int room[DFA_MAX_CLASSES];
+	for (int i = 0; i < table -> nrOfStates; i++) {
+
+		const long long *hits = &profile -> hits[(size_t)i *
+				table -> nrOfClasses];
+		const int *row = visits[i] > 0 ? dfaTableRow(table, i, room) : NULL;
+
+		for (int c = 0; row != NULL && c < table -> nrOfClasses; c++) {
+
+			if (hits[c] > 0) {
+
+				fprintf(fp, "move\t");
+				profileWriteName(dfa, i, fp);
+				fprintf(fp, "\t");
+				profileWriteKeys(table, c, fp);
+				fprintf(fp, "\t");
+				profileWriteName(dfa, row[c], fp);
+				fprintf(fp, "\t%lld\n", hits[c]);
+			}
+		}
+	}
+	free(visits);
+
+	if (fclose(fp) != 0) {
+
+		fprintf(stderr, "Could not write profile '%s'\n", fileName);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+* description: Writes the name of a state, or its stateNr after a '#' if it
+* has none.
+* param[in]: dfa - The dfa.
+* param[in]: state - The state (stateNr).
+* param[in]: fp - The file to write to.
+*/
+void profileWriteName (const dfa *dfa, int state, FILE *fp) {
+
+	const char *name = emitStateName(dfa, state);
+
+	if (name != NULL) {
+
+		fprintf(fp, "%s", name);
+	} else {
+
+		fprintf(fp, "#%d", state);
+	}
+}
+
+/*
+* description: Writes the bytes of a class, escaping those that are not
+* printable.
+* param[in]: table - The compiled table.
+* param[in]: class - The class.
+* param[in]: fp - The file to write to.
+*/
+void profileWriteKeys (const dfaTable *table, int class, FILE *fp) {
+
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		if (table -> classes[i] != class) {
+
+			continue;
+		}
+		if (i > ' ' && i < 127 && i != '\\') {
+
+			fputc(i, fp);
+		} else {
+
+			fprintf(fp, "\\x%02x", i);
+		}
+	}
+}
+
+/*
+* description: Compares two states for qsort, the most visited first.
+* param[in]: a - The first profileRank.
+* param[in]: b - The second profileRank.
+* return: Negative if a goes first, positive if b goes first.
+*/
+int profileCompareRanks (const void *a, const void *b) {
+
+	const profileRank *first = a;
+	const profileRank *second = b;
+
+	if (first -> visits != second -> visits) {
+
+		return first -> visits > second -> visits ? -1 : 1;
+	}
+	return first -> state - second -> state;
+}
+
+/*
+* description: Frees the counts of a profiled table.
+* param[in]: profile - The counts.
+*/
+void profileKill (profileCounts *profile) {
+
+	if (profile != NULL) {
+
+		free(profile -> hits);
+		free(profile);
+	}
+}
@@ -0,0 +1,181 @@
+/*
+* profile: Counts what the runs of a compiled dfa do, to find the states worth
+* optimizing. Only built with DFA_PROFILE defined (see makerundfaprofile in
+* the makefile), without it the runs hold no trace of the counting at all.
+*
+* Once profileStart is called for a table, every move its runs take is
+* counted, as a hit of the transition from a state on a class. A byte skipped
+* in an accelerated state (see dfaExit) is counted as the move it stands for.
+* The visits of a state are the hits of its row, that is the number of bytes
+* run while in it, so the most visited states are those whose rows are read
+* the most. A run that stops because its outcome is decided (see dfaTable)
+* counts as an early exit, and the bytes it leaves unread are counted too.
+* The counts are exact also when several threads share the table.
+*
+* The counts are kept by the runs of dfaTableRun and by scan. In a profiled
+* build the runs that would not go through either, batch lanes and the
+* speculative runs of speculate, do. multi and the lazy and shift engines are
+* not profiled.
+*
+* A profile is written as a report of the hottest states, and as a dump of
+* tab separated lines, keyed by the names of the states:
+* - PROFILE_MAGIC, the version.
+* - bytes, stops and unread, with the totals.
+* - state, the name and the visits of each visited state.
+* - move, the name of the state, the bytes of the class, the name of the state
+*   moved to and the hits of each transition taken.
+* A state without a name is named by its stateNr after a '#'. Bytes other than
+* printable chars are written as \xHH, and so are space and backslash. The
+* visits of a dump can order the states of a dfa hot first (see order.h).
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef PROFILE
+#define PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dfa.h"
+
+#define PROFILE_MAGIC "dfaprofile"
+#define PROFILE_VERSION 1
+#define PROFILE_REPORT_STATES 10
+
+/*
+* The counts of the runs of a table. hits holds a count for every transition,
+* at [state * nrOfClasses + class] like the rows of a dense table.
+*/
+typedef struct profileCounts {
+
+	long long *hits;
+	long long bytes;
+	long long stops;
+	long long unread;
+} profileCounts;
+
+/*
+* A state while sorting the states by their visits for the report.
+*/
+typedef struct profileRank {
+
+	long long visits;
+	int state;
+} profileRank;
+
+#ifdef DFA_PROFILE
+
+/*
+* description: Counts a move of a run, if the table is profiled.
+* param[in]: table - The compiled table.
+* param[in]: state - The state (stateNr) moved from.
+* param[in]: class - The class moved on.
+*/
+static inline void profileMove (const dfaTable *table, int state, int class) {
+
+	profileCounts *profile = table -> profile;
+
+	if (profile != NULL) {
+
+		__atomic_fetch_add(&profile -> hits[(size_t)state *
+				table -> nrOfClasses + class], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&profile -> bytes, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+* description: Counts a run that stops early, if the table is profiled.
+* param[in]: table - The compiled table.
+* param[in]: unread - Number of bytes the run leaves unread.
+*/
+static inline void profileStop (const dfaTable *table, size_t unread) {
+
+	profileCounts *profile = table -> profile;
+
+	if (profile != NULL) {
+
+		__atomic_fetch_add(&profile -> stops, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&profile -> unread, unread, __ATOMIC_RELAXED);
+	}
+}
+
+#endif
+
+/*
+* description: Starts counting the runs of a compiled table, from 0.
+* param[in]: table - The compiled table.
+*/
+void profileStart (dfaTable *table);
+
+/*
+* description: Counts the bytes a run skips in an accelerated state, each as
+* the move it stands for, if the table is profiled.
+* param[in]: table - The compiled table.
+* param[in]: state - The accelerated state (stateNr).
+* param[in]: input - The skipped bytes.
+* param[in]: length - Number of skipped bytes.
+*/
+void profileSkip (const dfaTable *table, int state,
+		const unsigned char *input, size_t length);
+
+/*
+* description: Finds the visits of each state of a profiled table.
+* param[in]: table - The profiled table.
+* return: The visits of each state, to be freed by the caller.
+*/
+long long *profileVisits (const dfaTable *table);
+
+/*
+* description: Writes a report of the counts of a profiled dfa, with the most
+* visited states.
+* param[in]: dfa - The profiled dfa.
+* param[in]: fp - The file to write to.
+*/
+void profileReport (const dfa *dfa, FILE *fp);
+
+/*
+* description: Writes a dump of the counts of a profiled dfa.
+* param[in]: dfa - The profiled dfa.
+* param[in]: fileName - The file to write to.
+* return: 1 if the dump was written, else 0.
+*/
+int profileDump (const dfa *dfa, const char *fileName);
+
+/*
+* description: Writes the name of a state, or its stateNr after a '#' if it
+* has none.
+* param[in]: dfa - The dfa.
+* param[in]: state - The state (stateNr).
+* param[in]: fp - The file to write to.
+*/
+void profileWriteName (const dfa *dfa, int state, FILE *fp);
+
+/*
+* description: Writes the bytes of a class, escaping those that are not
+* printable.
+* param[in]: table - The compiled table.
+* param[in]: class - The class.
+* param[in]: fp - The file to write to.
+*/
+void profileWriteKeys (const dfaTable *table, int class, FILE *fp);
+
+/*
+* description: Compares two states for qsort, the most visited first.
+* param[in]: a - The first profileRank.
+* param[in]: b - The second profileRank.
+* return: Negative if a goes first, positive if b goes first.
+*/
+int profileCompareRanks (const void *a, const void *b);
+
+/*
+* description: Frees the counts of a profiled table.
+* param[in]: profile - The counts.
+*/
+void profileKill (profileCounts *profile);
+
+#endif //PROFILE
@@ -17,12 +17,108 @@
 * in between). Each row will represent a state (the former) and a key to a path
 * in it which will lead to another state (the latter).
 *
+* The specification is mapped into memory and parsed in place, the rows from
+* row 4 by one thread per core (see spec.h). The rows end at the first empty
+* row or at the end of the file.
+*
+* Once built, the DFA is minimized before it is run. Equivalent states are
+* merged and the number of states before and after is written to stderr.
+*
+* With --compile the minimized DFA is instead written to a binary image (see
+* image.h) given by -o. An image can be given instead of a specification, it
+* is then mapped into memory and run without being parsed. With --verify the
+* checksum of a loaded image is checked before it is run. Every move of an
+* image is checked to lead to one of its states when it is loaded, unless
+* --trusted is given, which spares reading the whole table of an image too
+* large to be read in.
+*
+* With --emit-c the minimized DFA is instead written as C source (see emit.h)
+* to the file given by -o, or to stdout. --name sets the prefix of the names in
+* the generated code.
+*
+* With --regex a pattern is given instead of a specification. The pattern is
+* compiled into a DFA (see nfa.h), and --icase makes it ignore the case of
+* letters. The DFA accepts the strings the whole pattern matches.
+*
+* With --regex and --batch, --engine picks how the pattern is run. dfa compiles
+* it as above, lazy builds the DFA while running (see lazy.h) in a cache of at
+* most the bytes given by --cache, and shift runs patterns of at most 64
+* positions as a bit-parallel NFA (see shift.h). The default, auto, compiles
+* the DFA unless it gets too large, and then runs the pattern as shift, or as
+* lazy if it has too many positions. --lazy is short for --engine lazy.
+*
+* With --scan the given file is searched for strings accepted by the DFA, and
+* the start and end offset of every match is written to stdout (see scan.h).
+* Matches end at the first accepting state, or with --longest at the last one.
+*
+* With --whole the given file is run through the DFA as one single string and
+* the program tells if it is accepted. With --threads the file is split over
+* several threads (see speculate.h).
+*
 * To test if strings are valid in the built DFA, simply enter the string in the
-* terminal. Only alphabetical and numerical keys are valid. Anything else, like
-* a '?', will quit the program.
+* terminal. The keys of the paths in the DFA make up its alphabet. A '?' that
+* is not in the alphabet will quit the program.
+*
+* With --batch the program runs without prompts. Newline separated strings are
+* read from the given file, or from stdin if no file is given, and one line
+* with 'A' (accepted) or 'R' (rejected) is written per string to stdout. A
+* summary of the counts is written to stderr. With --threads the strings are
+* classified by several threads, 0 meaning one thread per core.
+*
+* With --batch, several specifications (or images) may be given. The strings
+* are then run through all of the DFAs in one pass (see multi.h), and the line
+* written per string is a bitmask in hex of the DFAs that accept it, bit i for
+* the i:th specification. The count of each DFA is added to the summary.
+* --cache then bounds the bytes the product of the DFAs may cache.
+*
+* A DFA whose dense table would take more bytes than --table-budget gets a
+* compressed table instead (see comb.h), which is slower to run but only
+* keeps the paths the states have. Such a DFA is not minimized, as that takes
+* as much memory as its dense table would.
+*
+* Once minimized, the states of the DFA are renumbered for locality in its
+* table (see order.h), in the order given by --order. bfs, the default,
+* numbers them breadth first from the start state, hot numbers them by how
+* often the strings of the file given by --train visit them, and none keeps
+* the order they were built in. An image keeps the order it was compiled
+* with.
+*
+* An image whose table would take more bytes than --table-budget is expected
+* not to fit in memory, and only the pages the DFA runs through are read in
+* (see image.h). Ordered hot, the rows of the states the training strings
+* visited are read in first, as many as fit in --table-budget. The file given
+* by --train may also be a profile dump, whose visits are then used as is.
+*
+* Built with DFA_PROFILE (make makerundfaprofile), --profile counts what the
+* runs of the DFA do (see profile.h). A report of the most visited states is
+* written to stderr, and a dump of the counts to the given file.
 *
 * param[in]: argv[0] - ./[exacutable program name]
 * param[in]: argv[1] - filename of the file with the specification for the dfa.
+* param[in]: argv[2 - n] - Optional, more specifications to run with --batch.
+* param[in]: --batch [file] - Optional, classify strings from file or stdin.
+* param[in]: --threads n - Optional, number of threads for --batch.
+* param[in]: --compile - Optional, write the DFA as an image instead.
+* param[in]: -o file - The image to write with --compile.
+* param[in]: --verify - Optional, check the checksum of a loaded image.
+* param[in]: --trusted - Optional, do not check the moves of a loaded image.
+* param[in]: --emit-c - Optional, write the DFA as C source instead.
+* param[in]: --name name - Optional, prefix of the names in the C source.
+* param[in]: --scan file - Optional, search the file for matches.
+* param[in]: --longest - Optional, longest instead of earliest matches.
+* param[in]: --whole file - Optional, run the whole file as one string.
+* param[in]: --regex pattern - Optional, build the DFA from a pattern instead.
+* param[in]: --icase - Optional, ignore the case of letters in the pattern.
+* param[in]: --engine name - Optional, auto, dfa, lazy or shift for --regex.
+* param[in]: --lazy - Optional, build the DFA of the pattern while running.
+* param[in]: --cache bytes - Optional, the cache size for --lazy or several
+* specifications.
+* param[in]: --order name - Optional, none, bfs or hot, the order of the states.
+* param[in]: --train file - The strings to count visits on with --order hot,
+* or a profile dump.
+* param[in]: --table-budget bytes - Optional, most bytes of a dense table, or
+* of the table of an image before only its run pages are read in.
+* param[in]: --profile file - Optional, count the runs and dump the counts.
 *
 * Authors:
 * Buster Hultgren Warn <dv17bhn@cs.umu.se>
@@ -39,52 +135,442 @@
 */
 int main(int argc, const char *argv[]){
 
-    if (fileValidation(argc, argv) == 0) {
+    options options;
+    if (parseOptions(argc, argv, &options) == 0 ||
+            fileValidation(&options) == 0) {
+
+        fprintf(stderr, " - quitting program\n");
+        return 0;
+    }
+
+    if (options.engine != RUNDFA_ENGINE_DFA) {
+
+        return runPattern(&options);
+    }
+    if (options.nrOfSpecs > 1) {
+
+        return runMulti(&options);
+    }
+
+    if (options.compile) {
+
+        dfa* dfa = buildMinimalDfa(&options);
+        if (dfa == NULL) {
+
+            fprintf(stderr, " - quitting program\n");
+            return 0;
+        }
+        int written = imageWrite(dfa, options.outputFile);
+        dfaKill(dfa);
+        return written;
+    }
+
+    dfa* dfa = loadDfa(&options);
+    if (dfa == NULL) {
 
         fprintf(stderr, " - quitting program\n");
         return 0;
     }
 
-    dfa* dfa = buildDfa(argv);
+    if (options.emitC) {
+
+        int written = emitC(dfa, options.outputFile, options.emitName);
+        dfaKill(dfa);
+        return written;
+    }
+
+#ifdef DFA_PROFILE
+    if (options.profileFile != NULL) {
+
+        profileStart(dfa -> table);
+    }
+#endif
+    if (options.wholeFile != NULL) {
+
+        runWhole(dfa, &options);
+    } else if (options.scanFile != NULL) {
+
+        runScan(dfa, &options);
+    } else if (options.batch) {
 
-    runDfa(dfa);
+        runBatch(dfa, &options);
+    } else {
+
+        runDfa(dfa);
+    }
+#ifdef DFA_PROFILE
+    if (options.profileFile != NULL) {
+
+        profileReport(dfa, stderr);
+        profileDump(dfa, options.profileFile);
+    }
+#endif
     dfaKill(dfa);
     return 1;
 }
 
 /*
-* description: Creates and builds the dfa by using data from textfile (argv[1])
-* and applying it to the dfa datatype. It calculates number of states, sets up
-* the difffrent states, there path and if they are accaptable or not.
-* param[in]: argv[] - Starting parameter with the name of the textfile with the
-* dfa state.
-* returns: The complete dfa.
+* description: Parses the program arguments into options.
+* param[in]: argc - number of parameters.
+* param[in]: argv - Parameters strings.
+* param[out]: options - The parsed options.
+* returns: 1 if arguments are valid, else 0.
+*/
+int parseOptions (int argc, const char *argv[], options *options) {
+
+    options -> specFile = NULL;
+    options -> nrOfSpecs = 0;
+    options -> batch = false;
+    options -> batchFile = NULL;
+    options -> threads = 1;
+    options -> compile = false;
+    options -> outputFile = NULL;
+    options -> verify = false;
+    options -> trusted = false;
+    options -> emitC = false;
+    options -> emitName = EMIT_DEFAULT_NAME;
+    options -> scanFile = NULL;
+    options -> longest = false;
+    options -> wholeFile = NULL;
+    options -> regex = NULL;
+    options -> icase = false;
+    options -> engine = RUNDFA_ENGINE_AUTO;
+    options -> cacheSize = LAZY_DEFAULT_BUDGET;
+    options -> order = RUNDFA_ORDER_BFS;
+    options -> trainFile = NULL;
+    options -> tableBudget = DFA_TABLE_BUDGET;
+    options -> profileFile = NULL;
+
+    for (int i = 1; i < argc; i++) {
+
+        if (strcmp(argv[i], "--batch") == 0) {
+
+            options -> batch = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0 &&
+                    (options -> specFile != NULL || options -> regex != NULL)) {
+
+                options -> batchFile = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+
+            options -> threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--compile") == 0) {
+
+            options -> compile = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+
+            options -> outputFile = argv[++i];
+        } else if (strcmp(argv[i], "--verify") == 0) {
+
+            options -> verify = true;
+        } else if (strcmp(argv[i], "--trusted") == 0) {
+
+            options -> trusted = true;
+        } else if (strcmp(argv[i], "--emit-c") == 0) {
+
+            options -> emitC = true;
+        } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+
+            options -> emitName = argv[++i];
+        } else if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) {
+
+            options -> scanFile = argv[++i];
+        } else if (strcmp(argv[i], "--whole") == 0 && i + 1 < argc) {
+
+            options -> wholeFile = argv[++i];
+        } else if (strcmp(argv[i], "--regex") == 0 && i + 1 < argc) {
+
+            options -> regex = argv[++i];
+        } else if (strcmp(argv[i], "--icase") == 0) {
+
+            options -> icase = true;
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+
+            options -> engine = engineByName(argv[++i]);
+            if (options -> engine < 0) {
+
+                fprintf(stderr, "Unknown engine '%s'", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--lazy") == 0) {
+
+            options -> engine = RUNDFA_ENGINE_LAZY;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+
+            options -> cacheSize = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc) {
+
+            options -> order = orderByName(argv[++i]);
+            if (options -> order < 0) {
+
+                fprintf(stderr, "Unknown order '%s'", argv[i]);
+                return 0;
+            }
+        } else if (strcmp(argv[i], "--train") == 0 && i + 1 < argc) {
+
+            options -> trainFile = argv[++i];
+        } else if (strcmp(argv[i], "--table-budget") == 0 && i + 1 < argc) {
+
+            options -> tableBudget = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+
+            options -> profileFile = argv[++i];
+        } else if (strcmp(argv[i], "--longest") == 0) {
+
+            options -> longest = true;
+        } else if (strcmp(argv[i], "--earliest") == 0) {
+
+            options -> longest = false;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+
+            fprintf(stderr, "Unknown option '%s'", argv[i]);
+            return 0;
+        } else if (options -> nrOfSpecs < MULTI_MAX_DFAS) {
+
+            options -> specFiles[options -> nrOfSpecs++] = argv[i];
+            options -> specFile = options -> specFiles[0];
+        } else {
+
+            fprintf(stderr, "To many/few argument");
+            return 0;
+        }
+    }
+
+    if ((options -> specFile == NULL) == (options -> regex == NULL)) {
+
+        fprintf(stderr, "To many/few argument");
+        return 0;
+    }
+    if (options -> nrOfSpecs > 1 && (!options -> batch ||
+            options -> regex != NULL || options -> compile ||
+            options -> emitC || options -> scanFile != NULL ||
+            options -> wholeFile != NULL)) {
+
+        fprintf(stderr, "Several specifications can only be run with --batch");
+        return 0;
+    }
+    if (options -> compile && options -> outputFile == NULL) {
+
+        fprintf(stderr, "--compile needs an image to write with -o");
+        return 0;
+    }
+    if (options -> order == RUNDFA_ORDER_HOT && options -> trainFile == NULL) {
+
+        fprintf(stderr, "--order hot needs strings to train on with --train");
+        return 0;
+    }
+#ifndef DFA_PROFILE
+    if (options -> profileFile != NULL) {
+
+        fprintf(stderr, "--profile needs rundfa built with DFA_PROFILE");
+        return 0;
+    }
+#endif
+    if (options -> profileFile != NULL && (options -> compile ||
+            options -> emitC || options -> nrOfSpecs > 1)) {
+
+        fprintf(stderr, "--profile needs a DFA to run");
+        return 0;
+    }
+
+    //Only classifying a batch of strings can be done without a DFA.
+    bool batchOnly = options -> regex != NULL && options -> batch &&
+            !options -> compile && !options -> emitC &&
+            options -> scanFile == NULL && options -> wholeFile == NULL &&
+            options -> profileFile == NULL;
+    if (options -> engine == RUNDFA_ENGINE_AUTO && !batchOnly) {
+
+        options -> engine = RUNDFA_ENGINE_DFA;
+    }
+    if (options -> engine != RUNDFA_ENGINE_DFA && !batchOnly) {
+
+        fprintf(stderr, "--engine needs --regex and --batch");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+* description: Finds the engine with a name.
+* param[in]: name - The name, auto, dfa, lazy or shift.
+* returns: The engine, -1 if there is none with the name.
 */
-dfa *buildDfa (const char *argv[]) {
+int engineByName (const char *name) {
 
-    dfa *dfa = dfaEmpty();
-    FILE *fp = fopen(argv[1], "r");
+    const char *names[] = {"auto", "dfa", "lazy", "shift"};
 
-    char *startState = readLine(fp);
-    char *acceptable = readLine(fp);
-    char *other = readLine(fp);
+    for (int i = 0; i < RUNDFA_ENGINES; i++) {
 
-    int allStates = countStates(acceptable);
-    allStates += countStates(other);
+        if (strcmp(name, names[i]) == 0) {
 
-    dfaSetStates(dfa, allStates);
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+* description: Finds the order of the states with a name.
+* param[in]: name - The name, none, bfs or hot.
+* returns: The order, -1 if there is none with the name.
+*/
+int orderByName (const char *name) {
 
-    setStates(dfa, acceptable, 1);
-    setStates(dfa, other, 0);
-    setStates(dfa, startState, 2);
+    const char *names[] = {"none", "bfs", "hot"};
 
-    free(startState);
-    free(acceptable);
-    free(other);
+    for (int i = 0; i < RUNDFA_ORDERS; i++) {
 
-    setPaths(dfa, fp);
-    fclose(fp);
-	return dfa;
+        if (strcmp(name, names[i]) == 0) {
+
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+* description: Creates and builds the dfa by using data from a textfile and
+* applying it to the dfa datatype. The file is mapped into memory and its
+* paths are parsed by one thread per core, see spec.h.
+* param[in]: fileName - The name of the textfile with the dfa specification.
+* returns: The complete dfa, NULL if the file could not be read.
+*/
+dfa *buildDfa (const char *fileName) {
+
+    return specLoad(fileName, 0);
+}
+
+/*
+* description: Loads the DFA, from an image if the specification file is one,
+* else by building and minimizing it.
+* param[in]: options - The parsed options.
+* returns: The compiled dfa, NULL if it could not be loaded.
+*/
+dfa *loadDfa (const options *options) {
+
+    if (options -> regex != NULL || !imageIsImage(options -> specFile)) {
+
+        return buildMinimalDfa(options);
+    }
+
+    dfa *dfa = imageLoad(options -> specFile, options -> trusted);
+    if (dfa != NULL && options -> verify && !imageVerify(dfa)) {
+
+        fprintf(stderr, "Checksum of '%s' does not match", options -> specFile);
+        dfaKill(dfa);
+        dfa = NULL;
+    }
+
+    //A table over the budget is only read in where it is run.
+    if (dfa != NULL && (size_t)dfa -> table -> nrOfStates *
+            dfa -> table -> nrOfClasses * sizeof(int) >
+            options -> tableBudget) {
+
+        fprintf(stderr, "Paging the table of %d states from '%s'\n",
+                dfa -> table -> nrOfStates, options -> specFile);
+        imagePage(dfa, options -> tableBudget);
+    }
+    return dfa;
+}
+
+/*
+* description: Builds the DFA from the specification file or the pattern, and
+* minimizes it.
+* param[in]: options - The parsed options.
+* returns: The minimized and compiled dfa, NULL if the specification cannot be
+* read or the pattern is invalid.
+*/
+dfa *buildMinimalDfa (const options *options) {
+
+    dfa *dfa;
+
+    if (options -> regex == NULL) {
+
+        dfa = buildDfa(options -> specFile);
+    } else {
+
+        dfa = nfaBuildDfa(options -> regex, options -> icase ? NFA_ICASE : 0);
+    }
+    if (dfa == NULL) {
+
+        return NULL;
+    }
+    dfa -> tableBudget = options -> tableBudget;
+    return orderDfa(minimizeDfa(dfa), options);
+}
+
+/*
+* description: Minimizes the dfa and reports the number of states before and
+* after on stderr. A dfa compiled into a compressed table is not minimized,
+* the size of the table is reported instead.
+* param[in]: dfa - The built dfa, which is freed if minimized.
+* returns: The minimized and compiled dfa.
+*/
+dfa *minimizeDfa (dfa *dfa) {
+
+    struct dfa *minimal;
+
+    if (dfa -> table == NULL) {
+
+        dfaCompile(dfa);
+    }
+
+    //Minimizing needs room for every move, as much as a dense table does.
+    if (dfa -> table -> comb != NULL) {
+
+        fprintf(stderr, "Compressed the table of %d states to %zu bytes, "
+                "not minimized\n", dfa -> size, combSize(dfa -> table -> comb));
+        return dfa;
+    }
+
+    minimal = dfaMinimize(dfa);
+    if (minimal == NULL) {
+
+        return dfa;
+    }
+    fprintf(stderr, "Minimized DFA from %d to %d states\n", dfa -> size,
+            minimal -> size);
+    dfaKill(dfa);
+    return minimal;
+}
+
+/*
+* description: Renumbers the states of the dfa in the order given by the
+* options.
+* param[in]: dfa - The built and compiled dfa.
+* param[in]: options - The parsed options.
+* returns: The dfa.
+*/
+dfa *orderDfa (dfa *dfa, const options *options) {
+
+    int *newNr;
+    int nrOfHotStates = 0;
+
+    if (options -> order == RUNDFA_ORDER_NONE) {
+
+        return dfa;
+    }
+    if (options -> order == RUNDFA_ORDER_HOT) {
+
+        FILE *in = fopen(options -> trainFile, "r");
+        long long *visits = orderLoadProfile(dfa, in);
+        if (visits == NULL) {
+
+            rewind(in);
+            visits = orderTrain(dfa -> table, in);
+        }
+        fclose(in);
+        newNr = orderHotFirst(dfa -> table, visits);
+        nrOfHotStates = orderCountHot(dfa -> table, visits);
+        free(visits);
+    } else {
+
+        newNr = orderBreadthFirst(dfa -> table);
+    }
+    orderApply(dfa, newNr);
+    dfa -> table -> nrOfHotStates = nrOfHotStates;
+    free(newNr);
+    return dfa;
 }
 
 /*
@@ -123,240 +609,279 @@ int getNextInt (char *line, int *i) {
 }
 
 /*
-* description: Find the next word (if any) in an array of chars and returns it.
-* param[in]: line - A pointer to an array where the next word (if any) is to
-* be found.
-* param[in]: i - The index where the function should start looking in the
-* array.
-* return: If found; the word, else NULL.
+* description: Validates that the files given in the options can be read.
+* param[in]: options - The parsed options.
+* returns: 1 if files are valid, else 0.
 */
-char* getNextWord (char *line, int *i) {
-
-    int wordFound = 0;
-    int startOfWord = 0;
-    char *word = NULL;
-
-    if (line[*i] == '\0') {
-      wordFound = -1;
-    }
+int fileValidation (const options *options) {
 
-    while (wordFound >= 0) {
+    FILE *fp;
 
-		if (line[*i] == '\0') {
+    for (int i = 0; i < options -> nrOfSpecs; i++) {
 
-			wordFound = -1;
-		}
-		if (wordFound == 0) {
+        fp = fopen(options -> specFiles[i], "r");
+        if (fp == NULL) {
 
-			if (line[*i] >= 33 && line[*i] <= 126) {
+            fprintf(stderr, "Cannot read '%s'", options -> specFiles[i]);
+            return 0;
+        }
+        fclose(fp);
+    }
 
-			wordFound = 1;
-			startOfWord = *i;
-			}
-    	} else {
+    if (options -> batchFile != NULL) {
 
-			if (line[*i] < 33 || line[*i] > 126) {
+        fp = fopen(options -> batchFile, "r");
+        if (fp == NULL) {
 
-				wordFound = -1;
-				word = malloc(sizeof(char) * (*i - startOfWord + 1));
-				strncpy(word, &line[startOfWord], *i - startOfWord + 1);
-				word[*i - startOfWord] = '\0';
-				if (line[*i] == '\0') {
+            fprintf(stderr, "Cannot read '%s'", options -> batchFile);
+            return 0;
+        }
+        fclose(fp);
+    }
 
-					(*i)--;
-				}
-			}
-		}
+    if (options -> trainFile != NULL) {
 
-		(*i)++;
-	}
+        fp = fopen(options -> trainFile, "r");
+        if (fp == NULL) {
 
-    return word;
+            fprintf(stderr, "Cannot read '%s'", options -> trainFile);
+            return 0;
+        }
+        fclose(fp);
+    }
+    return 1;
 }
 
 /*
-* description: Reads a line from a file and saves it as an array of chars with
-* dynamically allocated memory.
-* param[in]: fp - A file pointer.
-* returns: A pointer to the allocated memory for the char array.
+* description: Classifies strings from the batch file (or stdin) without
+* prompts and prints a summary.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
 */
-char *readLine (FILE *fp) {
+void runBatch (const dfa *dfa, const options *options) {
 
-    int length = 0;
-    int buffer = 100;
-    char *line = malloc(sizeof(char) * buffer);
-    char currChar = fgetc(fp);
+    FILE *in = stdin;
+    batchResult result;
 
-    while (currChar != '\n' && currChar >= 0) {
+    if (options -> batchFile != NULL) {
 
-  		//If a carriage return is read, skip it.
-  		if (currChar == '\r') {
-
-  			currChar = fgetc(fp);
-  		} else {
+        in = fopen(options -> batchFile, "r");
+    }
+    setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER_SIZE);
 
-  			if (length >= buffer - 2) {
+    if (options -> threads == 1) {
 
-  	            buffer = buffer * 2;
-  	            line = realloc(line, sizeof(char) * buffer);
-  	        }
-  	        line[length] = currChar;
+        batchRun(dfa, in, stdout, &result);
+    } else {
 
-  	        length++;
-  	        currChar = fgetc(fp);
-  		}
+        batchRunParallel(dfa, in, stdout, options -> threads, &result);
     }
+    fflush(stdout);
+    batchPrintSummary(&result, stderr);
 
-	if (length > 0) {
-
-		line[length] = '\0';
-		line = realloc(line, sizeof(char) * length + 1);
-	} else {
-
-		free(line);
-		line = NULL;
-	}
+    if (in != stdin) {
 
-    return line;
+        fclose(in);
+    }
 }
 
 /*
-* description: Counts the number of states found in an array of chars. Each
-* word consisting of ascii chars including 33 to 126 counts as a state.
-* param[in]: line - A pointer to the char array.
-* returns: The number of states found.
+* description: Classifies strings from the batch file (or stdin) with the
+* pattern, on the engine chosen by the options, and prints a summary.
+* param[in]: options - The parsed options.
+* returns: 1 if the pattern is valid, else 0.
 */
-int countStates (char *line) {
-
-	int wordFound = 0;
-    int states = 0;
-    int i = 0;
-
-    while (line[i] != '\0') {
+int runPattern (const options *options) {
+
+    arena *arena = arenaEmpty();
+    nfaNode *root = nfaParse(options -> regex,
+            options -> icase ? NFA_ICASE : 0, arena);
+    int engine = options -> engine;
+    int positions = root != NULL ? shiftPositions(root) : 0;
+    nfa *nfa = NULL;
+    dfa *dfa = NULL;
+
+    if (root != NULL && engine == RUNDFA_ENGINE_SHIFT &&
+            positions > SHIFT_MAX_POSITIONS) {
+
+        fprintf(stderr, "Pattern has more than %d positions",
+                SHIFT_MAX_POSITIONS);
+        root = NULL;
+    }
+    if (root != NULL && engine != RUNDFA_ENGINE_SHIFT) {
 
-        if (wordFound == 0) {
+        nfa = nfaFromTree(root);
+        root = nfa != NULL ? root : NULL;
+    }
+    if (root == NULL) {
 
-			if (line[i] >= 33 && line[i] <= 126) {
+        arenaKill(arena);
+        fprintf(stderr, " - quitting program\n");
+        return 0;
+    }
 
-				wordFound = 1;
-				states++;
-			}
-		} else {
+    //A small pattern is not worth many states, it runs fast enough as shift.
+    if (engine == RUNDFA_ENGINE_AUTO) {
 
-			if (line[i] < 33 || line[i] > 126) {
+        dfa = nfaDeterminize(nfa, positions <= SHIFT_MAX_POSITIONS ?
+                RUNDFA_AUTO_STATES : NFA_MAX_SUBSETS);
+        engine = dfa != NULL ? RUNDFA_ENGINE_DFA :
+                positions <= SHIFT_MAX_POSITIONS ? RUNDFA_ENGINE_SHIFT :
+                RUNDFA_ENGINE_LAZY;
+    }
 
-				wordFound = 0;
-			}
-		}
-		i++;
+    if (engine == RUNDFA_ENGINE_DFA) {
+
+        dfa -> tableBudget = options -> tableBudget;
+        dfa = orderDfa(minimizeDfa(dfa), options);
+        runBatch(dfa, options);
+        dfaKill(dfa);
+        nfaKill(nfa);
+    } else if (engine == RUNDFA_ENGINE_SHIFT) {
+
+        shiftNfa *shift = shiftFromTree(root);
+        fprintf(stderr, "Running the pattern as a bit-parallel NFA of %d "
+                "positions\n", shift -> size);
+        runStream(shift, shiftStreamFeed, shiftStreamEnd, options);
+        shiftKill(shift);
+        nfaKill(nfa);
+    } else {
+
+        lazyDfa *lazy = lazyEmpty(nfa, options -> cacheSize);
+        runStream(lazy, lazyStreamFeed, lazyStreamEnd, options);
+        lazyPrintStats(lazy, stderr);
+        lazyKill(lazy);
     }
-    return states;
+    arenaKill(arena);
+    return 1;
 }
 
 /*
-* description: Inserts states found in a string. Will insert the states
-* either as acceptable or not acceptable, depending on argument.
-* param[in]: dfa - Pointer to the dfa.
-* param[in]: line - Pointer to the string with the diffrent states.
-* param[in] acceptable - Tells if states are not acceptable(0), acceptable(1)
-* or if they're start states(2).
+* description: Classifies strings from the batch file (or stdin) with a
+* matcher and prints a summary.
+* param[in]: matcher - The matcher, see batchStream.
+* param[in]: feed - Feeds a part of a string to the matcher.
+* param[in]: end - Ends a string and writes its result.
+* param[in]: options - The parsed options.
 */
-void setStates (dfa *dfa, char *line, int acceptable) {
+void runStream (void *matcher, batchFeed feed, batchEnd end,
+        const options *options) {
 
+    FILE *in = stdin;
+    batchResult result;
 
-    int i = 0;
-    char *currState = getNextWord(line, &i);
+    if (options -> batchFile != NULL) {
 
-    while (currState != NULL) {
+        in = fopen(options -> batchFile, "r");
+    }
+    setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER_SIZE);
 
-        if (acceptable != 2) {
+    batchStream(matcher, feed, end, in, stdout, &result);
+    fflush(stdout);
+    batchPrintSummary(&result, stderr);
 
-            dfaInsertState(dfa, acceptable, currState);
-        } else {
+    if (in != stdin) {
 
-            dfaSetStart(dfa, currState);
-			free(currState);
-        }
-        currState = getNextWord(line, &i);
+        fclose(in);
     }
 }
 
 /*
-* description: Sets the paths of the diffrent states, the paths is found in a
-* textfile.
-* param[in]: dfa - Pointer to the dfa.
-* param[in]: fp - A file pointer to the file with the paths.
+* description: Classifies strings from the batch file (or stdin) with every
+* specification in one pass, and prints a summary with the count of each.
+* param[in]: options - The parsed options.
+* returns: 1 if every specification could be loaded, else 0.
 */
-void setPaths (dfa *dfa, FILE *fp) {
-
-    char *pathLine = readLine(fp);
+int runMulti (const options *options) {
 
-    while (pathLine != NULL) {
+    dfa *dfas[MULTI_MAX_DFAS];
+    struct options single = *options;
+    int loaded = 0;
 
-		int i = 0;
-        char* fromState = getNextWord(pathLine, &i);
-        char* path = getNextWord(pathLine, &i);
-        char* toState = getNextWord(pathLine, &i);
+    while (loaded < options -> nrOfSpecs) {
 
-        dfaModifyState(dfa, fromState, path, toState);
+        single.specFile = options -> specFiles[loaded];
+        dfas[loaded] = loadDfa(&single);
+        if (dfas[loaded] == NULL) {
 
-		if (fromState != NULL) {
+            break;
+        }
+        loaded++;
+    }
 
-			free(fromState);
-		}
+    int valid = loaded == options -> nrOfSpecs;
+    if (valid) {
 
-		if (toState != NULL) {
+        multiDfa *multi = multiEmpty(dfas, loaded, options -> cacheSize);
+        runStream(multi, multiStreamFeed, multiStreamEnd, options);
+        multiPrintSummary(multi, options -> specFiles, stderr);
+        multiKill(multi);
+    } else {
 
-			free(toState);
-		}
-
-        free(pathLine);
-        pathLine = readLine(fp);
+        fprintf(stderr, " - quitting program\n");
     }
 
-    if (pathLine != NULL) {
+    for (int i = 0; i < loaded; i++) {
 
-        free(pathLine);
+        dfaKill(dfas[i]);
     }
+    return valid;
 }
 
 /*
-* description: Validates number of arguments and that textfile (argv[1]) can be
-* read and written to.
-* param[in]: argc - number of parameters.
-* param[in]: argv - Parameters strings.
-* returns: 1 if arguments are valid, else 0.
+* description: Searches the scan file for matches and prints a summary.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
 */
-int fileValidation (int argc, const char *argv[]) {
+void runScan (const dfa *dfa, const options *options) {
 
-    FILE *fp;
+    setvbuf(stdout, NULL, _IOFBF, BATCH_BUFFER_SIZE);
+    long long matches = scanFile(dfa, options -> scanFile, options -> longest,
+            stdout);
+    fflush(stdout);
 
-    if (argc != 2) {
+    if (matches < 0) {
 
-        fprintf(stderr, "To many/few argument");
-        return 0;
+        fprintf(stderr, "Cannot read '%s'\n", options -> scanFile);
+    } else {
+
+        fprintf(stderr, "matches: %lld\n", matches);
     }
+}
 
-    fp = fopen(argv[1], "r");
-    if (fp == NULL) {
+/*
+* description: Runs the whole file as one string and tells if it is accepted.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
+*/
+void runWhole (const dfa *dfa, const options *options) {
 
-        fprintf(stderr, "Cannot read '%s'", argv[1]);
-        return 0;
+    bool accepted;
+
+    if (speculateFile(dfa, options -> wholeFile, options -> threads,
+            &accepted) == 0) {
+
+        fprintf(stderr, "Cannot read '%s'\n", options -> wholeFile);
+    } else {
+
+        printf("The file is %s\n", accepted ? "accepted by the dfa" :
+                "not accepted by the dfa");
     }
-    fclose(fp);
-    return 1;
 }
 
 /*
 * description: Runs the DFA with a while loop. Checks for input strings and
 * compares them to the DFA states, to see if they are accepable or not. If a
-* non -alhabetical or -numerical (like '?') is met, function ends.
-* param[in]: dfa - Pointer to the DFA.
+* '?' outside the alphabet of the DFA is met, function ends.
+* param[in]: dfa - Pointer to the compiled DFA, which is only read.
 */
-void runDfa (dfa *dfa) {
+void runDfa (const dfa *dfa) {
+
+	dfaCursor cursor;
+	dfaCursorInit(&cursor, dfa);
 
 	char choice = '0';
-    while (isAcceptedLetter(choice) >= 0) {
+    while (isAcceptedLetter(dfa, choice) >= 0) {
 
 		printf("-----\n\n");
 		printf("Write a sting of letters accepted by the current alphabet. A"
@@ -365,9 +890,9 @@ void runDfa (dfa *dfa) {
         scanf("%c", &choice);
 
 		int letterValidity = 1;
-        while (isAcceptedLetter(choice) == 1 && letterValidity == 1) {
+        while (isAcceptedLetter(dfa, choice) == 1 && letterValidity == 1) {
 
-            letterValidity = dfaChangeState(dfa, &choice);
+            letterValidity = dfaChangeState(&cursor, &choice);
 
 			if (letterValidity == 1) {
 
@@ -377,7 +902,7 @@ void runDfa (dfa *dfa) {
 
 		if (letterValidity == 1) {
 
-			printf("The string is %s\n\n", dfaIsAcceptable(dfa) == 1 ?
+			printf("The string is %s\n\n", dfaIsAcceptable(&cursor) == 1 ?
 			"accepted by the dfa" : "not accepted by the dfa");
 		} else if (letterValidity == 0) {
 
@@ -389,29 +914,33 @@ void runDfa (dfa *dfa) {
 			"current path in DFA\n\n");
 			clearInputStream();
 		}
-		dfaReset(dfa);
+		dfaReset(&cursor);
     }
 }
 
 /*
-* description: Validates char to see if it is a valid alphabetical / numerical
-* key, a line break or a command to quit program.
+* description: Validates char to see if it is a key, a line break or a command
+* to quit program. Chars in the alphabet of the dfa are always keys, so are
+* other chars except line breaks and '?', to be reported as not in the
+* alphabet.
+* param[in]: dfa - The compiled dfa, which alphabet is used.
 * param[in]: letter - The char to be validated.
 * return: 1 if key, 0 if linebreak, -1 if command to quit program.
 */
-int isAcceptedLetter (char letter) {
+int isAcceptedLetter (const dfa *dfa, char letter) {
 
-	if ((letter >= '0' && letter <= '9') ||
-		(letter >= 'a' && letter <= 'z') ||
-		(letter >= 'A' && letter <= 'Z')) {
+	if (dfaInAlphabet(dfa -> table, letter)) {
 
 			return 1;
 	} else  if (letter == '\n' || letter == '\r') {
 
 		return 0;
-	} else {
+	} else if (letter == '?') {
 
 		return -1;
+	} else {
+
+		return 1;
 	}
 }
 
@@ -17,12 +17,108 @@
 * in between). Each row will represent a state (the former) and a key to a path
 * in it which will lead to another state (the latter).
 *
+* The specification is mapped into memory and parsed in place, the rows from
+* row 4 by one thread per core (see spec.h). The rows end at the first empty
+* row or at the end of the file.
+*
+* Once built, the DFA is minimized before it is run. Equivalent states are
+* merged and the number of states before and after is written to stderr.
+*
+* With --compile the minimized DFA is instead written to a binary image (see
+* image.h) given by -o. An image can be given instead of a specification, it
+* is then mapped into memory and run without being parsed. With --verify the
+* checksum of a loaded image is checked before it is run. Every move of an
+* image is checked to lead to one of its states when it is loaded, unless
+* --trusted is given, which spares reading the whole table of an image too
+* large to be read in.
+*
+* With --emit-c the minimized DFA is instead written as C source (see emit.h)
+* to the file given by -o, or to stdout. --name sets the prefix of the names in
+* the generated code.
+*
+* With --regex a pattern is given instead of a specification. The pattern is
+* compiled into a DFA (see nfa.h), and --icase makes it ignore the case of
+* letters. The DFA accepts the strings the whole pattern matches.
+*
+* With --regex and --batch, --engine picks how the pattern is run. dfa compiles
+* it as above, lazy builds the DFA while running (see lazy.h) in a cache of at
+* most the bytes given by --cache, and shift runs patterns of at most 64
+* positions as a bit-parallel NFA (see shift.h). The default, auto, compiles
+* the DFA unless it gets too large, and then runs the pattern as shift, or as
+* lazy if it has too many positions. --lazy is short for --engine lazy.
+*
+* With --scan the given file is searched for strings accepted by the DFA, and
+* the start and end offset of every match is written to stdout (see scan.h).
+* Matches end at the first accepting state, or with --longest at the last one.
+*
+* With --whole the given file is run through the DFA as one single string and
+* the program tells if it is accepted. With --threads the file is split over
+* several threads (see speculate.h).
+*
 * To test if strings are valid in the built DFA, simply enter the string in the
-* terminal. Only alphabetical and numerical keys are valid. Anything else, like
-* a '?', will quit the program.
+* terminal. The keys of the paths in the DFA make up its alphabet. A '?' that
+* is not in the alphabet will quit the program.
+*
+* With --batch the program runs without prompts. Newline separated strings are
+* read from the given file, or from stdin if no file is given, and one line
+* with 'A' (accepted) or 'R' (rejected) is written per string to stdout. A
+* summary of the counts is written to stderr. With --threads the strings are
+* classified by several threads, 0 meaning one thread per core.
+*
+* With --batch, several specifications (or images) may be given. The strings
+* are then run through all of the DFAs in one pass (see multi.h), and the line
+* written per string is a bitmask in hex of the DFAs that accept it, bit i for
+* the i:th specification. The count of each DFA is added to the summary.
+* --cache then bounds the bytes the product of the DFAs may cache.
+*
+* A DFA whose dense table would take more bytes than --table-budget gets a
+* compressed table instead (see comb.h), which is slower to run but only
+* keeps the paths the states have. Such a DFA is not minimized, as that takes
+* as much memory as its dense table would.
+*
+* Once minimized, the states of the DFA are renumbered for locality in its
+* table (see order.h), in the order given by --order. bfs, the default,
+* numbers them breadth first from the start state, hot numbers them by how
+* often the strings of the file given by --train visit them, and none keeps
+* the order they were built in. An image keeps the order it was compiled
+* with.
+*
+* An image whose table would take more bytes than --table-budget is expected
+* not to fit in memory, and only the pages the DFA runs through are read in
+* (see image.h). Ordered hot, the rows of the states the training strings
+* visited are read in first, as many as fit in --table-budget. The file given
+* by --train may also be a profile dump, whose visits are then used as is.
+*
+* Built with DFA_PROFILE (make makerundfaprofile), --profile counts what the
+* runs of the DFA do (see profile.h). A report of the most visited states is
+* written to stderr, and a dump of the counts to the given file.
 *
 * param[in]: argv[0] - ./[exacutable program name]
 * param[in]: argv[1] - filename of the file with the specification for the dfa.
+* param[in]: argv[2 - n] - Optional, more specifications to run with --batch.
+* param[in]: --batch [file] - Optional, classify strings from file or stdin.
+* param[in]: --threads n - Optional, number of threads for --batch.
+* param[in]: --compile - Optional, write the DFA as an image instead.
+* param[in]: -o file - The image to write with --compile.
+* param[in]: --verify - Optional, check the checksum of a loaded image.
+* param[in]: --trusted - Optional, do not check the moves of a loaded image.
+* param[in]: --emit-c - Optional, write the DFA as C source instead.
+* param[in]: --name name - Optional, prefix of the names in the C source.
+* param[in]: --scan file - Optional, search the file for matches.
+* param[in]: --longest - Optional, longest instead of earliest matches.
+* param[in]: --whole file - Optional, run the whole file as one string.
+* param[in]: --regex pattern - Optional, build the DFA from a pattern instead.
+* param[in]: --icase - Optional, ignore the case of letters in the pattern.
+* param[in]: --engine name - Optional, auto, dfa, lazy or shift for --regex.
+* param[in]: --lazy - Optional, build the DFA of the pattern while running.
+* param[in]: --cache bytes - Optional, the cache size for --lazy or several
+* specifications.
+* param[in]: --order name - Optional, none, bfs or hot, the order of the states.
+* param[in]: --train file - The strings to count visits on with --order hot,
+* or a profile dump.
+* param[in]: --table-budget bytes - Optional, most bytes of a dense table, or
+* of the table of an image before only its run pages are read in.
+* param[in]: --profile file - Optional, count the runs and dump the counts.
 *
 * Authors:
 * Buster Hultgren Warn <dv17bhn@cs.umu.se>
@@ -33,18 +129,166 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "dfa.h"
+#include "batch.h"
+#include "minimize.h"
+#include "image.h"
+#include "scan.h"
+#include "speculate.h"
+#include "emit.h"
+#include "nfa.h"
+#include "lazy.h"
+#include "shift.h"
+#include "multi.h"
+#include "spec.h"
+#include "order.h"
+#include "comb.h"
+#include "profile.h"
 
 /*
-* description: Creates and builds the dfa by using data from textfile (argv[1])
-* and applying it to the dfa datatype. It calculates number of states, sets up
-* the difffrent states, there path and if they are accaptable or not.
-* param[in]: argv[] - Starting parameter with the name of the textfile with the
-* dfa state.
-* returns: The complete dfa.
+* The engines a pattern can be run on, see engineByName. Automatically the DFA
+* of a pattern of at most SHIFT_MAX_POSITIONS positions may get
+* RUNDFA_AUTO_STATES states before the pattern is run as shift instead.
 */
-dfa *buildDfa (const char *argv[]);
+#define RUNDFA_ENGINE_AUTO 0
+#define RUNDFA_ENGINE_DFA 1
+#define RUNDFA_ENGINE_LAZY 2
+#define RUNDFA_ENGINE_SHIFT 3
+#define RUNDFA_ENGINES 4
+#define RUNDFA_AUTO_STATES 4096
+
+/*
+* The orders the states of a built DFA can be numbered in, see orderByName.
+*/
+#define RUNDFA_ORDER_NONE 0
+#define RUNDFA_ORDER_BFS 1
+#define RUNDFA_ORDER_HOT 2
+#define RUNDFA_ORDERS 3
+
+/*
+* The options the program was started with.
+* specFile - The file with the specification for the dfa.
+* specFiles - All specification files given, the first being specFile.
+* nrOfSpecs - Number of specification files given.
+* batch - If strings are to be classified without prompts.
+* batchFile - The file with strings to classify, NULL for stdin.
+* threads - Number of threads for batch mode, 0 for one per core.
+* compile - If the DFA is to be written as an image instead of run.
+* outputFile - The image or C source to write.
+* verify - If the checksum of a loaded image is to be checked.
+* trusted - If the moves of a loaded image are not to be checked.
+* emitC - If the DFA is to be written as C source instead of run.
+* emitName - Prefix of the names in the C source.
+* scanFile - The file to search for matches, NULL if not scanning.
+* longest - If matches are to be as long as possible.
+* wholeFile - The file to run as one string, NULL if not running one.
+* regex - The pattern to build the dfa from, NULL if using specFile.
+* icase - If the case of letters in the pattern is ignored.
+* engine - How --batch runs the pattern, one of RUNDFA_ENGINE_*.
+* cacheSize - Number of bytes the lazy DFA, or the product of several DFAs,
+* may cache.
+* order - The order the states are numbered in, one of RUNDFA_ORDER_*.
+* trainFile - The strings to count visits on for RUNDFA_ORDER_HOT, or a
+* profile dump.
+* tableBudget - Most bytes the dense table of a DFA may take.
+* profileFile - The file to dump the counts of the runs to, NULL if the runs
+* are not counted.
+*/
+typedef struct options {
+
+    const char *specFile;
+    const char *specFiles[MULTI_MAX_DFAS];
+    int nrOfSpecs;
+    bool batch;
+    const char *batchFile;
+    int threads;
+    bool compile;
+    const char *outputFile;
+    bool verify;
+    bool trusted;
+    bool emitC;
+    const char *emitName;
+    const char *scanFile;
+    bool longest;
+    const char *wholeFile;
+    const char *regex;
+    bool icase;
+    int engine;
+    size_t cacheSize;
+    int order;
+    const char *trainFile;
+    size_t tableBudget;
+    const char *profileFile;
+} options;
+
+/*
+* description: Parses the program arguments into options.
+* param[in]: argc - number of parameters.
+* param[in]: argv - Parameters strings.
+* param[out]: options - The parsed options.
+* returns: 1 if arguments are valid, else 0.
+*/
+int parseOptions (int argc, const char *argv[], options *options);
+
+/*
+* description: Finds the engine with a name.
+* param[in]: name - The name, auto, dfa, lazy or shift.
+* returns: The engine, -1 if there is none with the name.
+*/
+int engineByName (const char *name);
+
+/*
+* description: Finds the order of the states with a name.
+* param[in]: name - The name, none, bfs or hot.
+* returns: The order, -1 if there is none with the name.
+*/
+int orderByName (const char *name);
+
+/*
+* description: Creates and builds the dfa by using data from a textfile and
+* applying it to the dfa datatype. The file is mapped into memory and its
+* paths are parsed by one thread per core, see spec.h.
+* param[in]: fileName - The name of the textfile with the dfa specification.
+* returns: The complete dfa, NULL if the file could not be read.
+*/
+dfa *buildDfa (const char *fileName);
+
+/*
+* description: Loads the DFA, from an image if the specification file is one,
+* else by building and minimizing it.
+* param[in]: options - The parsed options.
+* returns: The compiled dfa, NULL if it could not be loaded.
+*/
+dfa *loadDfa (const options *options);
+
+/*
+* description: Builds the DFA from the specification file or the pattern, and
+* minimizes it.
+* param[in]: options - The parsed options.
+* returns: The minimized and compiled dfa, NULL if the specification cannot be
+* read or the pattern is invalid.
+*/
+dfa *buildMinimalDfa (const options *options);
+
+/*
+* description: Minimizes the dfa and reports the number of states before and
+* after on stderr. A dfa compiled into a compressed table is not minimized,
+* the size of the table is reported instead.
+* param[in]: dfa - The built dfa, which is freed if minimized.
+* returns: The minimized and compiled dfa.
+*/
+dfa *minimizeDfa (dfa *dfa);
+
+/*
+* description: Renumbers the states of the dfa in the order given by the
+* options.
+* param[in]: dfa - The built and compiled dfa.
+* param[in]: options - The parsed options.
+* returns: The dfa.
+*/
+dfa *orderDfa (dfa *dfa, const options *options);
 
 /*
 * description: Finds the next number (if any) in an array of chars and returns
@@ -58,73 +302,79 @@ dfa *buildDfa (const char *argv[]);
 int getNextInt (char *line, int *i);
 
 /*
-* description: Find the next word (if any) in an array of chars and returns it.
-* param[in]: line - A pointer to an array where the next word (if any) is to
-* be found.
-* param[in]: i - The index where the function should start looking in the
-* array.
-* return: If found; the word, else NULL.
+* description: Validates that the files given in the options can be read.
+* param[in]: options - The parsed options.
+* returns: 1 if files are valid, else 0.
 */
-char* getNextWord (char *line, int *i);
+int fileValidation (const options *options);
 
 /*
-* description: Reads a line from a file and saves it as an array of chars with
-* dynamically allocated memory.
-* param[in]: fp - A file pointer.
-* returns: A pointer to the allocated memory for the char array.
+* description: Classifies strings from the batch file (or stdin) without
+* prompts and prints a summary.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
 */
-char *readLine (FILE *fp);
+void runBatch (const dfa *dfa, const options *options);
 
 /*
-* description: Counts the number of states found in an array of chars. Each
-* word consisting of ascii chars including 33 to 126 counts as a state.
-* param[in]: line - A pointer to the char array.
-* returns: The number of states found.
+* description: Classifies strings from the batch file (or stdin) with the
+* pattern, on the engine chosen by the options, and prints a summary.
+* param[in]: options - The parsed options.
+* returns: 1 if the pattern is valid, else 0.
 */
-int countStates (char *line);
+int runPattern (const options *options);
 
 /*
-* description: Inserts states found in a string. Will insert the states
-* either as acceptable or not acceptable, depending on argument.
-* param[in]: dfa - Pointer to the dfa.
-* param[in]: line - Pointer to the string with the diffrent states.
-* param[in] acceptable - Tells if states are not acceptable(0), acceptable(1)
-* or if they're start states(2).
+* description: Classifies strings from the batch file (or stdin) with a
+* matcher and prints a summary.
+* param[in]: matcher - The matcher, see batchStream.
+* param[in]: feed - Feeds a part of a string to the matcher.
+* param[in]: end - Ends a string and writes its result.
+* param[in]: options - The parsed options.
 */
-void setStates (dfa *dfa, char *line, int acceptable);
+void runStream (void *matcher, batchFeed feed, batchEnd end,
+        const options *options);
 
 /*
-* description: Sets the paths of the diffrent states, the paths is found in a
-* textfile.
-* param[in]: dfa - Pointer to the dfa.
-* param[in]: fp - A file pointer to the file with the paths.
+* description: Classifies strings from the batch file (or stdin) with every
+* specification in one pass, and prints a summary with the count of each.
+* param[in]: options - The parsed options.
+* returns: 1 if every specification could be loaded, else 0.
 */
-void setPaths (dfa *dfa, FILE *fp);
+int runMulti (const options *options);
 
 /*
-* description: Validates number of arguments and that textfile (argv[1]) can be
-* read and written to.
-* param[in]: argc - number of parameters.
-* param[in]: argv - Parameters strings.
-* returns: 1 if arguments are valid, else 0.
+* description: Searches the scan file for matches and prints a summary.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
+*/
+void runScan (const dfa *dfa, const options *options);
+
+/*
+* description: Runs the whole file as one string and tells if it is accepted.
+* param[in]: dfa - Pointer to the compiled DFA.
+* param[in]: options - The parsed options.
 */
-int fileValidation (int argc, const char *argv[]);
+void runWhole (const dfa *dfa, const options *options);
 
 /*
 * description: Runs the DFA with a while loop. Checks for input strings and
 * compares them to the DFA states, to see if they are accepable or not. If a
-* non -alhabetical or -numerical (like '?') is met, function ends.
-* param[in]: dfa - Pointer to the DFA.
+* '?' outside the alphabet of the DFA is met, function ends.
+* param[in]: dfa - Pointer to the compiled DFA, which is only read.
 */
-void runDfa (dfa *dfa);
+void runDfa (const dfa *dfa);
 
 /*
-* description: Validates char to see if it is a valid alphabetical / numerical
-* key, a line break or a command to quit program.
+* description: Validates char to see if it is a key, a line break or a command
+* to quit program. Chars in the alphabet of the dfa are always keys, so are
+* other chars except line breaks and '?', to be reported as not in the
+* alphabet.
+* param[in]: dfa - The compiled dfa, which alphabet is used.
 * param[in]: letter - The char to be validated.
 * return: 1 if key, 0 if linebreak, -1 if command to quit program.
 */
-int isAcceptedLetter (char letter);
+int isAcceptedLetter (const dfa *dfa, char letter);
 
 /*
 * description: Clears the current input stream. Note: if input stream is
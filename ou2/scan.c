@@ -0,0 +1,371 @@
+/*
+* scan: Searches a file for strings accepted by a compiled dfa, like grep. The
+* file is mapped into memory and read once, from start to end. A run of the
+* dfa is started at every position and all runs are moved on together, in the
+* order they started. The match that starts first is reported, and the search
+* goes on right after it.
+*
+* A match is only known to start first once every run started before it has
+* failed, which may be far ahead. So that no byte is read twice, the search
+* for the next match goes on meanwhile: a found match opens a new level of
+* runs, started right after it. If a run of an earlier level matches, the
+* levels after it are dropped, as their matches would overlap it. A match is
+* reported once its level is the first one and has no runs left. The matches
+* waiting on a run that has not failed yet are kept until it does.
+*
+* Runs that reach the same state would match at the same places, so only the
+* first started of them is kept, also across levels, and there are never more
+* runs than states. While no run is going, or the only run is in a start
+* state that loops, the bytes that would not change that are searched past
+* (see dfaSkip).
+*
+* With earliest matching a match ends at the first accepting state reached,
+* with longest matching it ends at the last accepting state reached before
+* the dfa gets stuck in states from which no accepting state can be reached.
+* Empty matches are never reported.
+*
+* Each match is written as its start and end offset in the file, the end
+* being the offset right after the last char of the match.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "scan.h"
+#ifdef DFA_PROFILE
+#include "profile.h"
+#endif
+
+/*
+* description: Scans a file for matches of the dfa and writes their offsets.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file to scan.
+* param[in]: longest - true for longest matching, false for earliest.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches found, -1 if the file could not be read.
+*/
+long long scanFile (const dfa *dfa, const char *fileName, bool longest,
+		FILE *out) {
+
+	struct stat fileStat;
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+
+		if (fd >= 0) {
+
+			close(fd);
+		}
+		return -1;
+	}
+	if (fileStat.st_size == 0) {
+
+		close(fd);
+		return 0;
+	}
+
+	size_t size = fileStat.st_size;
+	char *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+
+		return -1;
+	}
+	posix_madvise(file, size, POSIX_MADV_SEQUENTIAL);
+
+	long long matches = scanArea(dfa -> table, file, file + size, longest,
+			out);
+
+	munmap(file, size);
+	return matches;
+}
+
+/*
+* description: Scans a memory area for matches of the dfa and writes their
+* offsets, counted from the start of the area.
+* param[in]: table - The compiled table.
+* param[in]: begin - Start of the area.
+* param[in]: end - End of the area.
+* param[in]: longest - true for longest matching, false for earliest.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches found.
+*/
+long long scanArea (const dfaTable *table, const char *begin,
+		const char *end, bool longest, FILE *out) {
+
+	const unsigned char *input = (const unsigned char *)begin;
+	const int startState = table -> startState;
+	const dfaExit *loop = &table -> exits[startState];
+	bool loopSkips = loop -> accelerated && !table -> acceptable[startState];
+	dfaExit entry = scanEntry(table);
+	size_t size = end - begin;
+	size_t i = 0;
+	long long matches = 0;
+	scanRuns runs;
+
+	runs.runs = malloc(sizeof(scanRun) * (table -> nrOfStates + 1));
+	runs.moved = malloc(sizeof(scanRun) * (table -> nrOfStates + 1));
+	runs.seen = calloc(table -> nrOfStates, sizeof(unsigned long long));
+	runs.step = 0;
+	runs.nrOfRuns = 0;
+	runs.capacity = 16;
+	runs.levels = malloc(sizeof(scanLevel) * runs.capacity);
+	runs.bottom = 0;
+	runs.top = 0;
+	runs.levels[0].begin = 0;
+	runs.levels[0].found = false;
+	runs.levels[0].nrOfRuns = 0;
+
+	while (true) {
+
+		//The runs left at the end can not match any more.
+		if (i == size) {
+
+			runs.nrOfRuns = 0;
+			for (int l = runs.bottom; l <= runs.top; l++) {
+
+				runs.levels[l].nrOfRuns = 0;
+			}
+		}
+		matches += scanReport(&runs, out);
+		if (i == size) {
+
+			break;
+		}
+
+		//Skip the bytes no run can start with, or that keep the only run in
+		//the start state.
+		size_t skipped = 0;
+		if (runs.bottom == runs.top && runs.nrOfRuns == 0 &&
+				entry.accelerated) {
+
+			skipped = dfaSkip(&entry, input + i, size - i);
+#ifdef DFA_PROFILE
+			for (size_t j = 0; j < skipped; j++) {
+
+				profileStop(table, 0);
+			}
+#endif
+		} else if (runs.bottom == runs.top && runs.nrOfRuns == 1 &&
+				loopSkips && runs.runs[0].state == startState) {
+
+			skipped = dfaSkip(loop, input + i, size - i);
+		}
+		if (skipped > 0) {
+
+#ifdef DFA_PROFILE
+			profileSkip(table, startState, input + i, skipped);
+#endif
+			i += skipped;
+			continue;
+		}
+
+		scanStep(table, &runs, input[i], i, size, longest);
+		i++;
+	}
+
+	free(runs.runs);
+	free(runs.moved);
+	free(runs.seen);
+	free(runs.levels);
+	return matches;
+}
+
+/*
+* description: Moves every run one byte on, and starts a new run of the top
+* level at the byte. A run that reaches a state an earlier started run already
+* is in is dropped, as it can only match where that run does. A run that
+* matches drops every later started run and the levels after its own, and
+* opens a new level after the match.
+* param[in]: table - The compiled table.
+* param[in]: runs - The runs, in the order they started.
+* param[in]: byte - The byte to move on.
+* param[in]: i - The offset of the byte.
+* param[in]: size - The size of the area.
+* param[in]: longest - true for longest matching, false for earliest.
+*/
+void scanStep (const dfaTable *table, scanRuns *runs, unsigned char byte,
+		size_t i, size_t size, bool longest) {
+
+	const int *next = table -> next;
+	const bool *acceptable = table -> acceptable;
+	const unsigned char *outcome = table -> outcome;
+	int class = table -> classes[byte];
+	int nrOfMoved = 0;
+	scanLevel *top = &runs -> levels[runs -> top];
+
+	if (i >= top -> begin) {
+
+		runs -> runs[runs -> nrOfRuns].state = table -> startState;
+		runs -> runs[runs -> nrOfRuns].level = runs -> top;
+		runs -> runs[runs -> nrOfRuns].start = i;
+		runs -> nrOfRuns++;
+		top -> nrOfRuns++;
+	}
+	runs -> step++;
+
+	for (int r = 0; r < runs -> nrOfRuns; r++) {
+
+		scanRun run = runs -> runs[r];
+		scanLevel *level = &runs -> levels[run.level];
+
+#ifdef DFA_PROFILE
+		profileMove(table, run.state, class);
+#endif
+		int state = next != NULL ?
+				next[(size_t)run.state * table -> nrOfClasses + class] :
+				dfaCombMove(table -> comb, run.state, class);
+		if (outcome[state] == DFA_DEAD) {
+
+#ifdef DFA_PROFILE
+			//The search goes on from the next start, nothing is skipped.
+			profileStop(table, 0);
+#endif
+			level -> nrOfRuns--;
+			continue;
+		}
+		if (longest && outcome[state] == DFA_ACCEPT_SINK) {
+
+#ifdef DFA_PROFILE
+			profileStop(table, size - i - 1);
+#endif
+			//Every longer match is accepted too, up to the end.
+			level -> nrOfRuns--;
+			scanFound(runs, r + 1, run.level, run.start, size);
+			break;
+		}
+		if (acceptable[state] && !longest) {
+
+			level -> nrOfRuns--;
+			scanFound(runs, r + 1, run.level, run.start, i + 1);
+			break;
+		}
+		if (runs -> seen[state] == runs -> step) {
+
+			level -> nrOfRuns--;
+			continue;
+		}
+		runs -> seen[state] = runs -> step;
+		runs -> moved[nrOfMoved].state = state;
+		runs -> moved[nrOfMoved].level = run.level;
+		runs -> moved[nrOfMoved].start = run.start;
+		nrOfMoved++;
+		if (acceptable[state]) {
+
+			//The run goes on, a longer match may replace this one.
+			scanFound(runs, r + 1, run.level, run.start, i + 1);
+			break;
+		}
+	}
+
+	scanRun *moved = runs -> moved;
+	runs -> moved = runs -> runs;
+	runs -> runs = moved;
+	runs -> nrOfRuns = nrOfMoved;
+}
+
+/*
+* description: Sets the match of the level of a run, dropping the runs after
+* it and the levels after its level, and opens a new level after the match.
+* param[in]: runs - The runs.
+* param[in]: r - Index of the first run to drop.
+* param[in]: level - The level of the run that matched.
+* param[in]: start - Where the match starts.
+* param[in]: end - Where the match ends.
+*/
+void scanFound (scanRuns *runs, int r, int level, size_t start, size_t end) {
+
+	for (; r < runs -> nrOfRuns; r++) {
+
+		runs -> levels[runs -> runs[r].level].nrOfRuns--;
+	}
+
+	runs -> levels[level].found = true;
+	runs -> levels[level].matchStart = start;
+	runs -> levels[level].matchEnd = end;
+	runs -> top = level + 1;
+	if (runs -> top == runs -> capacity) {
+
+		runs -> capacity *= 2;
+		runs -> levels = realloc(runs -> levels,
+				sizeof(scanLevel) * runs -> capacity);
+	}
+	runs -> levels[runs -> top].begin = end;
+	runs -> levels[runs -> top].found = false;
+	runs -> levels[runs -> top].nrOfRuns = 0;
+}
+
+/*
+* description: Writes the matches of the first levels that have no runs left,
+* as no earlier started run can match any more.
+* param[in]: runs - The runs.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches written.
+*/
+long long scanReport (scanRuns *runs, FILE *out) {
+
+	long long matches = 0;
+
+	while (runs -> bottom < runs -> top &&
+			runs -> levels[runs -> bottom].nrOfRuns == 0) {
+
+		scanLevel *level = &runs -> levels[runs -> bottom];
+		fprintf(out, "%zu %zu\n", level -> matchStart, level -> matchEnd);
+		matches++;
+		runs -> bottom++;
+	}
+
+	//Once only the top level is left, its runs are moved to the first one.
+	if (runs -> bottom == runs -> top && runs -> top > 0) {
+
+		runs -> levels[0] = runs -> levels[runs -> top];
+		for (int r = 0; r < runs -> nrOfRuns; r++) {
+
+			runs -> runs[r].level = 0;
+		}
+		runs -> bottom = 0;
+		runs -> top = 0;
+	}
+	return matches;
+}
+
+/*
+* description: Finds the bytes a run can start with, that is the bytes which
+* do not lead from the start state to a dead state (see dfaTable).
+* param[in]: table - The compiled table.
+* return: The bytes, accelerated if there are few enough of them to search
+* for.
+*/
+dfaExit scanEntry (const dfaTable *table) {
+
+	int room[DFA_MAX_CLASSES];
+	const int *row = dfaTableRow(table, table -> startState, room);
+	dfaExit entry;
+
+	entry.nrOfBytes = 0;
+	for (int i = 0; i < DFA_ALPHABET; i++) {
+
+		if (table -> outcome[row[table -> classes[i]]] == DFA_DEAD) {
+
+			continue;
+		}
+		if (entry.nrOfBytes == DFA_EXIT_BYTES) {
+
+			entry.accelerated = false;
+			return entry;
+		}
+		entry.bytes[entry.nrOfBytes++] = i;
+	}
+	entry.accelerated = true;
+	return entry;
+}
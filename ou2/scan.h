@@ -0,0 +1,156 @@
+/*
+* scan: Searches a file for strings accepted by a compiled dfa, like grep. The
+* file is mapped into memory and read once, from start to end. A run of the
+* dfa is started at every position and all runs are moved on together, in the
+* order they started. The match that starts first is reported, and the search
+* goes on right after it.
+*
+* A match is only known to start first once every run started before it has
+* failed, which may be far ahead. So that no byte is read twice, the search
+* for the next match goes on meanwhile: a found match opens a new level of
+* runs, started right after it. If a run of an earlier level matches, the
+* levels after it are dropped, as their matches would overlap it. A match is
+* reported once its level is the first one and has no runs left. The matches
+* waiting on a run that has not failed yet are kept until it does.
+*
+* Runs that reach the same state would match at the same places, so only the
+* first started of them is kept, also across levels, and there are never more
+* runs than states. While no run is going, or the only run is in a start
+* state that loops, the bytes that would not change that are searched past
+* (see dfaSkip).
+*
+* With earliest matching a match ends at the first accepting state reached,
+* with longest matching it ends at the last accepting state reached before
+* the dfa gets stuck in states from which no accepting state can be reached.
+* Empty matches are never reported.
+*
+* Each match is written as its start and end offset in the file, the end
+* being the offset right after the last char of the match.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef SCAN
+#define SCAN
+
+#include <stdio.h>
+
+#include "dfa.h"
+
+/*
+* A run of the dfa, started at an offset of the area, in a level of the scan.
+*/
+typedef struct scanRun {
+
+	int state;
+	int level;
+	size_t start;
+} scanRun;
+
+/*
+* A level of a scan: the search for a match from begin on. found tells if a
+* match from matchStart to matchEnd has been found, the next level then
+* searches from its end. nrOfRuns is the number of runs of the level.
+*/
+typedef struct scanLevel {
+
+	size_t begin;
+	bool found;
+	size_t matchStart;
+	size_t matchEnd;
+	int nrOfRuns;
+} scanLevel;
+
+/*
+* The runs going in a scan, in the order they started, and its levels from
+* bottom to top. Only the top level, which has found no match, starts new
+* runs. moved holds the runs while they are moved on, and seen the last step a
+* run reached each state in.
+*/
+typedef struct scanRuns {
+
+	scanRun *runs;
+	scanRun *moved;
+	unsigned long long *seen;
+	unsigned long long step;
+	int nrOfRuns;
+	scanLevel *levels;
+	int capacity;
+	int bottom;
+	int top;
+} scanRuns;
+
+/*
+* description: Scans a file for matches of the dfa and writes their offsets.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file to scan.
+* param[in]: longest - true for longest matching, false for earliest.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches found, -1 if the file could not be read.
+*/
+long long scanFile (const dfa *dfa, const char *fileName, bool longest,
+		FILE *out);
+
+/*
+* description: Scans a memory area for matches of the dfa and writes their
+* offsets, counted from the start of the area.
+* param[in]: table - The compiled table.
+* param[in]: begin - Start of the area.
+* param[in]: end - End of the area.
+* param[in]: longest - true for longest matching, false for earliest.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches found.
+*/
+long long scanArea (const dfaTable *table, const char *begin,
+		const char *end, bool longest, FILE *out);
+
+/*
+* description: Moves every run one byte on, and starts a new run of the top
+* level at the byte. A run that reaches a state an earlier started run already
+* is in is dropped, as it can only match where that run does. A run that
+* matches drops every later started run and the levels after its own, and
+* opens a new level after the match.
+* param[in]: table - The compiled table.
+* param[in]: runs - The runs, in the order they started.
+* param[in]: byte - The byte to move on.
+* param[in]: i - The offset of the byte.
+* param[in]: size - The size of the area.
+* param[in]: longest - true for longest matching, false for earliest.
+*/
+void scanStep (const dfaTable *table, scanRuns *runs, unsigned char byte,
+		size_t i, size_t size, bool longest);
+
+/*
+* description: Sets the match of the level of a run, dropping the runs after
+* it and the levels after its level, and opens a new level after the match.
+* param[in]: runs - The runs.
+* param[in]: r - Index of the first run to drop.
+* param[in]: level - The level of the run that matched.
+* param[in]: start - Where the match starts.
+* param[in]: end - Where the match ends.
+*/
+void scanFound (scanRuns *runs, int r, int level, size_t start, size_t end);
+
+/*
+* description: Writes the matches of the first levels that have no runs left,
+* as no earlier started run can match any more.
+* param[in]: runs - The runs.
+* param[in]: out - The file to write the offsets to.
+* return: Number of matches written.
+*/
+long long scanReport (scanRuns *runs, FILE *out);
+
+/*
+* description: Finds the bytes a run can start with, that is the bytes which
+* do not lead from the start state to a dead state (see dfaTable).
+* param[in]: table - The compiled table.
+* return: The bytes, accelerated if there are few enough of them to search
+* for.
+*/
+dfaExit scanEntry (const dfaTable *table);
+
+#endif //SCAN
@@ -0,0 +1,287 @@
+/*
+* shift: Runs a small pattern as a bit-parallel NFA, without building a dfa.
+* The pattern becomes a Glushkov automaton, which has one state per position
+* (char or set) of the pattern and no other moves than on bytes. With at most
+* SHIFT_MAX_POSITIONS positions the set of states a run is in fits in one
+* 64-bit word, and a move is a few table lookups and ands (the Shift-And
+* method, generalized to any pattern).
+*
+* Counted repetitions are expanded before the positions are counted, so
+* a{10} has ten positions.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#include "shift.h"
+
+/*
+* description: Counts the positions of a syntax tree.
+* param[in]: node - The root of the tree.
+* return: The number of positions, SHIFT_MAX_POSITIONS + 1 if there are more.
+*/
+int shiftPositions (const nfaNode *node) {
+
+	int positions;
+
+	switch (node -> type) {
+
+		case NFA_NODE_SET:
+			return 1;
+
+		case NFA_NODE_CONCAT:
+		case NFA_NODE_ALTERNATE:
+			positions = shiftPositions(node -> left) +
+					shiftPositions(node -> right);
+			break;
+
+		case NFA_NODE_REPEAT:
+			//Built as in nfaBuild, max copies or min and a repeated one.
+			positions = shiftPositions(node -> left) *
+					(node -> max < 0 ? node -> min + 1 : node -> max);
+			break;
+
+		default:
+			return 0;
+	}
+	return positions > SHIFT_MAX_POSITIONS ? SHIFT_MAX_POSITIONS + 1 :
+			positions;
+}
+
+/*
+* description: Builds the bit-parallel NFA of a syntax tree.
+* param[in]: root - The root of the tree, with at most SHIFT_MAX_POSITIONS
+* positions.
+* return: The NFA, ready to run.
+*/
+shiftNfa *shiftFromTree (const nfaNode *root) {
+
+	shiftNfa *shift = calloc(1, sizeof(shiftNfa));
+	uint64_t follow[SHIFT_MAX_POSITIONS] = {0};
+
+	shiftSets sets = shiftBuild(shift, root, follow);
+	shift -> first = sets.first;
+	shift -> last = sets.last;
+	shift -> nullable = sets.nullable;
+	shift -> nrOfChunks = (shift -> size + SHIFT_CHUNK_BITS - 1) /
+			SHIFT_CHUNK_BITS;
+
+	//Each value of a chunk adds the follow set of its lowest bit to those of
+	//a value already done.
+	for (int k = 0; k < shift -> nrOfChunks; k++) {
+
+		for (int v = 1; v < 1 << SHIFT_CHUNK_BITS; v++) {
+
+			int position = k * SHIFT_CHUNK_BITS + __builtin_ctz(v);
+			shift -> follow[k][v] = shift -> follow[k][v & (v - 1)] |
+					(position < shift -> size ? follow[position] : 0);
+		}
+	}
+	return shift;
+}
+
+/*
+* description: Runs a part of a string. The string may be split over any
+* number of feeds.
+* param[in]: shift - The NFA.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void shiftFeed (shiftNfa *shift, const char *buffer, size_t length) {
+
+	const unsigned char *input = (const unsigned char *)buffer;
+	uint64_t current = shift -> current;
+	size_t i = 0;
+
+	if (!shift -> started && length > 0) {
+
+		current = shift -> first & shift -> masks[input[0]];
+		shift -> started = true;
+		i = 1;
+	}
+
+	//A run with no positions left can never match again.
+	for (; i < length && current != 0; i++) {
+
+		current = shiftFollow(shift, current) & shift -> masks[input[i]];
+	}
+	shift -> current = current;
+}
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: shift - The NFA.
+* return: true if the string is accepted, else false.
+*/
+bool shiftFinalize (shiftNfa *shift) {
+
+	bool accepted = shift -> started ? (shift -> current & shift -> last) != 0 :
+			shift -> nullable;
+
+	shift -> current = 0;
+	shift -> started = false;
+	return accepted;
+}
+
+/*
+* description: Runs a whole string.
+* param[in]: shift - The NFA.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the string is accepted, else false.
+*/
+bool shiftAccepts (shiftNfa *shift, const char *string, size_t length) {
+
+	shiftFeed(shift, string, length);
+	return shiftFinalize(shift);
+}
+
+/*
+* description: shiftFeed for batchStream.
+* param[in]: shift - The NFA.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void shiftStreamFeed (void *shift, const char *buffer, size_t length) {
+
+	shiftFeed(shift, buffer, length);
+}
+
+/*
+* description: Ends a string for batchStream, see shiftFinalize.
+* param[in]: shift - The NFA.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void shiftStreamEnd (void *shift, FILE *out, batchResult *result) {
+
+	batchEndLine(shiftFinalize(shift), out, result);
+}
+
+/*
+* description: Finds the positions that may follow a set of positions.
+* param[in]: shift - The NFA.
+* param[in]: positions - The positions.
+* return: The positions that may follow.
+*/
+uint64_t shiftFollow (const shiftNfa *shift, uint64_t positions) {
+
+	uint64_t follow = 0;
+
+	for (int k = 0; k < shift -> nrOfChunks; k++) {
+
+		follow |= shift -> follow[k][(positions >> (k * SHIFT_CHUNK_BITS)) &
+				((1 << SHIFT_CHUNK_BITS) - 1)];
+	}
+	return follow;
+}
+
+/*
+* description: Gives positions to a part of a syntax tree and finds its
+* Glushkov sets, adding to the follow sets of the positions.
+* param[in]: shift - The NFA being built.
+* param[in]: node - The part of the tree.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the part.
+*/
+shiftSets shiftBuild (shiftNfa *shift, const nfaNode *node, uint64_t *follow) {
+
+	shiftSets sets = {0, 0, true};
+	shiftSets other;
+
+	switch (node -> type) {
+
+		case NFA_NODE_SET:
+			sets.first = (uint64_t)1 << shift -> size++;
+			sets.last = sets.first;
+			sets.nullable = false;
+			for (int i = 1; i < DFA_ALPHABET; i++) {
+
+				if (nfaSetHas(node -> set, i)) {
+
+					shift -> masks[i] |= sets.first;
+				}
+			}
+			break;
+
+		case NFA_NODE_CONCAT:
+			sets = shiftBuild(shift, node -> left, follow);
+			other = shiftBuild(shift, node -> right, follow);
+			sets = shiftConcat(sets, other, follow);
+			break;
+
+		case NFA_NODE_ALTERNATE:
+			sets = shiftBuild(shift, node -> left, follow);
+			other = shiftBuild(shift, node -> right, follow);
+			sets.first |= other.first;
+			sets.last |= other.last;
+			sets.nullable |= other.nullable;
+			break;
+
+		case NFA_NODE_REPEAT:
+			for (int i = 0; i < node -> max || i < node -> min ||
+					(node -> max < 0 && i == node -> min); i++) {
+
+				other = shiftBuild(shift, node -> left, follow);
+				if (node -> max < 0 && i == node -> min) {
+
+					other = shiftStar(other, follow);
+				} else if (i >= node -> min) {
+
+					other.nullable = true;
+				}
+				sets = shiftConcat(sets, other, follow);
+			}
+			break;
+	}
+	return sets;
+}
+
+/*
+* description: Finds the sets of two parts in sequence.
+* param[in]: a - The sets of the first part.
+* param[in]: b - The sets of the second part.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the sequence.
+*/
+shiftSets shiftConcat (shiftSets a, shiftSets b, uint64_t *follow) {
+
+	shiftSets sets;
+
+	for (uint64_t last = a.last; last != 0; last &= last - 1) {
+
+		follow[__builtin_ctzll(last)] |= b.first;
+	}
+	sets.first = a.first | (a.nullable ? b.first : 0);
+	sets.last = b.last | (b.nullable ? a.last : 0);
+	sets.nullable = a.nullable && b.nullable;
+	return sets;
+}
+
+/*
+* description: Finds the sets of a part repeated any number of times.
+* param[in]: a - The sets of the part.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the repetition.
+*/
+shiftSets shiftStar (shiftSets a, uint64_t *follow) {
+
+	for (uint64_t last = a.last; last != 0; last &= last - 1) {
+
+		follow[__builtin_ctzll(last)] |= a.first;
+	}
+	a.nullable = true;
+	return a;
+}
+
+/*
+* description: Frees the NFA.
+* param[in]: shift - The NFA.
+*/
+void shiftKill (shiftNfa *shift) {
+
+	free(shift);
+}
@@ -0,0 +1,162 @@
+/*
+* shift: Runs a small pattern as a bit-parallel NFA, without building a dfa.
+* The pattern becomes a Glushkov automaton, which has one state per position
+* (char or set) of the pattern and no other moves than on bytes. With at most
+* SHIFT_MAX_POSITIONS positions the set of states a run is in fits in one
+* 64-bit word, and a move is a few table lookups and ands (the Shift-And
+* method, generalized to any pattern).
+*
+* Counted repetitions are expanded before the positions are counted, so
+* a{10} has ten positions.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef SHIFT
+#define SHIFT
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "nfa.h"
+#include "batch.h"
+
+#define SHIFT_MAX_POSITIONS 64
+#define SHIFT_CHUNK_BITS 8
+#define SHIFT_CHUNKS (SHIFT_MAX_POSITIONS / SHIFT_CHUNK_BITS)
+
+/*
+* A Glushkov automaton, position p being bit p. masks holds the positions each
+* byte can be matched at. The positions that may follow the positions of a
+* chunk of 8 bits are looked up in follow by the value of the chunk. first and
+* last are the positions a match can begin and end at, and nullable tells if
+* the empty string matches.
+*
+* A run is in the positions of current, started telling if any byte has been
+* run yet.
+*/
+typedef struct shiftNfa {
+
+	int size;
+	int nrOfChunks;
+	uint64_t masks[DFA_ALPHABET];
+	uint64_t follow[SHIFT_CHUNKS][1 << SHIFT_CHUNK_BITS];
+	uint64_t first;
+	uint64_t last;
+	bool nullable;
+	uint64_t current;
+	bool started;
+} shiftNfa;
+
+/*
+* The Glushkov sets of a part of a pattern.
+*/
+typedef struct shiftSets {
+
+	uint64_t first;
+	uint64_t last;
+	bool nullable;
+} shiftSets;
+
+/*
+* description: Counts the positions of a syntax tree.
+* param[in]: node - The root of the tree.
+* return: The number of positions, SHIFT_MAX_POSITIONS + 1 if there are more.
+*/
+int shiftPositions (const nfaNode *node);
+
+/*
+* description: Builds the bit-parallel NFA of a syntax tree.
+* param[in]: root - The root of the tree, with at most SHIFT_MAX_POSITIONS
+* positions.
+* return: The NFA, ready to run.
+*/
+shiftNfa *shiftFromTree (const nfaNode *root);
+
+/*
+* description: Runs a part of a string. The string may be split over any
+* number of feeds.
+* param[in]: shift - The NFA.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void shiftFeed (shiftNfa *shift, const char *buffer, size_t length);
+
+/*
+* description: Ends the string being run, and starts a new one.
+* param[in]: shift - The NFA.
+* return: true if the string is accepted, else false.
+*/
+bool shiftFinalize (shiftNfa *shift);
+
+/*
+* description: Runs a whole string.
+* param[in]: shift - The NFA.
+* param[in]: string - The string, does not need to be terminated.
+* param[in]: length - Number of chars in the string.
+* return: true if the string is accepted, else false.
+*/
+bool shiftAccepts (shiftNfa *shift, const char *string, size_t length);
+
+/*
+* description: shiftFeed for batchStream.
+* param[in]: shift - The NFA.
+* param[in]: buffer - The chars.
+* param[in]: length - Number of chars.
+*/
+void shiftStreamFeed (void *shift, const char *buffer, size_t length);
+
+/*
+* description: Ends a string for batchStream, see shiftFinalize.
+* param[in]: shift - The NFA.
+* param[in]: out - The file to write the result to.
+* param[out]: result - The counts to be updated.
+*/
+void shiftStreamEnd (void *shift, FILE *out, batchResult *result);
+
+/*
+* description: Finds the positions that may follow a set of positions.
+* param[in]: shift - The NFA.
+* param[in]: positions - The positions.
+* return: The positions that may follow.
+*/
+uint64_t shiftFollow (const shiftNfa *shift, uint64_t positions);
+
+/*
+* description: Gives positions to a part of a syntax tree and finds its
+* Glushkov sets, adding to the follow sets of the positions.
+* param[in]: shift - The NFA being built.
+* param[in]: node - The part of the tree.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the part.
+*/
+shiftSets shiftBuild (shiftNfa *shift, const nfaNode *node, uint64_t *follow);
+
+/*
+* description: Finds the sets of two parts in sequence.
+* param[in]: a - The sets of the first part.
+* param[in]: b - The sets of the second part.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the sequence.
+*/
+shiftSets shiftConcat (shiftSets a, shiftSets b, uint64_t *follow);
+
+/*
+* description: Finds the sets of a part repeated any number of times.
+* param[in]: a - The sets of the part.
+* param[in/out]: follow - The follow set of each position.
+* return: The sets of the repetition.
+*/
+shiftSets shiftStar (shiftSets a, uint64_t *follow);
+
+/*
+* description: Frees the NFA.
+* param[in]: shift - The NFA.
+*/
+void shiftKill (shiftNfa *shift);
+
+#endif //SHIFT
@@ -0,0 +1,449 @@
+/*
+* spec: Parses a dfa specification (see rundfa.h for the format) from a file
+* mapped into memory. Words are never copied out of the mapping to be parsed,
+* they are read in place as a pointer into the mapping and a length. Only the
+* names of the states and the keys of the paths are copied, into the arena of
+* the dfa.
+*
+* The transition rows, which make up almost all of a large specification, are
+* split at line boundaries into one part per thread. All states are inserted
+* before the rows are parsed, so the threads only read when they look up the
+* states of a row, and each thread allocates its paths from an arena of its
+* own. The paths are then linked into their states in the order of the rows,
+* so the last row for a state and key still wins.
+*
+* Looking up the states is what a large specification spends its time on, as
+* every lookup is a miss in the cache. The states are therefore looked up in
+* a table of their own, where a slot holds the hash and a short name inline,
+* and the slots of a batch of rows are prefetched together.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spec.h"
+
+/*
+* description: Builds the dfa of a specification file, without compiling it.
+* param[in]: fileName - The specification file.
+* param[in]: nrOfThreads - Number of threads parsing the transition rows, 0 for
+* one per core. Fewer are used for a small specification.
+* return: The built dfa, NULL if the file could not be read.
+*/
+dfa *specLoad (const char *fileName, int nrOfThreads) {
+
+	struct stat fileStat;
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+
+		fprintf(stderr, "Could not read specification '%s'\n", fileName);
+		if (fd >= 0) {
+
+			close(fd);
+		}
+		return NULL;
+	}
+
+	//An empty file cannot be mapped, it is parsed as an empty string.
+	size_t size = fileStat.st_size;
+	char *mapping = size > 0 ?
+			mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+	if (mapping == MAP_FAILED) {
+
+		fprintf(stderr, "Could not map specification '%s'\n", fileName);
+		return NULL;
+	}
+	if (mapping != NULL) {
+
+		posix_madvise(mapping, size, POSIX_MADV_SEQUENTIAL);
+	}
+
+	const char *curr = mapping != NULL ? mapping : "";
+	const char *end = curr + size;
+	const char *rows[3];
+	const char *rowEnds[3];
+
+	for (int i = 0; i < 3; i++) {
+
+		rows[i] = curr;
+		rowEnds[i] = specRowEnd(curr, end);
+		curr = rowEnds[i] < end ? rowEnds[i] + 1 : end;
+	}
+
+	dfa *dfa = dfaEmpty();
+	dfaSetStates(dfa, specCountWords(rows[1], rowEnds[1]) +
+			specCountWords(rows[2], rowEnds[2]));
+	specStates(dfa, rows[1], rowEnds[1], 1);
+	specStates(dfa, rows[2], rowEnds[2], 0);
+	specStates(dfa, rows[0], rowEnds[0], 2);
+
+	if (nrOfThreads <= 0) {
+
+		nrOfThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	size_t rowsSize = end - curr;
+	if ((size_t)nrOfThreads > rowsSize / SPEC_MIN_PART) {
+
+		nrOfThreads = rowsSize / SPEC_MIN_PART;
+	}
+	nrOfThreads = nrOfThreads > 0 ? nrOfThreads : 1;
+
+	specNames names;
+	specIndex(dfa, &names);
+
+	specPart *parts = calloc(nrOfThreads, sizeof(specPart));
+	pthread_t *threads = malloc(sizeof(pthread_t) * nrOfThreads);
+	const char *rowsBegin = curr;
+
+	for (int i = 0; i < nrOfThreads; i++) {
+
+		//Each part ends with the row its share of the bytes ends in.
+		const char *partEnd = rowsBegin + rowsSize * (i + 1) / nrOfThreads;
+		if (partEnd < curr) {
+
+			partEnd = curr;
+		}
+		if (partEnd > curr && partEnd[-1] != '\n') {
+
+			partEnd = specRowEnd(partEnd, end);
+			partEnd = partEnd < end ? partEnd + 1 : end;
+		}
+
+		parts[i].names = &names;
+		parts[i].begin = curr;
+		parts[i].end = partEnd;
+		parts[i].arena = arenaEmpty();
+		curr = partEnd;
+		if (i > 0) {
+
+			pthread_create(&threads[i], NULL, specParse, &parts[i]);
+		}
+	}
+	specParse(&parts[0]);
+	for (int i = 1; i < nrOfThreads; i++) {
+
+		pthread_join(threads[i], NULL);
+	}
+
+	//Linked in the order of the rows, each path first in its list.
+	bool stopped = false;
+	for (int i = 0; i < nrOfThreads; i++) {
+
+		specPart *part = &parts[i];
+		if (stopped) {
+
+			arenaKill(part -> arena);
+		} else {
+
+			for (int j = 0; j < part -> nrOfPaths; j++) {
+
+				part -> paths[j] -> nextPath = part -> from[j] -> paths;
+				part -> from[j] -> paths = part -> paths[j];
+			}
+			arenaMerge(dfa -> arena, part -> arena);
+			stopped = part -> stopped;
+		}
+		free(part -> paths);
+		free(part -> from);
+	}
+
+	free(names.slots);
+	free(parts);
+	free(threads);
+	if (mapping != NULL) {
+
+		munmap(mapping, size);
+	}
+	return dfa;
+}
+
+/*
+* description: Inserts the states named on a row of the specification.
+* param[in]: dfa - The dfa.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* param[in]: acceptable - Tells if states are not acceptable(0), acceptable(1)
+* or if they're start states(2).
+*/
+void specStates (dfa *dfa, const char *begin, const char *end, int acceptable) {
+
+	char *name = NULL;
+	size_t capacity = 0;
+	specWord word = specNextWord(&begin, end);
+
+	while (word.length > 0) {
+
+		if (word.length + 1 > capacity) {
+
+			capacity = word.length + 1;
+			name = realloc(name, capacity);
+		}
+		memcpy(name, word.begin, word.length);
+		name[word.length] = '\0';
+
+		if (acceptable != 2) {
+
+			dfaInsertState(dfa, acceptable, name);
+		} else {
+
+			dfaSetStart(dfa, name);
+		}
+		word = specNextWord(&begin, end);
+	}
+	free(name);
+}
+
+/*
+* description: Parses the transition rows of a part. Run by a thread.
+* param[in]: arg - The specPart.
+* return: NULL.
+*/
+void *specParse (void *arg) {
+
+	specPart *part = arg;
+	const specNames *names = part -> names;
+	specWord rows[SPEC_BATCH][3];
+	unsigned int hashes[SPEC_BATCH][2];
+	const char *curr = part -> begin;
+
+	while (curr < part -> end && !part -> stopped) {
+
+		int nrOfRows = 0;
+
+		//The slots of a batch of rows are fetched from memory together.
+		while (nrOfRows < SPEC_BATCH && curr < part -> end) {
+
+			const char *rowEnd = specRowEnd(curr, part -> end);
+			if (specIsEmptyRow(curr, rowEnd)) {
+
+				part -> stopped = true;
+				break;
+			}
+
+			const char *next = curr;
+			specWord *row = rows[nrOfRows];
+			for (int i = 0; i < 3; i++) {
+
+				row[i] = specNextWord(&next, rowEnd);
+			}
+			curr = rowEnd < part -> end ? rowEnd + 1 : part -> end;
+
+			//A row with less than three words is ignored.
+			if (row[2].length > 0) {
+
+				hashes[nrOfRows][0] = dfaHashSubstring(row[0].begin,
+						row[0].length);
+				hashes[nrOfRows][1] = dfaHashSubstring(row[2].begin,
+						row[2].length);
+				__builtin_prefetch(&names -> slots[hashes[nrOfRows][0] &
+						names -> mask]);
+				__builtin_prefetch(&names -> slots[hashes[nrOfRows][1] &
+						names -> mask]);
+				nrOfRows++;
+			}
+		}
+
+		//A row from no state is ignored.
+		for (int i = 0; i < nrOfRows; i++) {
+
+			state *from = specFind(names, rows[i][0], hashes[i][0]);
+			if (from != NULL) {
+
+				specAddPath(part, from, rows[i][1],
+						specFind(names, rows[i][2], hashes[i][1]));
+			}
+		}
+	}
+	return NULL;
+}
+
+/*
+* description: Builds the table of names of the states of a dfa. If several
+* states have the same name, the first one is found, as in dfaFindState.
+* param[in]: dfa - The dfa.
+* param[out]: names - The table.
+*/
+void specIndex (const dfa *dfa, specNames *names) {
+
+	unsigned int capacity = 16;
+	while (capacity < (unsigned int)dfa -> size * 2) {
+
+		capacity *= 2;
+	}
+	names -> mask = capacity - 1;
+	names -> slots = calloc(capacity, sizeof(specSlot));
+
+	for (int i = 0; i < dfa -> size; i++) {
+
+		state *state = dfa -> allStates[i];
+		specWord name = {state -> stateName, strlen(state -> stateName)};
+		unsigned int hash = dfaHashSubstring(name.begin, name.length);
+
+		if (specFind(names, name, hash) != NULL) {
+
+			continue;
+		}
+
+		unsigned int j = hash & names -> mask;
+		while (names -> slots[j].state != NULL) {
+
+			j = (j + 1) & names -> mask;
+		}
+		names -> slots[j].state = state;
+		names -> slots[j].hash = hash;
+		names -> slots[j].length = name.length;
+		if (name.length <= SPEC_SHORT_NAME) {
+
+			memcpy(names -> slots[j].name, name.begin, name.length);
+		}
+	}
+}
+
+/*
+* description: Finds the state with a name.
+* param[in]: names - The table of names.
+* param[in]: name - The name.
+* param[in]: hash - The hash of the name, see dfaHashSubstring.
+* return: If found; the state, else NULL.
+*/
+state *specFind (const specNames *names, specWord name, unsigned int hash) {
+
+	unsigned int i = hash & names -> mask;
+
+	while (names -> slots[i].state != NULL) {
+
+		const specSlot *slot = &names -> slots[i];
+		if (slot -> hash == hash && slot -> length == (int)name.length &&
+				memcmp(name.begin, name.length <= SPEC_SHORT_NAME ?
+				slot -> name : slot -> state -> stateName, name.length) == 0) {
+
+			return slot -> state;
+		}
+		i = (i + 1) & names -> mask;
+	}
+	return NULL;
+}
+
+/*
+* description: Adds a path to the paths of a part.
+* param[in]: part - The part.
+* param[in]: from - The state the path leads out of.
+* param[in]: key - The key of the path.
+* param[in]: destination - The state the path leads to, NULL if there is none.
+*/
+void specAddPath (specPart *part, state *from, specWord key,
+		state *destination) {
+
+	if (part -> nrOfPaths == part -> capacity) {
+
+		part -> capacity = part -> capacity > 0 ? part -> capacity * 2 : 1024;
+		part -> paths = realloc(part -> paths,
+				sizeof(path*) * part -> capacity);
+		part -> from = realloc(part -> from, sizeof(state*) * part -> capacity);
+	}
+
+	path *path = arenaAlloc(part -> arena, sizeof(*path));
+	unsigned char first = (unsigned char)key.begin[0];
+
+	//Keys are only read, so the paths of a part share a copy of each byte.
+	if (key.length > 1) {
+
+		path -> key = arenaSubstring(part -> arena, key.begin, key.length);
+	} else {
+
+		if (part -> keys[first] == NULL) {
+
+			part -> keys[first] = arenaSubstring(part -> arena, key.begin, 1);
+		}
+		path -> key = part -> keys[first];
+	}
+	path -> destination = destination;
+	path -> nextPath = NULL;
+
+	part -> paths[part -> nrOfPaths] = path;
+	part -> from[part -> nrOfPaths] = from;
+	part -> nrOfPaths++;
+}
+
+/*
+* description: Finds the next word of a row.
+* param[in/out]: curr - Where to start looking, moved past the word.
+* param[in]: end - The end of the row.
+* return: The word, of length 0 if there is none.
+*/
+specWord specNextWord (const char **curr, const char *end) {
+
+	const char *c = *curr;
+	specWord word;
+
+	//Words are made of the chars 33 to 126, anything else separates them.
+	while (c < end && (*c < 33 || *c > 126)) {
+
+		c++;
+	}
+	word.begin = c;
+	while (c < end && *c >= 33 && *c <= 126) {
+
+		c++;
+	}
+	word.length = c - word.begin;
+	*curr = c;
+	return word;
+}
+
+/*
+* description: Finds the end of the row starting at a char.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the mapping.
+* return: The newline ending the row, or end.
+*/
+const char *specRowEnd (const char *begin, const char *end) {
+
+	const char *newline = memchr(begin, '\n', end - begin);
+	return newline != NULL ? newline : end;
+}
+
+/*
+* description: Tells if a row is empty, which ends the specification. A row of
+* only carriage returns is empty.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* return: true if the row is empty, else false.
+*/
+bool specIsEmptyRow (const char *begin, const char *end) {
+
+	while (begin < end && *begin == '\r') {
+
+		begin++;
+	}
+	return begin == end;
+}
+
+/*
+* description: Counts the words of a row.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* return: The number of words.
+*/
+int specCountWords (const char *begin, const char *end) {
+
+	int words = 0;
+
+	while (specNextWord(&begin, end).length > 0) {
+
+		words++;
+	}
+	return words;
+}
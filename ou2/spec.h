@@ -0,0 +1,176 @@
+/*
+* spec: Parses a dfa specification (see rundfa.h for the format) from a file
+* mapped into memory. Words are never copied out of the mapping to be parsed,
+* they are read in place as a pointer into the mapping and a length. Only the
+* names of the states and the keys of the paths are copied, into the arena of
+* the dfa.
+*
+* The transition rows, which make up almost all of a large specification, are
+* split at line boundaries into one part per thread. All states are inserted
+* before the rows are parsed, so the threads only read when they look up the
+* states of a row, and each thread allocates its paths from an arena of its
+* own. The paths are then linked into their states in the order of the rows,
+* so the last row for a state and key still wins.
+*
+* Looking up the states is what a large specification spends its time on, as
+* every lookup is a miss in the cache. The states are therefore looked up in
+* a table of their own, where a slot holds the hash and a short name inline,
+* and the slots of a batch of rows are prefetched together.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef SPEC
+#define SPEC
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "dfa.h"
+#include "arena.h"
+
+#define SPEC_MIN_PART (1 << 20)
+#define SPEC_SHORT_NAME 16
+#define SPEC_BATCH 16
+
+/*
+* A word of the specification, length chars from begin in the mapping.
+*/
+typedef struct specWord {
+
+	const char *begin;
+	size_t length;
+} specWord;
+
+/*
+* A state in the table of names. The name is held inline if it has at most
+* SPEC_SHORT_NAME chars.
+*/
+typedef struct specSlot {
+
+	state *state;
+	unsigned int hash;
+	int length;
+	char name[SPEC_SHORT_NAME];
+} specSlot;
+
+/*
+* The names of the states, in an open addressing table of mask + 1 slots.
+*/
+typedef struct specNames {
+
+	unsigned int mask;
+	specSlot *slots;
+} specNames;
+
+/*
+* The transition rows from begin to end, parsed by one thread. The paths of the
+* rows that name existing states are allocated from arena and listed in paths,
+* the state each leads out of in from. stopped tells if an empty row was found,
+* which ends the specification. keys holds the copy of each one char key.
+*/
+typedef struct specPart {
+
+	const specNames *names;
+	const char *begin;
+	const char *end;
+	arena *arena;
+	path **paths;
+	state **from;
+	int nrOfPaths;
+	int capacity;
+	bool stopped;
+	char *keys[DFA_ALPHABET];
+} specPart;
+
+/*
+* description: Builds the dfa of a specification file, without compiling it.
+* param[in]: fileName - The specification file.
+* param[in]: nrOfThreads - Number of threads parsing the transition rows, 0 for
+* one per core. Fewer are used for a small specification.
+* return: The built dfa, NULL if the file could not be read.
+*/
+dfa *specLoad (const char *fileName, int nrOfThreads);
+
+/*
+* description: Inserts the states named on a row of the specification.
+* param[in]: dfa - The dfa.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* param[in]: acceptable - Tells if states are not acceptable(0), acceptable(1)
+* or if they're start states(2).
+*/
+void specStates (dfa *dfa, const char *begin, const char *end, int acceptable);
+
+/*
+* description: Parses the transition rows of a part. Run by a thread.
+* param[in]: arg - The specPart.
+* return: NULL.
+*/
+void *specParse (void *arg);
+
+/*
+* description: Builds the table of names of the states of a dfa. If several
+* states have the same name, the first one is found, as in dfaFindState.
+* param[in]: dfa - The dfa.
+* param[out]: names - The table.
+*/
+void specIndex (const dfa *dfa, specNames *names);
+
+/*
+* description: Finds the state with a name.
+* param[in]: names - The table of names.
+* param[in]: name - The name.
+* param[in]: hash - The hash of the name, see dfaHashSubstring.
+* return: If found; the state, else NULL.
+*/
+state *specFind (const specNames *names, specWord name, unsigned int hash);
+
+/*
+* description: Adds a path to the paths of a part.
+* param[in]: part - The part.
+* param[in]: from - The state the path leads out of.
+* param[in]: key - The key of the path.
+* param[in]: destination - The state the path leads to, NULL if there is none.
+*/
+void specAddPath (specPart *part, state *from, specWord key,
+		state *destination);
+
+/*
+* description: Finds the next word of a row.
+* param[in/out]: curr - Where to start looking, moved past the word.
+* param[in]: end - The end of the row.
+* return: The word, of length 0 if there is none.
+*/
+specWord specNextWord (const char **curr, const char *end);
+
+/*
+* description: Finds the end of the row starting at a char.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the mapping.
+* return: The newline ending the row, or end.
+*/
+const char *specRowEnd (const char *begin, const char *end);
+
+/*
+* description: Tells if a row is empty, which ends the specification. A row of
+* only carriage returns is empty.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* return: true if the row is empty, else false.
+*/
+bool specIsEmptyRow (const char *begin, const char *end);
+
+/*
+* description: Counts the words of a row.
+* param[in]: begin - The first char of the row.
+* param[in]: end - The end of the row.
+* return: The number of words.
+*/
+int specCountWords (const char *begin, const char *end);
+
+#endif //SPEC
@@ -0,0 +1,225 @@
+/*
+* speculate: Runs one huge input through a compiled dfa on several cores. The
+* input is split into one chunk per thread. Only the first chunk knows which
+* state it starts in, so every other chunk is run from every state at once,
+* giving a mapping from the state the chunk starts in to the state it ends
+* in. The mappings are then composed in input order to find the state the
+* whole input ends in.
+*
+* The runs of a chunk are kept as lanes, one per distinct current state, that
+* are stepped together over each byte. Lanes that end up in the same state are
+* merged, which for most dfas quickly leaves only a few lanes. This only pays
+* off for dfas with few states, larger dfas are run in one thread.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "speculate.h"
+#include "batch.h"
+
+/*
+* description: Runs an input through a compiled table, split over threads.
+* param[in]: table - The compiled table.
+* param[in]: begin - Start of the input.
+* param[in]: end - End of the input.
+* param[in]: nrOfThreads - Number of threads, 0 for one per core.
+* return: The state the input ends in.
+*/
+int speculateRun (const dfaTable *table, const char *begin, const char *end,
+		int nrOfThreads) {
+
+	size_t size = end - begin;
+
+	nrOfThreads = batchThreads(nrOfThreads);
+	if (nrOfThreads == 1 || table -> nrOfStates > SPECULATE_MAX_STATES ||
+			size < (size_t)nrOfThreads * SPECULATE_BLOCK_SIZE) {
+
+		return dfaTableRun(table, table -> startState, begin, end - begin);
+	}
+#ifdef DFA_PROFILE
+	//A speculative chunk runs from many states, only one run really happens.
+	return dfaTableRun(table, table -> startState, begin, end - begin);
+#endif
+
+	speculateChunk *chunks = malloc(sizeof(speculateChunk) * nrOfThreads);
+	pthread_t *threads = malloc(sizeof(pthread_t) * nrOfThreads);
+
+	for (int i = 0; i < nrOfThreads; i++) {
+
+		chunks[i].table = table;
+		chunks[i].begin = begin + size * i / nrOfThreads;
+		chunks[i].end = begin + size * (i + 1) / nrOfThreads;
+		chunks[i].fromStart = i == 0;
+		chunks[i].mapping = malloc(sizeof(int) * table -> nrOfStates);
+		if (i > 0) {
+
+			pthread_create(&threads[i], NULL, speculateChunkRun, &chunks[i]);
+		}
+	}
+	speculateChunkRun(&chunks[0]);
+
+	int state = chunks[0].mapping[table -> startState];
+	for (int i = 1; i < nrOfThreads; i++) {
+
+		pthread_join(threads[i], NULL);
+		state = chunks[i].mapping[state];
+	}
+
+	for (int i = 0; i < nrOfThreads; i++) {
+
+		free(chunks[i].mapping);
+	}
+	free(chunks);
+	free(threads);
+	return state;
+}
+
+/*
+* description: Maps a file into memory and runs it as one string through the
+* dfa, split over threads.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file.
+* param[in]: nrOfThreads - Number of threads, 0 for one per core.
+* param[out]: accepted - If the dfa accepts the file.
+* return: 1 if the file could be read, else 0.
+*/
+int speculateFile (const dfa *dfa, const char *fileName, int nrOfThreads,
+		bool *accepted) {
+
+	struct stat fileStat;
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+
+		if (fd >= 0) {
+
+			close(fd);
+		}
+		return 0;
+	}
+	if (fileStat.st_size == 0) {
+
+		close(fd);
+		*accepted = dfa -> table -> acceptable[dfa -> table -> startState];
+		return 1;
+	}
+
+	size_t size = fileStat.st_size;
+	char *file = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+
+		return 0;
+	}
+
+	int state = speculateRun(dfa -> table, file, file + size, nrOfThreads);
+	*accepted = dfa -> table -> acceptable[state];
+	munmap(file, size);
+	return 1;
+}
+
+/*
+* description: Runs a chunk from all states at once and fills in its mapping.
+* The first chunk is only run from the start state.
+* param[in]: arg - Pointer to the speculateChunk.
+* return: NULL.
+*/
+void *speculateChunkRun (void *arg) {
+
+	speculateChunk *chunk = arg;
+	const dfaTable *table = chunk -> table;
+	const int *next = table -> next;
+	const unsigned short *classes = table -> classes;
+	const int nrOfClasses = table -> nrOfClasses;
+	const unsigned char *input = (const unsigned char *)chunk -> begin;
+	size_t size = chunk -> end - chunk -> begin;
+	int n = table -> nrOfStates;
+
+	if (chunk -> fromStart) {
+
+		chunk -> mapping[table -> startState] = dfaTableRun(table,
+				table -> startState, chunk -> begin, size);
+		return NULL;
+	}
+
+	//laneOf tells which lane each state the chunk may start in is followed by.
+	int *lanes = malloc(sizeof(int) * n);
+	int *laneOf = malloc(sizeof(int) * n);
+	int *laneOfState = malloc(sizeof(int) * n);
+	int *merged = malloc(sizeof(int) * n);
+	int nrOfLanes = n;
+
+	for (int s = 0; s < n; s++) {
+
+		lanes[s] = s;
+		laneOf[s] = s;
+		laneOfState[s] = -1;
+	}
+
+	for (size_t i = 0; i < size; i += SPECULATE_BLOCK_SIZE) {
+
+		size_t blockEnd = i + SPECULATE_BLOCK_SIZE < size ?
+				i + SPECULATE_BLOCK_SIZE : size;
+
+		if (nrOfLanes == 1) {
+
+			lanes[0] = dfaTableRun(table, lanes[0], chunk -> begin + i,
+					size - i);
+			break;
+		}
+
+		for (size_t j = i; j < blockEnd; j++) {
+
+			int class = classes[input[j]];
+			for (int l = 0; l < nrOfLanes; l++) {
+
+				lanes[l] = next != NULL ?
+						next[(size_t)lanes[l] * nrOfClasses + class] :
+						dfaCombMove(table -> comb, lanes[l], class);
+			}
+		}
+
+		//Merge lanes which have ended up in the same state.
+		int nrOfMerged = 0;
+		for (int l = 0; l < nrOfLanes; l++) {
+
+			if (laneOfState[lanes[l]] < 0) {
+
+				laneOfState[lanes[l]] = nrOfMerged;
+				lanes[nrOfMerged++] = lanes[l];
+			}
+			merged[l] = laneOfState[lanes[l]];
+		}
+		for (int l = 0; l < nrOfMerged; l++) {
+
+			laneOfState[lanes[l]] = -1;
+		}
+		for (int s = 0; s < n; s++) {
+
+			laneOf[s] = merged[laneOf[s]];
+		}
+		nrOfLanes = nrOfMerged;
+	}
+
+	for (int s = 0; s < n; s++) {
+
+		chunk -> mapping[s] = lanes[laneOf[s]];
+	}
+
+	free(lanes);
+	free(laneOf);
+	free(laneOfState);
+	free(merged);
+	return NULL;
+}
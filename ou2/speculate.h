@@ -0,0 +1,75 @@
+/*
+* speculate: Runs one huge input through a compiled dfa on several cores. The
+* input is split into one chunk per thread. Only the first chunk knows which
+* state it starts in, so every other chunk is run from every state at once,
+* giving a mapping from the state the chunk starts in to the state it ends
+* in. The mappings are then composed in input order to find the state the
+* whole input ends in.
+*
+* The runs of a chunk are kept as lanes, one per distinct current state, that
+* are stepped together over each byte. Lanes that end up in the same state are
+* merged, which for most dfas quickly leaves only a few lanes. This only pays
+* off for dfas with few states, larger dfas are run in one thread.
+*
+* Authors:
+* Buster Hultgren Warn <dv17bhn@cs.umu.se>
+* Victor Liljeholm <dv13vlm@cs.umu.se>
+*
+* Final build: 2018-08-23
+*/
+
+#ifndef SPECULATE
+#define SPECULATE
+
+#include <pthread.h>
+
+#include "dfa.h"
+
+#define SPECULATE_MAX_STATES 256
+#define SPECULATE_BLOCK_SIZE 256
+
+/*
+* A chunk of the input, run by its own thread.
+* mapping - The state the chunk ends in, for each state it may start in.
+*/
+typedef struct speculateChunk {
+
+	const dfaTable *table;
+	const char *begin;
+	const char *end;
+	bool fromStart;
+	int *mapping;
+} speculateChunk;
+
+/*
+* description: Runs an input through a compiled table, split over threads.
+* param[in]: table - The compiled table.
+* param[in]: begin - Start of the input.
+* param[in]: end - End of the input.
+* param[in]: nrOfThreads - Number of threads, 0 for one per core.
+* return: The state the input ends in.
+*/
+int speculateRun (const dfaTable *table, const char *begin, const char *end,
+		int nrOfThreads);
+
+/*
+* description: Maps a file into memory and runs it as one string through the
+* dfa, split over threads.
+* param[in]: dfa - The compiled dfa.
+* param[in]: fileName - The file.
+* param[in]: nrOfThreads - Number of threads, 0 for one per core.
+* param[out]: accepted - If the dfa accepts the file.
+* return: 1 if the file could be read, else 0.
+*/
+int speculateFile (const dfa *dfa, const char *fileName, int nrOfThreads,
+		bool *accepted);
+
+/*
+* description: Runs a chunk from all states at once and fills in its mapping.
+* The first chunk is only run from the start state.
+* param[in]: arg - Pointer to the speculateChunk.
+* return: NULL.
+*/
+void *speculateChunkRun (void *arg);
+
+#endif //SPECULATE
@@ -3,6 +3,11 @@
 * the regular expression is found in a textfile and prints the words and how
 * matches of that word is found, also prints the totalt number of matches found.
 *
+* The expression is compiled into a dfa (see nfa.h) and each word of a line is
+* run through it, the first accepted word of each line is counted. A word is a
+* run of letters, digits and '_', which is what the word boundaries of the
+* expression match against.
+*
 * param[in]: argv[0] - ./[exacutable program name]
 * param[in]: argv[1] - Name of the file where the words are to be matched and
 * counted.
@@ -15,24 +20,23 @@
 */
 
 #include <stdio.h>
-#include <regex.h>
+#include <ctype.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include "wordcount.h"
 
 #define CAPACITY 100
-#define MAXMATCHES 50
+#define MAXWORD 49
 
 int main(int argc, char const *argv[]) {
 
-    char expr[] = "\\b([a-z][aeiouy]{2}ing|"
+    char expr[] = "[a-z][aeiouy]{2}ing|"
                     "[aeiouy][aeiouy][a-z]ing|"
                     "[a-z]{2}[aeiouy]{2}ly|"
                     "[a-z][aeiouy]{2}[a-z]ly|"
-                    "[aeiouy]{2}[a-z]{2}ly)\\b";
-	regex_t regex;
-    int status;
+                    "[aeiouy]{2}[a-z]{2}ly";
+	dfa *dfa;
 	int count = 0;
     FILE *inFile;
     wordCount *wc = wordCountEmpty();
@@ -43,19 +47,21 @@ int main(int argc, char const *argv[]) {
         return 0;
     }
 
-    inFile = fopen(argv[1], "r");
-	status = regcomp(&regex, expr, REG_ICASE|REG_EXTENDED);
-
-    if (status != 0){
+    dfa = compileExpression(expr);
+    if (dfa == NULL) {
 
         fprintf(stderr, "Could not compile the regular expression\n");
+        free(wc -> words);
+        free(wc);
+        return 0;
     }
 
-    count = calculateWordCount(wc, regex, inFile);
+    inFile = fopen(argv[1], "r");
+    count = calculateWordCount(wc, dfa, inFile);
 
     printWordCount(wc, count);
 
-    regfree(&regex);
+    dfaKill(dfa);
 	free(wc -> words);
 	free (wc);
     fclose(inFile);
@@ -78,37 +84,65 @@ wordCount *wordCountEmpty () {
 }
 
 /*
-* description: Reads strings one by one from the file and checks the strings
-* against the regular expression and saves any matches to the wordCount. Also
-* counts nummber of matches.
+* description: Compiles the regular expression into a minimal dfa, ignoring the
+* case of letters.
+* param[in]: expr - The regular expression.
+* return: The compiled dfa, NULL if the expression is invalid.
+*/
+dfa *compileExpression(const char *expr){
+
+    dfa *built = nfaBuildDfa(expr, NFA_ICASE);
+    if (built == NULL) {
+
+        return NULL;
+    }
+
+    dfa *minimal = dfaMinimize(built);
+    if (minimal == NULL) {
+
+        return built;
+    }
+    dfaKill(built);
+    return minimal;
+}
+
+/*
+* description: Reads strings one by one from the file and checks the words of
+* the strings against the regular expression and saves the first match of
+* each string to the wordCount. Also counts nummber of matches.
 * param[in]: wc - A pointer to the wordCount.
-* param[in]: regex - The compiled regular expression.
+* param[in]: dfa - The compiled dfa of the regular expression.
 * param[in]: inFile - pointer to the file stream.
 * return: the number of matches found.
 */
-int calculateWordCount(wordCount *wc, regex_t regex, FILE *inFile){
+int calculateWordCount(wordCount *wc, const dfa *dfa, FILE *inFile){
     int count = 0;
     char buffer[500];
     char tempWord[50];
-    int status;
-    regmatch_t matches[MAXMATCHES];
 
-    while(fgets(buffer, 1000, inFile) != NULL){
+    while(fgets(buffer, sizeof(buffer), inFile) != NULL){
 
+        int i = 0;
+        while(buffer[i] != '\0'){
 
-        status = regexec(&regex, buffer, MAXMATCHES, matches, 0);
+            int start = i;
+            while(isWordChar(buffer[i])){
 
-        if(status == 0){
+                i++;
+            }
 
-            int i = 1;
-            while(matches[i].rm_so != -1){
+            if(i > start && i - start <= MAXWORD &&
+                    dfaAccepts(dfa, buffer + start, i - start)){
 
-                strncpy(tempWord, buffer+matches[i].rm_so,
-                        matches[i].rm_eo - matches[i].rm_so);
-                tempWord[matches[i].rm_eo - matches[i].rm_so] = '\0';
+                strncpy(tempWord, buffer + start, i - start);
+                tempWord[i - start] = '\0';
 
                 addWord(wc, tempWord);
                 count++;
+                break;
+            }
+            if(i == start){
+
                 i++;
             }
         }
@@ -116,6 +150,16 @@ int calculateWordCount(wordCount *wc, regex_t regex, FILE *inFile){
     return count;
 }
 
+/*
+* description: Checks if a char can be part of a word.
+* param[in]: c - The char.
+* return: 1 if it is a letter, a digit or '_', else 0.
+*/
+int isWordChar(char c){
+
+    return isalnum((unsigned char)c) || c == '_';
+}
+
 /*
 * description: Reallocates memeory if the wordCount is full, then checks if the
 * string allready exist in wordCount to then either add to the count of a
@@ -138,6 +182,7 @@ void addWord(wordCount *wc, char* newWord) {
     if(pos == -1){
 
         strncpy(wc -> words[wc -> inUse].word, newWord, 6);
+        wc -> words[wc -> inUse].word[6] = '\0';
         wc -> words[wc -> inUse].count = 1;
         wc -> inUse++;
     } else {
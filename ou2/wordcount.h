@@ -1,3 +1,7 @@
+#include "dfa.h"
+#include "minimize.h"
+#include "nfa.h"
+
 typedef struct word{
 
     char word[7];
@@ -18,15 +22,30 @@ typedef struct wordCount{
 wordCount *wordCountEmpty ();
 
 /*
-* description: Reads strings one by one from the file and checks the strings
-* against the regular expression and saves any matches to the wordCount. Also
-* counts nummber of matches.
+* description: Compiles the regular expression into a minimal dfa, ignoring the
+* case of letters.
+* param[in]: expr - The regular expression.
+* return: The compiled dfa, NULL if the expression is invalid.
+*/
+dfa *compileExpression(const char *expr);
+
+/*
+* description: Reads strings one by one from the file and checks the words of
+* the strings against the regular expression and saves the first match of
+* each string to the wordCount. Also counts nummber of matches.
 * param[in]: wc - A pointer to the wordCount.
-* param[in]: regex - The compiled regular expression.
+* param[in]: dfa - The compiled dfa of the regular expression.
 * param[in]: inFile - pointer to the file stream.
 * return: the number of matches found.
 */
-int calculateWordCount(wordCount *wc, regex_t regex, FILE *inFile);
+int calculateWordCount(wordCount *wc, const dfa *dfa, FILE *inFile);
+
+/*
+* description: Checks if a char can be part of a word.
+* param[in]: c - The char.
+* return: 1 if it is a letter, a digit or '_', else 0.
+*/
+int isWordChar(char c);
 /*
 * description: Reallocates memeory if the wordCount is full, then checks if the
 * string allready exist in wordCount to then either add to the count of a